@@ -1,4 +1,5 @@
 #include <cassert>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <memory>
@@ -6,42 +7,94 @@
 #include <string_view>
 #include "kipper/kipper.hh"
 
-void print_usage() { std::cout << "Usage: ks <source file>" << std::endl; }
+void print_usage() {
+  std::cout << "Usage: ks [--ast] [--code-cache=<directory>] "
+               "[--cpu-prof=<output file>] [--hot-spots[=<count>]] "
+               "<source file | ->"
+            << std::endl;
+}
 
-int read_file(std::string_view file, std::string& kscript) {
-  std::ifstream istrm{file.data(), std::ios::in | std::ios::ate};
-  if (!istrm.is_open()) {
+int write_profile(std::string_view file, const std::string& profile) {
+  std::ofstream ostrm{file.data(), std::ios::out | std::ios::trunc};
+  if (!ostrm.is_open()) {
     std::cerr << "failed to open " << file << '\n';
     return 1;
   }
-  auto length = istrm.tellg();
-  kscript.resize(length);
-  istrm.seekg(0, std::ios::beg);
-  istrm.read(&kscript[0], length);
+  ostrm << profile;
   return 0;
 }
 
-int run_script(std::string_view file) {
-  std::string kscript;
-  if (auto rcode = read_file(file, kscript)) {
-    return rcode;
+int run_script(std::string_view file, bool bytecode,
+               const char* code_cache_dir, std::string_view profile_file,
+               int hot_spots) {
+  if (!bytecode || code_cache_dir) {
+    kipper::KipperConfig config{0, 0, bytecode};
+    config.code_cache_dir = code_cache_dir;
+    kipper::Kipper::Configure(config);
   }
-
   kipper::Kipper::Initialize();
+  if (!profile_file.empty() && !kipper::Kipper::StartProfiling()) {
+    std::cerr << "CPU profiling is not supported on this platform\n";
+    return 1;
+  }
+  if (hot_spots > 0 && !kipper::Kipper::StartCounting()) {
+    std::cerr << "node counters are not enabled in this build\n";
+    return 1;
+  }
+  auto rcode = 1;
   try {
-    auto script = kipper::Script::Compile(kscript, file);
-    script->Run(kipper::Kipper::GlobalContext());
-    return 0;
+    // Reads standard input in chunks and maps files rather than copying them.
+    auto script = file == "-" ? kipper::Script::Compile(std::cin, "<stdin>")
+                              : kipper::Script::CompileFile(file);
+    try {
+      script->Run(kipper::Kipper::GlobalContext());
+      rcode = 0;
+    } catch (const std::exception& e) {
+      fprintf(stderr, "%s\n", e.what());
+    }
+    if (!profile_file.empty()) {
+      rcode |= write_profile(profile_file, kipper::Kipper::StopProfiling());
+    }
+    if (hot_spots > 0) {
+      std::cerr << kipper::Kipper::StopCounting(hot_spots);
+    }
   } catch (const std::exception& e) {
     fprintf(stderr, "%s\n", e.what());
   }
-  return 1;
+  return rcode;
 }
 
 int main(int argc, char** argv) {
-  if (argc == 1) {
+  constexpr std::string_view kCodeCache = "--code-cache=";
+  constexpr std::string_view kCpuProf = "--cpu-prof=";
+  constexpr std::string_view kHotSpots = "--hot-spots";
+  auto bytecode = true;
+  const char* code_cache_dir = nullptr;
+  std::string_view profile_file;
+  auto hot_spots = 0;
+  int i = 1;
+  for (; i < argc - 1; i++) {
+    std::string_view arg{argv[i]};
+    if (arg == "--ast") {
+      bytecode = false;
+    } else if (arg.substr(0, kCodeCache.size()) == kCodeCache &&
+               arg.size() > kCodeCache.size()) {
+      code_cache_dir = argv[i] + kCodeCache.size();
+    } else if (arg.substr(0, kCpuProf.size()) == kCpuProf &&
+               arg.size() > kCpuProf.size()) {
+      profile_file = arg.substr(kCpuProf.size());
+    } else if (arg == kHotSpots) {
+      hot_spots = 10;
+    } else if (arg.substr(0, kHotSpots.size() + 1) == "--hot-spots=") {
+      hot_spots = std::atoi(argv[i] + kHotSpots.size() + 1);
+    } else {
+      break;
+    }
+  }
+  if (i != argc - 1) {
     print_usage();
     return 1;
   }
-  return run_script(argv[1]);
-}
\ No newline at end of file
+  return run_script(argv[i], bytecode, code_cache_dir, profile_file,
+                    hot_spots);
+}
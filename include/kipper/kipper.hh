@@ -1,11 +1,14 @@
 #pragma once
 
+#include <iosfwd>
 #include <memory>
+#include <string>
 #include <string_view>
 
 namespace kipper {
 
 class Boolean;
+class CompileTask;
 class Context;
 class Number;
 class String;
@@ -111,6 +114,9 @@ class Object : public Value {
 
   void SetProperty(Handle<Value> key, Handle<Value> value);
 
+  /// Removes the property `key`. Returns false if it was not set.
+  bool DeleteProperty(Handle<Value> key);
+
   static Handle<Object> New(int32_t length);
 
   static Object* Cast(Value* obj);
@@ -184,10 +190,39 @@ class Script {
 
   static Script::Ptr Compile(std::string_view code, std::string_view filename);
 
+  /// Reads the code from `input` in chunks, straight into the copy kept for
+  /// parsing function bodies on their first call, so pipes need no buffer of
+  /// their own.
+  static Script::Ptr Compile(std::istream& input, std::string_view filename);
+
+  /// Maps the file at `path` into memory instead of copying it where the
+  /// platform allows. The file must not be truncated while the script lives.
+  static Script::Ptr CompileFile(std::string_view path);
+
+  /// Scans and parses `code` on a worker thread. The heap is left alone
+  /// until CompileTask::Finish(), so scripts may run meanwhile.
+  static std::unique_ptr<CompileTask, void (*)(CompileTask*)> CompileAsync(
+      std::string_view code, std::string_view filename);
+
  private:
   Script();
 };
 
+class CompileTask {
+ public:
+  using Ptr = std::unique_ptr<CompileTask, void (*)(CompileTask*)>;
+
+  /// Whether the worker is done, Finish() then does not block.
+  bool IsDone() const;
+
+  /// Waits for the worker and completes the script on the calling thread.
+  /// Throws the syntax error of the script, if any.
+  Script::Ptr Finish();
+
+ private:
+  CompileTask();
+};
+
 class Context {
  public:
   using Ptr = std::unique_ptr<Context, void (*)(Context*)>;
@@ -203,6 +238,26 @@ class Context {
 struct KipperConfig {
   size_t heap_size;
   uint8_t tenure_threshold;
+  bool bytecode = true;
+  bool optimize = true;
+  // Invocations or loop iterations before bytecode is compiled to machine
+  // code, negative disables the JIT. Ignored in builds without KIPPER_JIT.
+  int32_t jit_threshold = 1000;
+  // Back edges before a loop is traced and compiled to machine code,
+  // negative disables tracing. Ignored in builds without KIPPER_JIT.
+  int32_t trace_threshold = 100;
+  // Directory where compiled scripts are cached across runs, keyed by a hash
+  // of their source, null disables the cache.
+  const char* code_cache_dir = nullptr;
+  // Heap created by Kipper::CreateSnapshot() to initialize from, instead of
+  // building one. It must outlive Kipper::Initialize().
+  std::string_view snapshot{};
+  // Native functions the snapshot may hold, terminated by a nullptr. Pass
+  // the same array when creating and when loading the snapshot.
+  const kSFunctionTemplate* external_references = nullptr;
+  // Only checks the syntax of function bodies when compiling a script, and
+  // parses each one on the first call of its function.
+  bool lazy_parsing = true;
 };
 
 class Kipper {
@@ -214,6 +269,29 @@ class Kipper {
   static Context* GlobalContext();
 
   static Context::Ptr CreateContext(Context* parent);
+
+  // Starts sampling the running script functions every `interval_us`
+  // microseconds of CPU time. Returns false if already profiling or if the
+  // platform lacks SIGPROF.
+  static bool StartProfiling(int32_t interval_us = 1000);
+
+  // Stops profiling and returns the samples as collapsed stacks, the input
+  // format of flamegraph.pl. Call it before the profiled Scripts are freed.
+  static std::string StopProfiling();
+
+  // Starts counting the executions and self time of every AST node. Scripts
+  // and functions are walked rather than run as bytecode while counting.
+  // Returns false if the build lacks KIPPER_NODE_COUNTERS.
+  static bool StartCounting();
+
+  // Stops counting and returns a report of the `top` hottest nodes with
+  // their source code. Call it before the counted Scripts are freed.
+  static std::string StopCounting(int32_t top = 10);
+
+  // Serializes the heap, with the variables of the global Context, for
+  // KipperConfig::snapshot. Throws if it holds script functions or natives
+  // missing from KipperConfig::external_references.
+  static std::string CreateSnapshot();
 };
 
 template <int ArgsN>
@@ -4,7 +4,7 @@
 
 using namespace kipper::internal;
 
-size_t Allocator::allocate_size_{0};
+std::atomic<size_t> Allocator::allocate_size_{0};
 
 void* Allocator::Allocate(size_t size) {
   assert(size > 0);
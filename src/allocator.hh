@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cstdlib>
 #include "kipper.hh"
 
@@ -19,7 +20,8 @@ class Allocator : public AllStatic {
   static size_t AllocateSize() { return allocate_size_; }
 
  private:
-  static size_t allocate_size_;
+  // Zones of parsers on CompileJob workers allocate concurrently.
+  static std::atomic<size_t> allocate_size_;
 };
 
 }  // namespace internal
@@ -1,5 +1,6 @@
 #include <cassert>
 #include "ast.hh"
+#include "code_cache.hh"
 #include "compiler.hh"
 #include "context.hh"
 #include "handle.hh"
@@ -7,7 +8,12 @@
 #include "interpreter.hh"
 #include "kipper.hh"
 #include "kipper/kipper.hh"
+#include "profiler.hh"
+#include "snapshot.hh"
 #include "value.hh"
+#if defined(KIPPER_JIT)
+#include "jit.hh"
+#endif
 
 using namespace kipper;
 
@@ -57,9 +63,11 @@ namespace i = kipper::internal;
 
 CONST_API_CAST(Context, Context)
 CONST_API_CAST(Script, Node)
+CONST_API_CAST(CompileTask, CompileJob)
 
 API_CAST(i::Context*, Context*)
 API_CAST(i::Node*, Script*)
+API_CAST(i::CompileJob*, CompileTask*)
 API_CAST(kSFunctionTemplate, i::Function::FunctionTemplate)
 
 EXPORT_HANDLE(Object, Number)
@@ -230,6 +238,11 @@ void Object::SetProperty(Handle<Value> key, Handle<Value> value) {
                           ImportObject(value));
 }
 
+bool Object::DeleteProperty(Handle<Value> key) {
+  LOG_API("KSObject::DeleteProperty");
+  return ImportKSObject(this)->DeleteProperty(ImportObject(key).Get());
+}
+
 Handle<Object> Object::New(int32_t length) {
   LOG_API("KSObject::New");
   return ExportObject(i::Handle{i::KSObject::New(length)});
@@ -252,7 +265,7 @@ void Array::Push(Handle<Value> value) {
 
 void Array::Set(int32_t index, Handle<Value> value) {
   LOG_API("Array::Set");
-  ImportKSArray(this)->Set(index, ImportObject(value).Get());
+  i::KSArray::Set(ImportKSArray(this), index, ImportObject(value));
 }
 
 Handle<Value> Array::Index(int32_t index) const {
@@ -317,6 +330,36 @@ Script::Ptr Script::Compile(std::string_view code, std::string_view filename) {
                      [](Script* script) { delete ApiCast(script); });
 }
 
+Script::Ptr Script::Compile(std::istream& input, std::string_view filename) {
+  LOG_API("Script::Compile");
+  return Script::Ptr(ApiCast(i::Compiler::Compile(input, filename).release()),
+                     [](Script* script) { delete ApiCast(script); });
+}
+
+Script::Ptr Script::CompileFile(std::string_view path) {
+  LOG_API("Script::CompileFile");
+  return Script::Ptr(ApiCast(i::Compiler::CompileFile(path).release()),
+                     [](Script* script) { delete ApiCast(script); });
+}
+
+CompileTask::Ptr Script::CompileAsync(std::string_view code,
+                                      std::string_view filename) {
+  LOG_API("Script::CompileAsync");
+  return CompileTask::Ptr(ApiCast(new i::CompileJob{code, filename}),
+                          [](CompileTask* task) { delete ApiCast(task); });
+}
+
+bool CompileTask::IsDone() const {
+  LOG_API("CompileTask::IsDone");
+  return ApiCast(this)->done();
+}
+
+Script::Ptr CompileTask::Finish() {
+  LOG_API("CompileTask::Finish");
+  return Script::Ptr(ApiCast(ApiCast(this)->Finish().release()),
+                     [](Script* script) { delete ApiCast(script); });
+}
+
 void Context::Push(std::string_view name, Handle<Value> value) {
   LOG_API("Context::Push");
   ApiCast(this)->Push(i::String::NewSymbol(name), ImportObject(value).Get());
@@ -334,6 +377,44 @@ void Kipper::Initialize() {
 
 void Kipper::Configure(const KipperConfig& config) {
   i::Heap::Configure(config.heap_size, config.tenure_threshold);
+  i::Interpreter::EnableBytecode(config.bytecode);
+  i::Compiler::EnableOptimization(config.optimize);
+  i::Compiler::EnableLazyParsing(config.lazy_parsing);
+  i::CodeCache::SetDirectory(config.code_cache_dir ? config.code_cache_dir
+                                                   : "");
+  i::Snapshot::Configure(
+      config.snapshot,
+      reinterpret_cast<const i::Function::FunctionTemplate*>(
+          config.external_references));
+#if defined(KIPPER_JIT)
+  i::Jit::SetThreshold(config.jit_threshold);
+  i::Tracer::SetThreshold(config.trace_threshold);
+#endif
+}
+
+bool Kipper::StartProfiling(int32_t interval_us) {
+  LOG_API("Kipper::StartProfiling");
+  return i::Profiler::Start(interval_us);
+}
+
+std::string Kipper::StopProfiling() {
+  LOG_API("Kipper::StopProfiling");
+  return i::Profiler::Stop();
+}
+
+bool Kipper::StartCounting() {
+  LOG_API("Kipper::StartCounting");
+  return i::NodeCounters::Start();
+}
+
+std::string Kipper::StopCounting(int32_t top) {
+  LOG_API("Kipper::StopCounting");
+  return i::NodeCounters::Stop(top);
+}
+
+std::string Kipper::CreateSnapshot() {
+  LOG_API("Kipper::CreateSnapshot");
+  return i::Snapshot::Create();
 }
 
 Context* Kipper::GlobalContext() {
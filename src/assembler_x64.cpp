@@ -0,0 +1,295 @@
+#include "assembler_x64.hh"
+#include <cassert>
+
+using namespace kipper::internal;
+
+static uint8_t Code(Register reg) { return static_cast<uint8_t>(reg) & 7; }
+
+static bool IsExtended(Register reg) { return static_cast<uint8_t>(reg) >= 8; }
+
+void Assembler::Push(Register reg) {
+  if (IsExtended(reg)) {
+    Emit(0x41);
+  }
+  Emit(0x50 | Code(reg));
+}
+
+void Assembler::Pop(Register reg) {
+  if (IsExtended(reg)) {
+    Emit(0x41);
+  }
+  Emit(0x58 | Code(reg));
+}
+
+void Assembler::Ret() { Emit(0xc3); }
+
+void Assembler::Mov(Register dst, Register src) {
+  EmitRex(true, src, dst);
+  Emit(0x89);
+  EmitModRM(src, dst);
+}
+
+void Assembler::Mov(Register dst, uint64_t imm) {
+  EmitRex(true, Register::rax, dst);
+  Emit(0xb8 | Code(dst));
+  Emit64(imm);
+}
+
+void Assembler::Mov32(Register dst, int32_t imm) {
+  EmitRex(false, Register::rax, dst);
+  Emit(0xb8 | Code(dst));
+  Emit32(static_cast<uint32_t>(imm));
+}
+
+void Assembler::Load(Register dst, Register base, int32_t disp) {
+  EmitRex(true, dst, base);
+  Emit(0x8b);
+  EmitOperand(dst, base, disp);
+}
+
+void Assembler::Store(Register base, int32_t disp, Register src) {
+  EmitRex(true, src, base);
+  Emit(0x89);
+  EmitOperand(src, base, disp);
+}
+
+void Assembler::Add32(Register dst, Register src) {
+  EmitRex(false, src, dst);
+  Emit(0x01);
+  EmitModRM(src, dst);
+}
+
+void Assembler::Add32(Register dst, int8_t imm) {
+  EmitRex(false, Register::rax, dst);
+  Emit(0x83);
+  EmitModRM(Register::rax, dst);  // /0
+  Emit(static_cast<uint8_t>(imm));
+}
+
+void Assembler::Sub32(Register dst, Register src) {
+  EmitRex(false, src, dst);
+  Emit(0x29);
+  EmitModRM(src, dst);
+}
+
+void Assembler::Imul32(Register dst, Register src) {
+  EmitRex(false, dst, src);
+  Emit(0x0f);
+  Emit(0xaf);
+  EmitModRM(dst, src);
+}
+
+void Assembler::Xor32(Register dst, Register src) {
+  EmitRex(false, src, dst);
+  Emit(0x31);
+  EmitModRM(src, dst);
+}
+
+void Assembler::Cmp32(Register left, Register right) {
+  EmitRex(false, right, left);
+  Emit(0x39);
+  EmitModRM(right, left);
+}
+
+void Assembler::Cmp32(Register left, int32_t imm) {
+  EmitRex(false, Register::rdi, left);
+  Emit(0x81);
+  EmitModRM(Register::rdi, left);  // /7
+  Emit32(static_cast<uint32_t>(imm));
+}
+
+void Assembler::Test32(Register left, Register right) {
+  EmitRex(false, right, left);
+  Emit(0x85);
+  EmitModRM(right, left);
+}
+
+void Assembler::Test8(Register left, Register right) {
+  if (IsExtended(left) || IsExtended(right)) {
+    EmitRex(false, right, left);
+  } else if (Code(left) >= 4 || Code(right) >= 4) {
+    Emit(0x40);  // spl, bpl, sil and dil rather than ah, ch, dh and bh
+  }
+  Emit(0x84);
+  EmitModRM(right, left);
+}
+
+void Assembler::Or(Register dst, Register src) {
+  EmitRex(true, src, dst);
+  Emit(0x09);
+  EmitModRM(src, dst);
+}
+
+void Assembler::Xor(Register dst, Register src) {
+  EmitRex(true, src, dst);
+  Emit(0x31);
+  EmitModRM(src, dst);
+}
+
+void Assembler::Shr(Register dst, uint8_t shift) {
+  EmitRex(true, Register::rbp, dst);
+  Emit(0xc1);
+  EmitModRM(Register::rbp, dst);  // /5
+  Emit(shift);
+}
+
+void Assembler::Cmp(Register left, Register right) {
+  EmitRex(true, right, left);
+  Emit(0x39);
+  EmitModRM(right, left);
+}
+
+void Assembler::Test(Register left, Register right) {
+  EmitRex(true, right, left);
+  Emit(0x85);
+  EmitModRM(right, left);
+}
+
+void Assembler::Cmov(Condition condition, Register dst, Register src) {
+  EmitRex(true, dst, src);
+  Emit(0x0f);
+  Emit(0x40 | static_cast<uint8_t>(condition));
+  EmitModRM(dst, src);
+}
+
+void Assembler::Movq(XMMRegister dst, Register src) {
+  EmitSse(0x66, true, 0x6e, static_cast<uint8_t>(dst),
+          static_cast<uint8_t>(src));
+}
+
+void Assembler::Movq(Register dst, XMMRegister src) {
+  EmitSse(0x66, true, 0x7e, static_cast<uint8_t>(src),
+          static_cast<uint8_t>(dst));
+}
+
+void Assembler::Addsd(XMMRegister dst, XMMRegister src) {
+  EmitSse(0xf2, false, 0x58, static_cast<uint8_t>(dst),
+          static_cast<uint8_t>(src));
+}
+
+void Assembler::Subsd(XMMRegister dst, XMMRegister src) {
+  EmitSse(0xf2, false, 0x5c, static_cast<uint8_t>(dst),
+          static_cast<uint8_t>(src));
+}
+
+void Assembler::Mulsd(XMMRegister dst, XMMRegister src) {
+  EmitSse(0xf2, false, 0x59, static_cast<uint8_t>(dst),
+          static_cast<uint8_t>(src));
+}
+
+void Assembler::Divsd(XMMRegister dst, XMMRegister src) {
+  EmitSse(0xf2, false, 0x5e, static_cast<uint8_t>(dst),
+          static_cast<uint8_t>(src));
+}
+
+void Assembler::Ucomisd(XMMRegister left, XMMRegister right) {
+  EmitSse(0x66, false, 0x2e, static_cast<uint8_t>(left),
+          static_cast<uint8_t>(right));
+}
+
+void Assembler::Cvtsi2sd(XMMRegister dst, Register src) {
+  EmitSse(0xf2, false, 0x2a, static_cast<uint8_t>(dst),
+          static_cast<uint8_t>(src));
+}
+
+void Assembler::Cvttsd2si(Register dst, XMMRegister src) {
+  EmitSse(0xf2, false, 0x2c, static_cast<uint8_t>(dst),
+          static_cast<uint8_t>(src));
+}
+
+void Assembler::Jump(Label* label) {
+  Emit(0xe9);
+  EmitLabel(label);
+}
+
+void Assembler::Jump(Condition condition, Label* label) {
+  Emit(0x0f);
+  Emit(0x80 | static_cast<uint8_t>(condition));
+  EmitLabel(label);
+}
+
+void Assembler::Jump(Register target) {
+  EmitRex(false, Register::rax, target);
+  Emit(0xff);
+  EmitModRM(Register::rsp, target);  // /4
+}
+
+void Assembler::Call(Register target) {
+  EmitRex(false, Register::rax, target);
+  Emit(0xff);
+  EmitModRM(Register::rdx, target);  // /2
+}
+
+void Assembler::Bind(Label* label) {
+  assert(!label->is_bound());
+  label->position_ = pc_offset();
+  for (auto field : label->unresolved_) {
+    auto rel = static_cast<uint32_t>(label->position_ - (field + 4));
+    for (int i = 0; i < 4; i++) {
+      code_[field + i] = static_cast<uint8_t>(rel >> (i * 8));
+    }
+  }
+  label->unresolved_.clear();
+}
+
+void Assembler::Emit32(uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    Emit(static_cast<uint8_t>(value >> (i * 8)));
+  }
+}
+
+void Assembler::Emit64(uint64_t value) {
+  Emit32(static_cast<uint32_t>(value));
+  Emit32(static_cast<uint32_t>(value >> 32));
+}
+
+void Assembler::EmitRex(bool wide, Register reg, Register rm) {
+  uint8_t rex = 0x40;
+  if (wide) {
+    rex |= 0x08;
+  }
+  if (IsExtended(reg)) {
+    rex |= 0x04;
+  }
+  if (IsExtended(rm)) {
+    rex |= 0x01;
+  }
+  if (rex != 0x40) {
+    Emit(rex);
+  }
+}
+
+void Assembler::EmitModRM(Register reg, Register rm) {
+  Emit(0xc0 | Code(reg) << 3 | Code(rm));
+}
+
+void Assembler::EmitSse(uint8_t prefix, bool wide, uint8_t opcode,
+                        uint8_t reg, uint8_t rm) {
+  Emit(prefix);
+  EmitRex(wide, static_cast<Register>(reg), static_cast<Register>(rm));
+  Emit(0x0f);
+  Emit(opcode);
+  EmitModRM(static_cast<Register>(reg), static_cast<Register>(rm));
+}
+
+void Assembler::EmitOperand(Register reg, Register base, int32_t disp) {
+  auto is_disp8 = disp >= -128 && disp <= 127;
+  Emit((is_disp8 ? 0x40 : 0x80) | Code(reg) << 3 | Code(base));
+  if (Code(base) == Code(Register::rsp)) {
+    Emit(0x24);  // SIB: base only
+  }
+  if (is_disp8) {
+    Emit(static_cast<uint8_t>(disp));
+  } else {
+    Emit32(static_cast<uint32_t>(disp));
+  }
+}
+
+void Assembler::EmitLabel(Label* label) {
+  if (label->is_bound()) {
+    Emit32(static_cast<uint32_t>(label->position_ - (pc_offset() + 4)));
+  } else {
+    label->unresolved_.push_back(pc_offset());
+    Emit32(0);
+  }
+}
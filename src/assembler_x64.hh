@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "kipper.hh"
+
+namespace kipper {
+namespace internal {
+
+enum class Register : uint8_t {
+  rax,
+  rcx,
+  rdx,
+  rbx,
+  rsp,
+  rbp,
+  rsi,
+  rdi,
+  r8,
+  r9,
+  r10,
+  r11,
+  r12,
+  r13,
+  r14,
+  r15,
+};
+
+enum class XMMRegister : uint8_t { xmm0, xmm1 };
+
+/// The low nibble of the Jcc, SETcc and CMOVcc opcodes. Flipping the lowest
+/// bit negates a condition.
+enum class Condition : uint8_t {
+  kOverflow = 0x0,
+  kBelow = 0x2,
+  kAboveEqual = 0x3,
+  kEqual = 0x4,
+  kNotEqual = 0x5,
+  kBelowEqual = 0x6,
+  kAbove = 0x7,
+  kParityEven = 0xa,
+  kLess = 0xc,
+  kGreaterEqual = 0xd,
+  kLessEqual = 0xe,
+  kGreater = 0xf,
+};
+
+inline Condition Negate(Condition condition) {
+  return static_cast<Condition>(static_cast<uint8_t>(condition) ^ 1);
+}
+
+/// A position in the code. Jumps emitted before it is bound are patched by
+/// Assembler::Bind().
+class Label {
+ public:
+  Label() = default;
+
+  bool is_bound() const { return position_ >= 0; }
+
+  int position() const { return position_; }
+
+ private:
+  friend class Assembler;
+
+  int position_{-1};
+  std::vector<int> unresolved_;
+};
+
+/// Encodes the handful of x86-64 instructions the Jit emits.
+///
+/// Instructions suffixed with 32 or 8 operate on the low 32 or 8 bits of the
+/// registers (32-bit results zero the upper halves), everything else on full
+/// 64-bit registers.
+class Assembler {
+ public:
+  void Push(Register reg);
+  void Pop(Register reg);
+  void Ret();
+
+  void Mov(Register dst, Register src);
+  void Mov(Register dst, uint64_t imm);
+  void Mov32(Register dst, int32_t imm);
+
+  /// mov dst, [base + disp]
+  void Load(Register dst, Register base, int32_t disp);
+
+  /// mov [base + disp], src
+  void Store(Register base, int32_t disp, Register src);
+
+  void Add32(Register dst, Register src);
+  void Add32(Register dst, int8_t imm);
+  void Sub32(Register dst, Register src);
+  void Imul32(Register dst, Register src);
+  void Xor32(Register dst, Register src);
+  void Cmp32(Register left, Register right);
+  void Cmp32(Register left, int32_t imm);
+  void Test32(Register left, Register right);
+  void Test8(Register left, Register right);
+
+  void Or(Register dst, Register src);
+  void Xor(Register dst, Register src);
+  void Shr(Register dst, uint8_t shift);
+  void Cmp(Register left, Register right);
+  void Test(Register left, Register right);
+  void Cmov(Condition condition, Register dst, Register src);
+
+  /// Scalar double instructions, Cvtsi2sd converts a 32-bit integer and
+  /// Cvttsd2si truncates to one.
+  void Movq(XMMRegister dst, Register src);
+  void Movq(Register dst, XMMRegister src);
+  void Addsd(XMMRegister dst, XMMRegister src);
+  void Subsd(XMMRegister dst, XMMRegister src);
+  void Mulsd(XMMRegister dst, XMMRegister src);
+  void Divsd(XMMRegister dst, XMMRegister src);
+  void Ucomisd(XMMRegister left, XMMRegister right);
+  void Cvtsi2sd(XMMRegister dst, Register src);
+  void Cvttsd2si(Register dst, XMMRegister src);
+
+  void Jump(Label* label);
+  void Jump(Condition condition, Label* label);
+  void Jump(Register target);
+  void Call(Register target);
+
+  void Bind(Label* label);
+
+  int pc_offset() const { return static_cast<int>(code_.size()); }
+
+  const std::vector<uint8_t>& code() const { return code_; }
+
+ private:
+  void Emit(uint8_t byte) { code_.push_back(byte); }
+
+  void Emit32(uint32_t value);
+
+  void Emit64(uint64_t value);
+
+  /// Emits a REX prefix when needed, `reg` extends ModRM.reg and `rm`
+  /// ModRM.rm (or the base register).
+  void EmitRex(bool wide, Register reg, Register rm);
+
+  void EmitModRM(Register reg, Register rm);
+
+  /// Emits `prefix`, a REX prefix if needed, 0x0f and `opcode`, then the
+  /// ModRM byte. `reg` and `rm` are register codes of either kind.
+  void EmitSse(uint8_t prefix, bool wide, uint8_t opcode, uint8_t reg,
+               uint8_t rm);
+
+  void EmitOperand(Register reg, Register base, int32_t disp);
+
+  /// Emits the rel32 field of a jump to `label`.
+  void EmitLabel(Label* label);
+
+  std::vector<uint8_t> code_;
+};
+
+}  // namespace internal
+}  // namespace kipper
@@ -1,11 +1,16 @@
 #include "ast.hh"
+#include <algorithm>
+#include <functional>
 #include <sstream>
+#include "compiler.hh"
 #include "context.hh"
 #include "heap.hh"
 #include "interpreter.hh"
+#include "profiler.hh"
 #include "reference.hh"
 #include "utils.hh"
 #include "value.hh"
+#include "vm.hh"
 
 using namespace kipper::internal;
 
@@ -22,6 +27,46 @@ using namespace kipper::internal;
     }                                      \
   } while (false)
 
+// Loops run their condition, body and update in a HandleScope per iteration,
+// so the handles they create do not pile up until the enclosing scope exits.
+// A returned value is re-created in the caller's scope.
+
+static bool IsConditionTrue(Expression* condition, Execution& exec) {
+  HandleScope handle_scope;
+  return condition->Evaluate(exec)->IsTrue();
+}
+
+static void EvaluateForEffect(Expression* expr, Execution& exec) {
+  HandleScope handle_scope;
+  expr->Evaluate(exec);
+}
+
+static Completion Escape(Completion::Type type, Object* value) {
+  return type == Completion::RETURN ? Completion{type, Handle{value}}
+                                    : Completion{type};
+}
+
+static Completion ExecuteScoped(Statement* stmt, Execution& exec) {
+  Completion::Type type;
+  Object* value;
+  {
+    HandleScope handle_scope;
+    auto completion = stmt->Execute(exec);
+    type = completion.type;
+    value = completion.value.Get();
+  }
+  return Escape(type, value);
+}
+
+template <class Op>
+static Handle<Object> Compare(Object* left, Object* right, Op op) {
+  if (Int32::Both(left, right)) {
+    return Constant::BooleanHandle(
+        op(Int32::ValueOf(left), Int32::ValueOf(right)));
+  }
+  return Constant::BooleanHandle(op(left->ToDouble(), right->ToDouble()));
+}
+
 #define THROW_KS_OBJECT_REFERENCE_ERROR(location) \
   throw KSReferenceError { location, "reference error" }
 
@@ -39,6 +84,7 @@ Handle<Object> Statement::Evaluate(Execution& /*exec*/) {
 }
 
 Handle<Object> TranslationUnit::Evaluate(Execution& exec) {
+  COUNT_NODE(this);
   for (auto& fn_decl : fn_decls) {
     fn_decl->Evaluate(exec);
   }
@@ -49,17 +95,25 @@ Handle<Object> TranslationUnit::Evaluate(Execution& exec) {
 }
 
 Completion BlockStatement::Execute(Execution& exec) {
-  ExecutionHandler exec_handler{exec};
-  for (auto& stmt : stmts) {
-    auto completion = stmt->Execute(exec);
-    if (completion.type != Completion::NORMAL) {
-      return completion;
+  COUNT_NODE(this);
+  auto type = Completion::NORMAL;
+  Object* value = nullptr;
+  {
+    ExecutionHandler exec_handler{exec};
+    for (auto& stmt : stmts) {
+      auto completion = stmt->Execute(exec);
+      if (completion.type != Completion::NORMAL) {
+        type = completion.type;
+        value = completion.value.Get();
+        break;
+      }
     }
   }
-  return Completion{};
+  return Escape(type, value);
 }
 
 Completion IfStatement::Execute(Execution& exec) {
+  COUNT_NODE(this);
   if (condition->Evaluate(exec)->IsTrue()) {
     return then_stmt->Execute(exec);
   }
@@ -70,40 +124,42 @@ Completion IfStatement::Execute(Execution& exec) {
 }
 
 Completion WhileStatement::Execute(Execution& exec) {
-  while (condition->Evaluate(exec)->IsTrue()) {
-    auto completion = loop_stmt->Execute(exec);
+  COUNT_NODE(this);
+  while (IsConditionTrue(condition, exec)) {
+    auto completion = ExecuteScoped(loop_stmt, exec);
     HANDLE_LOOP_COMPLETION(completion);
   }
   return Completion{};
 }
 
 Completion ForStatement::Execute(Execution& exec) {
+  COUNT_NODE(this);
   if (init) {
-    init->Evaluate(exec);
+    EvaluateForEffect(init, exec);
   }
   if (condition) {
     if (update) {
-      while (condition->Evaluate(exec)->IsTrue()) {
-        auto completion = loop_stmt->Execute(exec);
+      while (IsConditionTrue(condition, exec)) {
+        auto completion = ExecuteScoped(loop_stmt, exec);
         HANDLE_LOOP_COMPLETION(completion);
-        update->Evaluate(exec);
+        EvaluateForEffect(update, exec);
       }
     } else {
-      while (condition->Evaluate(exec)->IsTrue()) {
-        auto completion = loop_stmt->Execute(exec);
+      while (IsConditionTrue(condition, exec)) {
+        auto completion = ExecuteScoped(loop_stmt, exec);
         HANDLE_LOOP_COMPLETION(completion);
       }
     }
   } else {
     if (update) {
       for (;;) {
-        auto completion = loop_stmt->Execute(exec);
+        auto completion = ExecuteScoped(loop_stmt, exec);
         HANDLE_LOOP_COMPLETION(completion);
-        update->Evaluate(exec);
+        EvaluateForEffect(update, exec);
       }
     } else {
       for (;;) {
-        auto completion = loop_stmt->Execute(exec);
+        auto completion = ExecuteScoped(loop_stmt, exec);
         HANDLE_LOOP_COMPLETION(completion);
       }
     }
@@ -112,25 +168,30 @@ Completion ForStatement::Execute(Execution& exec) {
 }
 
 Completion ReturnStatement::Execute(Execution& exec) {
+  COUNT_NODE(this);
   return value ? Completion{Completion::RETURN, value->Evaluate(exec)}
                : Completion{Completion::RETURN};
 }
 
 Completion BreakStatement::Execute(Execution& /* exec */) {
+  COUNT_NODE(this);
   return Completion{Completion::BREAK};
 }
 
 Completion ContinueStatement::Execute(Execution& /* exec */) {
+  COUNT_NODE(this);
   return Completion{Completion::CONTINUE};
 }
 
 Completion ExpressionStatement::Execute(Execution& exec) {
+  COUNT_NODE(this);
   expr->Evaluate(exec);
   return Completion{};
 }
 
 Handle<Object> Assignment::Evaluate(Execution& exec) {
-  Reference ref{target.get(), exec};
+  COUNT_NODE(this);
+  Reference ref{target, exec};
   auto val = value->Evaluate(exec);
   switch (op) {
     case Token::ASSIGN:
@@ -152,15 +213,20 @@ Handle<Object> Assignment::Evaluate(Execution& exec) {
 }
 
 Handle<Object> ConditionalExpression::Evaluate(Execution& exec) {
+  COUNT_NODE(this);
   return condition->Evaluate(exec)->ToBoolean()->IsTrue()
              ? then_expr->Evaluate(exec)
              : else_expr->Evaluate(exec);
 }
 
-Handle<Object> BinaryExpression::Evaluate(Execution& exec) {
-  auto left_value = left->Evaluate(exec);
-  auto right_value = right->Evaluate(exec);
-  switch (op) {
+// BinaryExpression and PostfixExpression rewrite themselves into one of the
+// specializations below once they have seen their operands. Each guards on
+// the types it was chosen for and deoptimizes to the generic evaluation.
+
+static Handle<Object> GenericBinary(BinaryExpression* expr,
+                                    Handle<Object> left_value,
+                                    Handle<Object> right_value) {
+  switch (expr->op) {
     case Token::PLUS:
       return Interpreter::Add(left_value, right_value);
     case Token::SUB:
@@ -182,26 +248,100 @@ Handle<Object> BinaryExpression::Evaluate(Execution& exec) {
       return Constant::BooleanHandle(left_value->ToBoolean()->IsTrue() &&
                                      right_value->ToBoolean()->IsTrue());
     case Token::LT:
-      return Constant::BooleanHandle(left_value->ToDouble() <
-                                     right_value->ToDouble());
+      return Compare(*left_value, *right_value, std::less<>{});
     case Token::GT:
-      return Constant::BooleanHandle(left_value->ToDouble() >
-                                     right_value->ToDouble());
+      return Compare(*left_value, *right_value, std::greater<>{});
     case Token::LTE:
-      return Constant::BooleanHandle(left_value->ToDouble() <=
-                                     right_value->ToDouble());
+      return Compare(*left_value, *right_value, std::less_equal<>{});
     case Token::GTE:
-      return Constant::BooleanHandle(left_value->ToDouble() >=
-                                     right_value->ToDouble());
+      return Compare(*left_value, *right_value, std::greater_equal<>{});
     default:
       break;
   }
-  assert(Token::IsBinaryOperator(op));
+  assert(Token::IsBinaryOperator(expr->op));
   UNREACHABLE();
   return Handle<Object>{};
 }
 
+static Handle<Object> Deoptimize(BinaryExpression* expr, Handle<Object> left,
+                                 Handle<Object> right) {
+  expr->specialization = GenericBinary;
+  return GenericBinary(expr, left, right);
+}
+
+template <bool (*Op)(Object*, Object*, Object**)>
+static Handle<Object> Int32Arithmetic(BinaryExpression* expr,
+                                      Handle<Object> left,
+                                      Handle<Object> right) {
+  Object* result;
+  if (Int32::Both(*left, *right) && Op(*left, *right, &result)) {
+    return Handle{result};
+  }
+  return Deoptimize(expr, left, right);
+}
+
+template <class Op>
+static Handle<Object> Int32Comparison(BinaryExpression* expr,
+                                      Handle<Object> left,
+                                      Handle<Object> right) {
+  if (Int32::Both(*left, *right)) {
+    return Constant::BooleanHandle(
+        Op{}(Int32::ValueOf(*left), Int32::ValueOf(*right)));
+  }
+  return Deoptimize(expr, left, right);
+}
+
+static Handle<Object> StringConcat(BinaryExpression* expr, Handle<Object> left,
+                                   Handle<Object> right) {
+  if (left->IsString() && right->IsString()) {
+    return Handle{String::Cast(*left)->Concat(String::Cast(*right))};
+  }
+  return Deoptimize(expr, left, right);
+}
+
+static BinaryExpression::Specialization Specialize(Token::Kind op,
+                                                   Object* left,
+                                                   Object* right) {
+  if (Int32::Both(left, right)) {
+    switch (op) {
+      case Token::PLUS:
+        return Int32Arithmetic<Int32::Add>;
+      case Token::SUB:
+        return Int32Arithmetic<Int32::Sub>;
+      case Token::MUL:
+        return Int32Arithmetic<Int32::Mul>;
+      case Token::MOD:
+        return Int32Arithmetic<Int32::Mod>;
+      case Token::LT:
+        return Int32Comparison<std::less<int32_t>>;
+      case Token::GT:
+        return Int32Comparison<std::greater<int32_t>>;
+      case Token::LTE:
+        return Int32Comparison<std::less_equal<int32_t>>;
+      case Token::GTE:
+        return Int32Comparison<std::greater_equal<int32_t>>;
+      default:
+        break;
+    }
+  }
+  if (op == Token::PLUS && left->IsString() && right->IsString()) {
+    return StringConcat;
+  }
+  return GenericBinary;
+}
+
+Handle<Object> BinaryExpression::Evaluate(Execution& exec) {
+  COUNT_NODE(this);
+  auto left_value = left->Evaluate(exec);
+  auto right_value = right->Evaluate(exec);
+  if (!specialization) {
+    specialization = Specialize(op, *left_value, *right_value);
+  }
+  return specialization(this, left_value, right_value);
+}
+
 Handle<Object> UnaryExpression::Evaluate(Execution& exec) {
+  COUNT_NODE(this);
   switch (op) {
     case Token::PLUS:
       return Handle{target->Evaluate(exec)->ToNumber()};
@@ -210,30 +350,12 @@ Handle<Object> UnaryExpression::Evaluate(Execution& exec) {
     case Token::NOT:
       return Constant::BooleanHandle(!target->Evaluate(exec)->IsTrue());
     case Token::INC: {
-      Reference ref{target.get(), exec};
-      auto value = ref.GetValue();
-      if (value->IsInt32()) {
-        return ref.SetValue(
-            Handle{Int32::Make(Handle<Int32>::Cast(value)->Value() + 1)});
-      }
-      if (value->IsHeapNumber()) {
-        return ref.SetValue(Handle{
-            HeapNumber::New(Handle<HeapNumber>::Cast(value)->Value() + 1)});
-      }
-      return ref.SetValue(Handle{Double::Make(value->ToDouble() + 1)});
+      Reference ref{target, exec};
+      return ref.SetValue(Handle{Interpreter::Increment(*ref.GetValue(), 1)});
     }
     case Token::DEC: {
-      Reference ref{target.get(), exec};
-      auto value = ref.GetValue();
-      if (value->IsInt32()) {
-        return ref.SetValue(
-            Handle{Int32::Make(Handle<Int32>::Cast(value)->Value() - 1)});
-      }
-      if (value->IsHeapNumber()) {
-        return ref.SetValue(Handle{
-            HeapNumber::New(Handle<HeapNumber>::Cast(value)->Value() - 1)});
-      }
-      return ref.SetValue(Handle{Double::Make(value->ToDouble() - 1)});
+      Reference ref{target, exec};
+      return ref.SetValue(Handle{Interpreter::Increment(*ref.GetValue(), -1)});
     }
     default:
       UNREACHABLE();
@@ -241,58 +363,91 @@ Handle<Object> UnaryExpression::Evaluate(Execution& exec) {
   }
 }
 
+static Handle<Object> GenericPostfix(PostfixExpression* expr,
+                                     Execution& exec) {
+  Reference ref{expr->target, exec};
+  // Copied since a named reference hands out the variable itself.
+  auto value = Handle{*ref.GetValue()};
+  ref.SetValue(Handle{
+      Interpreter::Increment(*value, expr->op == Token::INC ? 1 : -1)});
+  return value;
+}
+
+template <int32_t delta>
+static Handle<Object> Int32VariableIncrement(PostfixExpression* expr,
+                                             Execution& exec) {
+  auto variable = expr->target->AsIdentifier()->Lookup(exec);
+  Object* result;
+  if (!variable || !Int32::Is(*variable) ||
+      !Int32::Add(*variable, Int32::Make(delta), &result)) {
+    expr->specialization = GenericPostfix;
+    return GenericPostfix(expr, exec);
+  }
+  auto value = Handle{*variable};
+  *variable.location() = result;
+  return value;
+}
+
 Handle<Object> PostfixExpression::Evaluate(Execution& exec) {
-  Reference ref{target.get(), exec};
-  if (op == Token::INC) {
-    auto value = ref.GetValue();
-    if (value->IsInt32()) {
-      ref.SetValue(
-          Handle{Int32::Make(Handle<Int32>::Cast(value)->Value() + 1)});
-    } else if (value->IsHeapNumber()) {
-      ref.SetValue(Handle{
-          HeapNumber::New(Handle<HeapNumber>::Cast(value)->Value() + 1)});
+  COUNT_NODE(this);
+  if (!specialization) {
+    auto identifier = target->AsIdentifier();
+    auto variable = identifier ? identifier->Lookup(exec) : Handle<Object>{};
+    if (variable && Int32::Is(*variable)) {
+      specialization = op == Token::INC ? Int32VariableIncrement<1>
+                                        : Int32VariableIncrement<-1>;
     } else {
-      ref.SetValue(Handle{Double::Make(value->ToDouble() + 1)});
+      specialization = GenericPostfix;
     }
-    return value;
-  }
-  auto value = ref.GetValue();
-  if (value->IsInt32()) {
-    ref.SetValue(Handle{Int32::Make(Handle<Int32>::Cast(value)->Value() - 1)});
-  } else if (value->IsHeapNumber()) {
-    ref.SetValue(
-        Handle{HeapNumber::New(Handle<HeapNumber>::Cast(value)->Value() - 1)});
-  } else {
-    ref.SetValue(Handle{Double::Make(value->ToDouble() - 1)});
   }
-  return value;
+  return specialization(this, exec);
 }
 
 Handle<Object> MemberAccess::Evaluate(Execution& exec) {
+  COUNT_NODE(this);
   return Reference{this, exec}.GetValue();
 }
 
-Handle<Object> IntLiteral::Evaluate(Execution& /* exec */) { return value_; }
+Handle<Object> IntLiteral::Evaluate(Execution& /* exec */) {
+  COUNT_NODE(this);
+  return value_;
+}
 
-Handle<Object> DoubleLiteral::Evaluate(Execution& /* exec */) { return value_; }
+Handle<Object> DoubleLiteral::Evaluate(Execution& /* exec */) {
+  COUNT_NODE(this);
+  return value_;
+}
 
-Handle<Object> StringLiteral::Evaluate(Execution& /* exec */) { return value_; }
+Handle<Object> StringLiteral::Evaluate(Execution& /* exec */) {
+  COUNT_NODE(this);
+  return value_;
+}
 
 Handle<Object> BooleanLiteral::Evaluate(Execution& /* exec */) {
+  COUNT_NODE(this);
   return value_;
 }
 
 Handle<Object> ArrayLiteral::Evaluate(Execution& exec) {
+  COUNT_NODE(this);
   auto size = static_cast<int32_t>(elements.size());
-  auto result = Handle{KSArray::New(size)};
+  std::vector<Handle<Object>> values;
+  values.reserve(size);
+  auto kind = PACKED_INT32_ELEMENTS;
+  for (auto& element : elements) {
+    auto value = element->Evaluate(exec);
+    kind = std::max(kind, KSArray::KindFor(value.Get()));
+    values.push_back(value);
+  }
+  auto result = Handle{KSArray::New(size, kind)};
   for (int i = 0; i < size; i++) {
-    auto element = elements[i]->Evaluate(exec);
-    result->Set(i, element.Get());
+    KSArray::Set(result, i, values[i]);
   }
   return result;
 }
 
 Handle<Object> ObjectLiteral::Evaluate(Execution& exec) {
+  COUNT_NODE(this);
   auto object = Handle{KSObject::New(static_cast<int32_t>(properties.size()))};
   for (auto& prop : properties) {
     auto key = prop->name->Evaluate(exec);
@@ -303,36 +458,55 @@ Handle<Object> ObjectLiteral::Evaluate(Execution& exec) {
 }
 
 Handle<Object> UndefinedLiteral::Evaluate(Execution& /*exec*/) {
+  COUNT_NODE(this);
   return Constant::UndefinedHandle();
 }
 
 Handle<Object> Identifier::Evaluate(Execution& exec) {
-  auto result = exec.context()->Resolve(name.Get());
+  COUNT_NODE(this);
+  auto result = Lookup(exec);
   return result ? result : Constant::UndefinedHandle();
 }
 
-Handle<Object> IdentifierName::Evaluate(Execution& /*exec*/) { return name; }
+Handle<Object> Identifier::Lookup(Execution& exec) {
+  if (!IsResolved()) {
+    return exec.context()->Resolve(name.Get());
+  }
+  auto context = exec.context();
+  for (int i = 0; i < depth; i++) {
+    context = context->parent();
+  }
+  return context->Slot(slot);
+}
+
+Handle<Object> IdentifierName::Evaluate(Execution& /*exec*/) {
+  COUNT_NODE(this);
+  return name;
+}
 
 Handle<Object> FunctionCall::Evaluate(Execution& exec) {
-  Reference ref{target.get(), exec};
+  COUNT_NODE(this);
+  Reference ref{target, exec};
   if (auto result = ref.GetValue(); result->IsFunction()) {
     Handle<Object> self;
     if (ref.IsPropertyReference()) {
       self = ref.GetBase();
     }
-    auto args_size = static_cast<int32_t>(args.size());
-    auto arguments = Handle{KSArray::New(args_size, TENURED)};
-    for (int i = 0; i < args_size; i++) {
-      auto arg = args[i]->Evaluate(exec);
-      arguments->Set(i, arg.Get());
+    auto argc = static_cast<int32_t>(args.size());
+    auto is_assert = Interpreter::IsAssert(result.Get());
+    VM::Window argv{argc + is_assert};
+    for (int32_t i = 0; i < argc; i++) {
+      argv[i] = args[i]->Evaluate(exec).Get();
     }
-    if (Function::Cast(result.Get())->Name()->Value() == "Assert") {
+    if (is_assert) {
       std::stringstream loc;
-      loc << args[0]->loc;
-      KSArray::Push(arguments, Handle{String::New(loc.str(), TENURED)});
+      loc << Compiler::Resolve(args[0]->loc);
+      argv[argc] = String::New(loc.str(), TENURED);
     }
+    Profiler::SetLocation(&loc);
     try {
-      return exec.interpreter()->Call(self, result, arguments, exec.context());
+      return exec.interpreter()->Call(self, result, argv.slots(),
+                                      argc + is_assert, exec.context());
     } catch (const KSNotFunctionError&) {
       THROW_KS_OBJECT_NOT_FUNCTION(target->loc);
     }
@@ -341,13 +515,14 @@ Handle<Object> FunctionCall::Evaluate(Execution& exec) {
 }
 
 Handle<Object> FunctionDecl::Evaluate(Execution& exec) {
+  COUNT_NODE(this);
   auto params_size = static_cast<int32_t>(params.size());
   auto params_array = Handle{Array::New(params_size, TENURED)};
   for (int i = 0; i < params_size; i++) {
     auto param = params[i]->Evaluate(exec);
     params_array->Set(i, param.Get());
   }
-  auto fn = Function::New(name.Get(), params_array.Get(), &body, TENURED);
+  auto fn = Function::New(name.Get(), params_array.Get(), this, TENURED);
   exec.context()->Push(name.Get(), fn);
   return Constant::UndefinedHandle();
 }
\ No newline at end of file
@@ -3,11 +3,15 @@
 #include <memory>
 #include <vector>
 
+#include "bytecode.hh"
+#include "compiler.hh"
 #include "completion.hh"
 #include "handle.hh"
+#include "inline_cache.hh"
 #include "kipper.hh"
 #include "location.hh"
 #include "token.hh"
+#include "zone.hh"
 
 namespace kipper {
 namespace internal {
@@ -52,8 +56,6 @@ class NodeVisitor;
 
 struct Node {
  public:
-  using Ptr = unique_ptr<Node>;
-
   virtual ~Node() {}
 
   virtual TranslationUnit *AsTranslationUnit() { return nullptr; }
@@ -68,13 +70,16 @@ struct Node {
 
   virtual void Accept(NodeVisitor *visitor) = 0;
 
-  Location loc{"anon"};
+  SourceRange loc;
+#if defined(KIPPER_NODE_COUNTERS)
+  // Executions and self ticks, kept while NodeCounters is counting.
+  uint64_t hits = 0;
+  uint64_t ticks = 0;
+#endif
 };
 
 class Statement : public Node {
  public:
-  using Ptr = unique_ptr<Statement>;
-
   virtual ~Statement() = default;
 
   virtual Completion Execute(Execution &exec) = 0;
@@ -94,8 +99,6 @@ struct BreakableStatement : public Statement {
 };
 
 struct Expression : public Node {
-  using Ptr = unique_ptr<Expression>;
-
   virtual ~Expression() = default;
 
   virtual Literal *AsLiteral() { return nullptr; }
@@ -108,22 +111,25 @@ struct Expression : public Node {
 };
 
 struct TranslationUnit final : public Node {
-  using Ptr = unique_ptr<TranslationUnit>;
-
   TranslationUnit *AsTranslationUnit() override { return this; }
 
   Handle<Object> Evaluate(Execution &exec) override final;
 
   void Accept(NodeVisitor *visitor) override final;
 
-  std::vector<Node::Ptr> stmts;
-  std::vector<Node::Ptr> fn_decls;
+  /// Owns the other nodes of the script, and outlives their bytecode.
+  Zone zone;
+  std::vector<Node *> stmts;
+  std::vector<Node *> fn_decls;
+  unique_ptr<Bytecode> bytecode;
+  bool bytecode_generated{false};
+  SourceFilePtr source;
 };
 
 /////////////////////////statements ////////////////////
 
 struct BlockStatement final : public Statement {
-  using Statements = std::vector<Statement::Ptr>;
+  using Statements = std::vector<Statement *>;
 
   BlockStatement *AsBlockStatement() override { return this; }
 
@@ -135,27 +141,25 @@ struct BlockStatement final : public Statement {
 };
 
 struct IfStatement final : public Statement {
-  using Ptr = unique_ptr<IfStatement>;
-
   Completion Execute(Execution &exec) override final;
 
   void Accept(NodeVisitor *visitor) override final;
 
-  Expression::Ptr condition;
-  Statement::Ptr then_stmt;
-  Statement::Ptr else_stmt;
+  Expression *condition{nullptr};
+  Statement *then_stmt{nullptr};
+  Statement *else_stmt{nullptr};
 };
 
 struct WhileStatement final : public BreakableStatement {
-  WhileStatement(Expression::Ptr _condition, Statement::Ptr _loop_stmt)
-      : condition{std::move(_condition)}, loop_stmt{std::move(_loop_stmt)} {}
+  WhileStatement(Expression *_condition, Statement *_loop_stmt)
+      : condition{_condition}, loop_stmt{_loop_stmt} {}
 
   Completion Execute(Execution &exec) override final;
 
   void Accept(NodeVisitor *visitor) override final;
 
-  Expression::Ptr condition;
-  Statement::Ptr loop_stmt;
+  Expression *condition{nullptr};
+  Statement *loop_stmt{nullptr};
 };
 
 struct ForStatement final : public BreakableStatement {
@@ -163,10 +167,10 @@ struct ForStatement final : public BreakableStatement {
 
   void Accept(NodeVisitor *visitor) override final;
 
-  Expression::Ptr init;
-  Expression::Ptr condition;
-  Expression::Ptr update;
-  Statement::Ptr loop_stmt;
+  Expression *init{nullptr};
+  Expression *condition{nullptr};
+  Expression *update{nullptr};
+  Statement *loop_stmt{nullptr};
 };
 
 struct ReturnStatement final : public Statement {
@@ -174,7 +178,7 @@ struct ReturnStatement final : public Statement {
 
   void Accept(NodeVisitor *visitor) override final;
 
-  Expression::Ptr value;
+  Expression *value{nullptr};
 };
 
 struct BreakStatement final : public Statement {
@@ -194,7 +198,7 @@ struct ExpressionStatement final : public Statement {
 
   void Accept(NodeVisitor *visitor) override final;
 
-  Expression::Ptr expr;
+  Expression *expr{nullptr};
 };
 
 ////////////////// expressions///////////////////////
@@ -204,35 +208,38 @@ struct Assignment final : public Expression {
 
   void Accept(NodeVisitor *visitor) override final;
 
-  Expression::Ptr target;
-  Expression::Ptr value;
+  Expression *target{nullptr};
+  Expression *value{nullptr};
   Token::Kind op;
 };
 
 struct ConditionalExpression final : public Expression {
-  using Ptr = unique_ptr<ConditionalExpression>;
-
   Handle<Object> Evaluate(Execution &exec) override final;
 
   void Accept(NodeVisitor *visitor) override final;
 
-  Expression::Ptr condition;
-  Expression::Ptr then_expr;
-  Expression::Ptr else_expr;
+  Expression *condition{nullptr};
+  Expression *then_expr{nullptr};
+  Expression *else_expr{nullptr};
 };
 
 struct BinaryExpression final : public Expression {
-  BinaryExpression(Expression::Ptr _left, Expression::Ptr _right,
-                   Token::Kind _op)
-      : left{std::move(_left)}, right{std::move(_right)}, op{_op} {}
+  BinaryExpression(Expression *_left, Expression *_right, Token::Kind _op)
+      : left{_left}, right{_right}, op{_op} {}
 
   Handle<Object> Evaluate(Execution &exec) override final;
 
   void Accept(NodeVisitor *visitor) override final;
 
-  Expression::Ptr left;
-  Expression::Ptr right;
+  using Specialization = Handle<Object> (*)(BinaryExpression *,
+                                            Handle<Object>, Handle<Object>);
+
+  Expression *left{nullptr};
+  Expression *right{nullptr};
   Token::Kind op;
+  /// Chosen from the operand types of the first evaluation, reset to the
+  /// generic evaluation once its type guard fails.
+  Specialization specialization{nullptr};
 };
 
 struct UnaryExpression final : public Expression {
@@ -240,43 +247,47 @@ struct UnaryExpression final : public Expression {
 
   void Accept(NodeVisitor *visitor) override final;
 
-  Expression::Ptr target;
+  Expression *target{nullptr};
   Token::Kind op;
 };
 
 struct PostfixExpression final : public Expression {
-  PostfixExpression(Expression::Ptr _target, Token::Kind _op)
-      : target{std::move(_target)}, op{_op} {}
+  PostfixExpression(Expression *_target, Token::Kind _op)
+      : target{_target}, op{_op} {}
 
   Handle<Object> Evaluate(Execution &exec) override final;
 
   void Accept(NodeVisitor *visitor) override final;
 
-  Expression::Ptr target;
+  using Specialization = Handle<Object> (*)(PostfixExpression *, Execution &);
+
+  Expression *target{nullptr};
   Token::Kind op;
+  /// Like BinaryExpression::specialization.
+  Specialization specialization{nullptr};
 };
 
 struct FunctionCall final : public Expression {
-  using Args = std::vector<Expression::Ptr>;
+  using Args = std::vector<Expression *>;
 
-  FunctionCall(Expression::Ptr _target) : target{std::move(_target)} {}
+  FunctionCall(Expression *_target) : target{_target} {}
 
-  FunctionCall(Expression::Ptr _target, Args _args)
-      : target{std::move(_target)}, args{std::move(_args)} {}
+  FunctionCall(Expression *_target, Args _args)
+      : target{_target}, args{std::move(_args)} {}
 
   Handle<Object> Evaluate(Execution &exec) override final;
 
   void Accept(NodeVisitor *visitor) override final;
 
-  Expression::Ptr target;
+  Expression *target{nullptr};
   Args args;
 };
 
 struct MemberAccess final : public Expression {
   enum Type { KEYED, DOTTED };
 
-  MemberAccess(Expression::Ptr _target, Node::Ptr _member, Type _type)
-      : target{std::move(_target)}, member{std::move(_member)}, type{_type} {}
+  MemberAccess(Expression *_target, Node *_member, Type _type)
+      : target{_target}, member{_member}, type{_type} {}
 
   MemberAccess *AsMemberAccess() override final { return this; }
 
@@ -286,14 +297,13 @@ struct MemberAccess final : public Expression {
 
   void Accept(NodeVisitor *visitor) override final;
 
-  Expression::Ptr target;
-  Node::Ptr member;
+  Expression *target{nullptr};
+  Node *member{nullptr};
   Type type;
+  PropertyCache cache;
 };
 
 struct Identifier final : public Expression {
-  using Ptr = unique_ptr<Identifier>;
-
   Identifier(Handle<String> _name) : name{_name} {}
 
   Identifier *AsIdentifier() override { return this; }
@@ -304,7 +314,17 @@ struct Identifier final : public Expression {
 
   void Accept(NodeVisitor *visitor) override final;
 
+  /// Returns the variable's slot, or an empty handle if it is not defined.
+  Handle<Object> Lookup(Execution &exec);
+
+  bool IsResolved() const { return slot >= 0; }
+
   Handle<String> name;
+  /// Set by the ScopeAnalyzer for function locals: the number of blocks
+  /// between the use and the function body, and the variable's index in the
+  /// function Context.
+  int depth{-1};
+  int slot{-1};
 };
 
 struct IdentifierName : public Node {
@@ -329,6 +349,8 @@ class IntLiteral final : public Literal {
 
   Handle<Object> value() const { return value_; }
 
+  void set_value(Handle<Object> value) { value_ = value; }
+
   Handle<Object> Evaluate(Execution &exec) override final;
 
   void Accept(NodeVisitor *visitor) override final;
@@ -343,6 +365,8 @@ class DoubleLiteral final : public Literal {
 
   auto value() const { return value_; }
 
+  void set_value(Handle<Object> value) { value_ = value; }
+
   Handle<Object> Evaluate(Execution &exec) override final;
 
   void Accept(NodeVisitor *visitor) override final;
@@ -357,6 +381,8 @@ class StringLiteral final : public Literal {
 
   Handle<String> value() const { return value_; }
 
+  void set_value(Handle<String> value) { value_ = value; }
+
   Handle<Object> Evaluate(Execution &exec) override final;
 
   void Accept(NodeVisitor *visitor) override final;
@@ -369,7 +395,7 @@ class BooleanLiteral final : public Literal {
  public:
   BooleanLiteral(Handle<Object> value) : value_{value} {}
 
-  bool value() const { return value_; }
+  bool value() const { return value_->IsTrue(); }
 
   Handle<Object> Evaluate(Execution &exec) override final;
 
@@ -381,8 +407,7 @@ class BooleanLiteral final : public Literal {
 
 class ArrayLiteral final : public Literal {
  public:
-  using Ptr = unique_ptr<ArrayLiteral>;
-  using Elements = std::vector<Expression::Ptr>;
+  using Elements = std::vector<Expression *>;
 
   Handle<Object> Evaluate(Execution &exec) override final;
 
@@ -392,18 +417,14 @@ class ArrayLiteral final : public Literal {
 };
 
 struct UndefinedLiteral : public Literal {
-  using Ptr = unique_ptr<UndefinedLiteral>;
-
   Handle<Object> Evaluate(Execution &exec) override final;
 
   void Accept(NodeVisitor *visitor) override final;
 };
 
 struct PropertyAssignment final : public Node {
-  using Ptr = unique_ptr<PropertyAssignment>;
-
-  Node::Ptr name;
-  Expression::Ptr value;
+  Node *name{nullptr};
+  Expression *value{nullptr};
 
  private:
   Handle<Object> Evaluate(Execution &exec) override final {
@@ -415,8 +436,7 @@ struct PropertyAssignment final : public Node {
 };
 
 struct ObjectLiteral final : public Literal {
-  using Ptr = unique_ptr<ObjectLiteral>;
-  using Properties = std::vector<PropertyAssignment::Ptr>;
+  using Properties = std::vector<PropertyAssignment *>;
 
   ObjectLiteral() = default;
 
@@ -430,9 +450,8 @@ struct ObjectLiteral final : public Literal {
 };
 
 struct FunctionDecl final : public Node {
-  using Ptr = unique_ptr<FunctionDecl>;
-  using Params = std::vector<IdentifierName::Ptr>;
-  using Body = std::vector<Statement::Ptr>;
+  using Params = std::vector<IdentifierName *>;
+  using Body = std::vector<Statement *>;
 
   FunctionDecl *AsFunctionDecl() override final { return this; }
 
@@ -443,6 +462,16 @@ struct FunctionDecl final : public Node {
   Handle<String> name;
   Params params;
   Body body;
+  unique_ptr<Bytecode> bytecode;
+  bool bytecode_generated{false};
+  // Set by the ScopeAnalyzer, calls only materialize `arguments_` if true.
+  bool uses_arguments{false};
+  // While set, the body has only been pre-parsed: `body` is empty until
+  // Compiler::CompileFunction() parses the code at `body_loc`, the braces
+  // included, into `zone`, the zone of the TranslationUnit.
+  bool lazy{false};
+  SourceRange body_loc;
+  Zone *zone{nullptr};
 };
 
 class NodeVisitor {
@@ -455,8 +484,8 @@ class NodeVisitor {
 };
 
 template <typename T, typename... Args>
-inline unique_ptr<T> CreateNode(const Location &loc, Args &&... args) {
-  auto result = std::make_unique<T>(std::forward<Args>(args)...);
+inline T *CreateNode(Zone *zone, const SourceRange &loc, Args &&... args) {
+  auto result = zone->New<T>(std::forward<Args>(args)...);
   result->loc = loc;
   return result;
 }
@@ -0,0 +1,304 @@
+#include "ast_optimizer.hh"
+#include "interpreter.hh"
+#include "value.hh"
+
+using namespace kipper::internal;
+
+void AstOptimizer::Optimize(TranslationUnit* unit) {
+  AstOptimizer optimizer{&unit->zone};
+  unit->Accept(&optimizer);
+}
+
+void AstOptimizer::Optimize(FunctionDecl* fn_decl) {
+  AstOptimizer optimizer{fn_decl->zone};
+  fn_decl->Accept(&optimizer);
+}
+
+template <class T>
+void AstOptimizer::Visit(T*& expr) {
+  constant_ = false;
+  pure_ = true;
+  if (!expr) {
+    return;
+  }
+  expr->Accept(this);
+  if (replacement_) {
+    expr = static_cast<T*>(replacement_);
+    replacement_ = nullptr;
+  }
+}
+
+template <class T>
+bool AstOptimizer::VisitStatement(T*& stmt) {
+  removed_ = false;
+  terminates_ = false;
+  stmt->Accept(this);
+  if (removed_) {
+    removed_ = false;
+    return false;
+  }
+  if (replacement_) {
+    stmt = static_cast<T*>(replacement_);
+    replacement_ = nullptr;
+  }
+  return true;
+}
+
+void AstOptimizer::VisitBody(Statement*& stmt) {
+  if (!VisitStatement(stmt)) {
+    stmt = CreateNode<BlockStatement>(zone_, stmt->loc);
+  }
+}
+
+template <class T>
+void AstOptimizer::VisitStatements(std::vector<T*>& stmts) {
+  std::vector<T*> result;
+  auto terminates = false;
+  for (auto& stmt : stmts) {
+    if (VisitStatement(stmt)) {
+      result.push_back(stmt);
+    }
+    if (terminates_) {
+      terminates = true;
+      break;
+    }
+  }
+  stmts = std::move(result);
+  terminates_ = terminates;
+}
+
+Expression* AstOptimizer::Fold(Expression* expr) {
+  // Operators on primitives never look at the interpreter nor the context.
+  Execution exec{nullptr, nullptr};
+  auto value = expr->Evaluate(exec).Get();
+  if (value->IsInt32()) {
+    return CreateNode<IntLiteral>(zone_, expr->loc, Handle{value});
+  }
+  if (value->IsDouble()) {
+    return CreateNode<DoubleLiteral>(zone_, expr->loc, Handle{value});
+  }
+  if (value->IsString()) {
+    return CreateNode<StringLiteral>(zone_, expr->loc,
+                                     Handle{String::Cast(value)});
+  }
+  if (value->IsBoolean()) {
+    return CreateNode<BooleanLiteral>(zone_, expr->loc,
+                                      Constant::BooleanHandle(value->IsTrue()));
+  }
+  if (value->IsUndefined()) {
+    return CreateNode<UndefinedLiteral>(zone_, expr->loc);
+  }
+  return nullptr;
+}
+
+static bool IsTrue(Expression* literal) {
+  Execution exec{nullptr, nullptr};
+  return literal->Evaluate(exec)->IsTrue();
+}
+
+static bool ToBoolean(Expression* literal) {
+  Execution exec{nullptr, nullptr};
+  return literal->Evaluate(exec)->ToBoolean()->IsTrue();
+}
+
+void AstOptimizer::VisitTranslationUnit(TranslationUnit* unit) {
+  for (auto& fn_decl : unit->fn_decls) {
+    fn_decl->Accept(this);
+  }
+  VisitStatements(unit->stmts);
+}
+
+void AstOptimizer::VisitBlockStatement(BlockStatement* block) {
+  VisitStatements(block->stmts);
+  removed_ = block->stmts.empty();
+}
+
+void AstOptimizer::VisitIfStatement(IfStatement* if_stmt) {
+  Visit(if_stmt->condition);
+  if (constant_) {
+    auto& taken =
+        IsTrue(if_stmt->condition) ? if_stmt->then_stmt : if_stmt->else_stmt;
+    if (taken && VisitStatement(taken)) {
+      replacement_ = taken;
+    } else {
+      removed_ = true;
+    }
+    return;
+  }
+  VisitBody(if_stmt->then_stmt);
+  auto then_terminates = terminates_;
+  if (if_stmt->else_stmt && !VisitStatement(if_stmt->else_stmt)) {
+    if_stmt->else_stmt = nullptr;
+  }
+  terminates_ = if_stmt->else_stmt && then_terminates && terminates_;
+}
+
+void AstOptimizer::VisitWhileStatement(WhileStatement* while_stmt) {
+  Visit(while_stmt->condition);
+  if (constant_ && !IsTrue(while_stmt->condition)) {
+    removed_ = true;
+    return;
+  }
+  VisitBody(while_stmt->loop_stmt);
+  terminates_ = false;
+}
+
+void AstOptimizer::VisitForStatement(ForStatement* for_stmt) {
+  Visit(for_stmt->init);
+  auto init_pure = pure_;
+  Visit(for_stmt->condition);
+  if (constant_ && !IsTrue(for_stmt->condition)) {
+    if (init_pure) {
+      removed_ = true;
+    } else {
+      auto init = CreateNode<ExpressionStatement>(zone_, for_stmt->loc);
+      init->expr = for_stmt->init;
+      replacement_ = init;
+    }
+    return;
+  }
+  Visit(for_stmt->update);
+  VisitBody(for_stmt->loop_stmt);
+  terminates_ = false;
+}
+
+void AstOptimizer::VisitReturnStatement(ReturnStatement* return_stmt) {
+  Visit(return_stmt->value);
+  terminates_ = true;
+}
+
+void AstOptimizer::VisitBreakStatement(BreakStatement* /* stmt */) {
+  terminates_ = true;
+}
+
+void AstOptimizer::VisitContinueStatement(ContinueStatement* /* stmt */) {
+  terminates_ = true;
+}
+
+void AstOptimizer::VisitExpressionStatement(ExpressionStatement* stmt) {
+  Visit(stmt->expr);
+  removed_ = pure_;
+}
+
+void AstOptimizer::VisitAssignment(Assignment* assignment) {
+  Visit(assignment->target);
+  Visit(assignment->value);
+  constant_ = false;
+  pure_ = false;
+}
+
+void AstOptimizer::VisitConditionalExpression(ConditionalExpression* expr) {
+  Visit(expr->condition);
+  if (constant_) {
+    auto& taken =
+        ToBoolean(expr->condition) ? expr->then_expr : expr->else_expr;
+    Visit(taken);
+    replacement_ = taken;
+    return;
+  }
+  auto pure = pure_;
+  Visit(expr->then_expr);
+  pure = pure && pure_;
+  Visit(expr->else_expr);
+  constant_ = false;
+  pure_ = pure && pure_;
+}
+
+void AstOptimizer::VisitBinaryExpression(BinaryExpression* expr) {
+  Visit(expr->left);
+  auto constant = constant_;
+  auto pure = pure_;
+  Visit(expr->right);
+  if (constant && constant_) {
+    replacement_ = Fold(expr);
+    constant_ = replacement_ != nullptr;
+    pure_ = true;
+    return;
+  }
+  constant_ = false;
+  pure_ = pure && pure_;
+}
+
+void AstOptimizer::VisitUnaryExpression(UnaryExpression* expr) {
+  Visit(expr->target);
+  if (expr->op == Token::INC || expr->op == Token::DEC) {
+    constant_ = false;
+    pure_ = false;
+    return;
+  }
+  if (constant_) {
+    replacement_ = Fold(expr);
+    constant_ = replacement_ != nullptr;
+  }
+}
+
+void AstOptimizer::VisitPostfixExpression(PostfixExpression* expr) {
+  Visit(expr->target);
+  constant_ = false;
+  pure_ = false;
+}
+
+void AstOptimizer::VisitMemberAccess(MemberAccess* member_access) {
+  Visit(member_access->target);
+  Visit(member_access->member);
+  // Throws for a target without properties.
+  constant_ = false;
+  pure_ = false;
+}
+
+void AstOptimizer::VisitIdentifier(Identifier* /* identifier */) {}
+
+void AstOptimizer::VisitIdentifierName(IdentifierName* /* identifier */) {}
+
+void AstOptimizer::VisitIntLiteral(IntLiteral* /* literal */) {
+  constant_ = true;
+}
+
+void AstOptimizer::VisitDoubleLiteral(DoubleLiteral* /* literal */) {
+  constant_ = true;
+}
+
+void AstOptimizer::VisitStringLiteral(StringLiteral* /* literal */) {
+  constant_ = true;
+}
+
+void AstOptimizer::VisitBooleanLiteral(BooleanLiteral* /* literal */) {
+  constant_ = true;
+}
+
+void AstOptimizer::VisitArrayLiteral(ArrayLiteral* literal) {
+  auto pure = true;
+  for (auto& element : literal->elements) {
+    Visit(element);
+    pure = pure && pure_;
+  }
+  constant_ = false;
+  pure_ = pure;
+}
+
+void AstOptimizer::VisitObjectLiteral(ObjectLiteral* literal) {
+  auto pure = true;
+  for (auto& prop : literal->properties) {
+    Visit(prop->value);
+    pure = pure && pure_;
+  }
+  constant_ = false;
+  pure_ = pure;
+}
+
+void AstOptimizer::VisitUndefinedLiteral(UndefinedLiteral* /* literal */) {
+  constant_ = true;
+}
+
+void AstOptimizer::VisitFunctionCall(FunctionCall* call) {
+  Visit(call->target);
+  for (auto& arg : call->args) {
+    Visit(arg);
+  }
+  constant_ = false;
+  pure_ = false;
+}
+
+void AstOptimizer::VisitFunctionDecl(FunctionDecl* fn_decl) {
+  VisitStatements(fn_decl->body);
+}
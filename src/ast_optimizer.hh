@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include "ast.hh"
+
+namespace kipper {
+namespace internal {
+
+/// Rewrites the parser output before it is analyzed and run: folds
+/// operators on primitive literals, replaces branches on constant conditions
+/// by the branch taken, drops statements following a return, break or
+/// continue, and drops expression statements without side effects.
+///
+/// Constants are folded by evaluating the node, so they get exactly the
+/// runtime semantics. Blocks are never flattened since each one is a scope.
+class AstOptimizer final : public NodeVisitor {
+ public:
+  static void Optimize(TranslationUnit* unit);
+
+  /// Optimizes the body of a lazily parsed function.
+  static void Optimize(FunctionDecl* fn_decl);
+
+#define DECLARE_VISIT(Node) void Visit##Node(Node*) override final;
+  VISIT_NODES(DECLARE_VISIT)
+#undef DECLARE_VISIT
+
+ private:
+  explicit AstOptimizer(Zone* zone) : zone_{zone} {}
+
+  /// Optimizes `expr` in place.
+  template <class T>
+  void Visit(T*& expr);
+
+  /// Optimizes `stmt` in place, returns false if it can be dropped.
+  template <class T>
+  bool VisitStatement(T*& stmt);
+
+  /// Like VisitStatement() for a statement that cannot be dropped, such as a
+  /// loop body, which becomes an empty block instead.
+  void VisitBody(Statement*& stmt);
+
+  template <class T>
+  void VisitStatements(std::vector<T*>& stmts);
+
+  /// Evaluates `expr` and returns its value as a literal, or nullptr if it
+  /// has no literal form.
+  Expression* Fold(Expression* expr);
+
+  // Allocates the replacement nodes.
+  Zone* zone_;
+  // Results of the last visit: the node replacing the visited one, and for
+  // statements whether it can be dropped and whether it always jumps.
+  Node* replacement_{nullptr};
+  bool removed_{false};
+  bool terminates_{false};
+  // For expressions, whether it is a primitive literal and whether it is
+  // free of side effects.
+  bool constant_{false};
+  bool pure_{false};
+};
+
+}  // namespace internal
+}  // namespace kipper
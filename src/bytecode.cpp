@@ -0,0 +1,44 @@
+#include "bytecode.hh"
+#include "value.hh"
+#if defined(KIPPER_JIT)
+#include "jit.hh"
+#endif
+
+using namespace kipper::internal;
+
+Bytecode::Bytecode() = default;
+
+Bytecode::~Bytecode() = default;
+
+int Bytecode::OperandCount(Opcode opcode) {
+  static constexpr int kOperandCounts[] = {
+#define OPERAND_COUNT(name, operands) operands,
+      BYTECODE_LIST(OPERAND_COUNT)
+#undef OPERAND_COUNT
+  };
+  return kOperandCounts[static_cast<int32_t>(opcode)];
+}
+
+const char* Bytecode::Name(Opcode opcode) {
+  static constexpr const char* kNames[] = {
+#define OPCODE_NAME(name, operands) #name,
+      BYTECODE_LIST(OPCODE_NAME)
+#undef OPCODE_NAME
+  };
+  return kNames[static_cast<int32_t>(opcode)];
+}
+
+void Bytecode::Disassemble(std::ostream& out) const {
+  for (size_t pc = 0; pc < code.size();) {
+    auto opcode = static_cast<Opcode>(code[pc]);
+    out << pc << ": " << Name(opcode);
+    for (int i = 1, operands = OperandCount(opcode); i <= operands; i++) {
+      out << (i == 1 ? " " : ", ") << code[pc + i];
+    }
+    if (opcode == Opcode::LoadConstant) {
+      out << " ; " << constants[code[pc + 2]]->ToStdString();
+    }
+    out << '\n';
+    pc += OperandCount(opcode) + 1;
+  }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "handle.hh"
+#include "kipper.hh"
+
+namespace kipper {
+namespace internal {
+
+class MachineCode;
+struct LoopTrace;
+class Object;
+struct Node;
+
+/// V(name, operand count)
+///
+/// Operands are register indices, constant pool indices, node table indices
+/// or absolute jump targets, in the order documented next to each bytecode.
+/// Straight-line bytecodes always continue with the next instruction.
+#define STRAIGHT_LINE_BYTECODE_LIST(V)                                      \
+  V(LoadConstant, 2)          /* dst, constant */                           \
+  V(Move, 2)                  /* dst, src */                                \
+  V(LoadName, 2)              /* dst, name constant */                      \
+  V(StoreName, 2)             /* name constant, src */                      \
+  V(LoadLocal, 2)             /* dst, slot */                               \
+  V(StoreLocal, 2)            /* slot, src */                               \
+  V(LoadProperty, 4)          /* dst, object, key, node */                  \
+  V(StoreProperty, 4)         /* object, key, src, node */                  \
+  V(Add, 3)                   /* dst, left, right */                        \
+  V(Sub, 3)                   /* dst, left, right */                        \
+  V(Mul, 3)                   /* dst, left, right */                        \
+  V(Div, 3)                   /* dst, left, right */                        \
+  V(Mod, 3)                   /* dst, left, right */                        \
+  V(Equal, 3)                 /* dst, left, right */                        \
+  V(NotEqual, 3)              /* dst, left, right */                        \
+  V(LessThan, 3)              /* dst, left, right */                        \
+  V(GreaterThan, 3)           /* dst, left, right */                        \
+  V(LessThanOrEqual, 3)       /* dst, left, right */                        \
+  V(GreaterThanOrEqual, 3)    /* dst, left, right */                        \
+  V(LogicalOr, 3)             /* dst, left, right */                        \
+  V(LogicalAnd, 3)            /* dst, left, right */                        \
+  V(LogicalNot, 2)            /* dst, src */                                \
+  V(Negate, 2)                /* dst, src */                                \
+  V(ToNumber, 2)              /* dst, src */                                \
+  V(Increment, 2)             /* dst, src */                                \
+  V(Decrement, 2)             /* dst, src */                                \
+  V(CreateArray, 3)           /* dst, first, count */                       \
+  V(CreateObject, 3)          /* dst, first, count of pairs */              \
+  V(Call, 6)                  /* dst, callee, self, first, argc, node */    \
+  V(DeclareFunction, 1)       /* node */                                    \
+  V(EnterBlock, 0)                                                          \
+  V(ExitBlock, 0)
+
+#define CONTROL_FLOW_BYTECODE_LIST(V)                                       \
+  V(Jump, 1)                  /* target */                                  \
+  V(JumpIfNotTrue, 2)         /* src, target */                             \
+  V(JumpIfToBooleanFalse, 2)  /* src, target */                             \
+  V(Return, 1)                /* src */
+
+#define BYTECODE_LIST(V)         \
+  STRAIGHT_LINE_BYTECODE_LIST(V) \
+  CONTROL_FLOW_BYTECODE_LIST(V)
+
+enum class Opcode : int32_t {
+#define DECLARE_OPCODE(name, operands) name,
+  BYTECODE_LIST(DECLARE_OPCODE)
+#undef DECLARE_OPCODE
+};
+
+/// Register-based code for a translation unit or a function body.
+///
+/// The constant pool refers to handles owned by the AST (literals and names),
+/// so a Bytecode must not outlive the AST it was generated from.
+class Bytecode {
+ public:
+  static constexpr int32_t kNoRegister = -1;
+
+  Bytecode();
+
+  ~Bytecode();
+
+  static int OperandCount(Opcode opcode);
+
+  static const char* Name(Opcode opcode);
+
+  void Disassemble(std::ostream& out) const;
+
+  std::vector<int32_t> code;
+  std::vector<Handle<Object>> constants;
+  std::vector<Node*> nodes;
+  int32_t register_count{0};
+  int32_t block_depth{0};  // deepest block nesting
+#if defined(KIPPER_JIT)
+  unique_ptr<MachineCode> machine_code;
+  int32_t hotness{0};  // invocations and loop iterations, see Jit::Tick()
+  std::vector<unique_ptr<LoopTrace>> loops;  // see Tracer::Tick()
+#endif
+};
+
+}  // namespace internal
+}  // namespace kipper
@@ -0,0 +1,489 @@
+#include "bytecode_generator.hh"
+#include "value.hh"
+
+using namespace kipper::internal;
+
+namespace {
+
+/// Thrown for constructs the VM does not cover.
+class UnsupportedError {};
+
+}  // namespace
+
+unique_ptr<Bytecode> BytecodeGenerator::Generate(TranslationUnit* unit) {
+  BytecodeGenerator generator;
+  try {
+    unit->Accept(&generator);
+  } catch (const UnsupportedError&) {
+    return nullptr;
+  }
+  return generator.Finish();
+}
+
+unique_ptr<Bytecode> BytecodeGenerator::Generate(FunctionDecl* fn_decl) {
+  BytecodeGenerator generator;
+  try {
+    for (auto& stmt : fn_decl->body) {
+      generator.VisitStatement(stmt);
+    }
+  } catch (const UnsupportedError&) {
+    return nullptr;
+  }
+  return generator.Finish();
+}
+
+unique_ptr<Bytecode> BytecodeGenerator::Finish() {
+  auto result = NewRegister();
+  Emit(Opcode::LoadConstant,
+       {result, AddConstant(Constant::UndefinedHandle())});
+  Emit(Opcode::Return, {result});
+  return std::move(bytecode_);
+}
+
+void BytecodeGenerator::VisitTranslationUnit(TranslationUnit* unit) {
+  for (auto& fn_decl : unit->fn_decls) {
+    fn_decl->Accept(this);
+  }
+  for (auto& stmt : unit->stmts) {
+    VisitStatement(stmt);
+  }
+}
+
+void BytecodeGenerator::VisitBlockStatement(BlockStatement* block) {
+  if (block_depth_ == kMaxBlockDepth) {
+    throw UnsupportedError{};
+  }
+  Emit(Opcode::EnterBlock);
+  block_depth_++;
+  bytecode_->block_depth = std::max(bytecode_->block_depth, block_depth_);
+  for (auto& stmt : block->stmts) {
+    VisitStatement(stmt);
+  }
+  block_depth_--;
+  Emit(Opcode::ExitBlock);
+}
+
+void BytecodeGenerator::VisitIfStatement(IfStatement* if_stmt) {
+  auto condition = VisitForRegister(if_stmt->condition);
+  auto jump_to_else = EmitJump(Opcode::JumpIfNotTrue, condition);
+  VisitStatement(if_stmt->then_stmt);
+  if (if_stmt->else_stmt) {
+    auto jump_to_end = EmitJump(Opcode::Jump);
+    PatchJump(jump_to_else, Position());
+    VisitStatement(if_stmt->else_stmt);
+    PatchJump(jump_to_end, Position());
+  } else {
+    PatchJump(jump_to_else, Position());
+  }
+}
+
+void BytecodeGenerator::VisitWhileStatement(WhileStatement* while_stmt) {
+  Loop loop;
+  VisitLoop(loop, while_stmt->condition, nullptr,
+            while_stmt->loop_stmt);
+}
+
+void BytecodeGenerator::VisitForStatement(ForStatement* for_stmt) {
+  if (for_stmt->init) {
+    VisitStatement(for_stmt->init);
+  }
+  Loop loop;
+  VisitLoop(loop, for_stmt->condition, for_stmt->update,
+            for_stmt->loop_stmt);
+}
+
+void BytecodeGenerator::VisitLoop(Loop& loop, Node* condition, Node* update,
+                                  Statement* body) {
+  loop.block_depth = block_depth_;
+  auto loop_start = Position();
+  size_t jump_to_end = 0;
+  if (condition) {
+    RegisterScope register_scope{this};
+    jump_to_end = EmitJump(Opcode::JumpIfNotTrue, VisitForRegister(condition));
+  }
+  loops_.push_back(&loop);
+  VisitStatement(body);
+  loops_.pop_back();
+  for (auto jump : loop.continues) {
+    PatchJump(jump, Position());
+  }
+  if (update) {
+    VisitStatement(update);
+  }
+  PatchJump(EmitJump(Opcode::Jump), loop_start);
+  if (condition) {
+    PatchJump(jump_to_end, Position());
+  }
+  for (auto jump : loop.breaks) {
+    PatchJump(jump, Position());
+  }
+}
+
+void BytecodeGenerator::VisitReturnStatement(ReturnStatement* return_stmt) {
+  if (return_stmt->value) {
+    Emit(Opcode::Return, {VisitForRegister(return_stmt->value)});
+    return;
+  }
+  auto result = NewRegister();
+  Emit(Opcode::LoadConstant,
+       {result, AddConstant(Constant::UndefinedHandle())});
+  Emit(Opcode::Return, {result});
+}
+
+void BytecodeGenerator::VisitBreakStatement(BreakStatement* /* stmt */) {
+  VisitJumpToLoop(true);
+}
+
+void BytecodeGenerator::VisitContinueStatement(ContinueStatement* /* stmt */) {
+  VisitJumpToLoop(false);
+}
+
+void BytecodeGenerator::VisitJumpToLoop(bool is_break) {
+  if (loops_.empty()) {
+    throw UnsupportedError{};
+  }
+  auto loop = loops_.back();
+  for (int i = loop->block_depth; i < block_depth_; i++) {
+    Emit(Opcode::ExitBlock);
+  }
+  auto jump = EmitJump(Opcode::Jump);
+  (is_break ? loop->breaks : loop->continues).push_back(jump);
+}
+
+void BytecodeGenerator::VisitExpressionStatement(ExpressionStatement* stmt) {
+  VisitForRegister(stmt->expr);
+}
+
+void BytecodeGenerator::VisitAssignment(Assignment* assignment) {
+  auto dst = result_register_;
+  auto object = Bytecode::kNoRegister;
+  auto key = Bytecode::kNoRegister;
+  if (auto member_access = assignment->target->AsMemberAccess()) {
+    object = VisitForRegister(member_access->target);
+    key = VisitForRegister(member_access->member);
+  } else if (!assignment->target->AsIdentifier()) {
+    throw UnsupportedError{};
+  }
+  if (assignment->op == Token::ASSIGN) {
+    VisitForRegister(assignment->value, dst);
+  } else {
+    auto value = VisitForRegister(assignment->value);
+    VisitLoad(assignment->target, dst, object, key);
+    switch (assignment->op) {
+      case Token::ADD_ASSIGN:
+        Emit(Opcode::Add, {dst, dst, value});
+        break;
+      case Token::SUB_ASSIGN:
+        Emit(Opcode::Sub, {dst, dst, value});
+        break;
+      case Token::MUL_ASSIGN:
+        Emit(Opcode::Mul, {dst, dst, value});
+        break;
+      case Token::DIV_ASSIGN:
+        Emit(Opcode::Div, {dst, dst, value});
+        break;
+      case Token::MOD_ASSIGN:
+        Emit(Opcode::Mod, {dst, dst, value});
+        break;
+      default:
+        throw UnsupportedError{};
+    }
+  }
+  VisitStore(assignment->target, dst, object, key);
+}
+
+void BytecodeGenerator::VisitConditionalExpression(
+    ConditionalExpression* expr) {
+  auto dst = result_register_;
+  auto condition = VisitForRegister(expr->condition);
+  auto jump_to_else = EmitJump(Opcode::JumpIfToBooleanFalse, condition);
+  VisitForRegister(expr->then_expr, dst);
+  auto jump_to_end = EmitJump(Opcode::Jump);
+  PatchJump(jump_to_else, Position());
+  VisitForRegister(expr->else_expr, dst);
+  PatchJump(jump_to_end, Position());
+}
+
+void BytecodeGenerator::VisitBinaryExpression(BinaryExpression* expr) {
+  auto dst = result_register_;
+  auto left = VisitForRegister(expr->left);
+  auto right = VisitForRegister(expr->right);
+  Opcode opcode;
+  switch (expr->op) {
+    case Token::PLUS:
+      opcode = Opcode::Add;
+      break;
+    case Token::SUB:
+      opcode = Opcode::Sub;
+      break;
+    case Token::MUL:
+      opcode = Opcode::Mul;
+      break;
+    case Token::DIV:
+      opcode = Opcode::Div;
+      break;
+    case Token::MOD:
+      opcode = Opcode::Mod;
+      break;
+    case Token::EQ:
+      opcode = Opcode::Equal;
+      break;
+    case Token::NE:
+      opcode = Opcode::NotEqual;
+      break;
+    case Token::LOGIC_OR:
+      opcode = Opcode::LogicalOr;
+      break;
+    case Token::LOGIC_AND:
+      opcode = Opcode::LogicalAnd;
+      break;
+    case Token::LT:
+      opcode = Opcode::LessThan;
+      break;
+    case Token::GT:
+      opcode = Opcode::GreaterThan;
+      break;
+    case Token::LTE:
+      opcode = Opcode::LessThanOrEqual;
+      break;
+    case Token::GTE:
+      opcode = Opcode::GreaterThanOrEqual;
+      break;
+    default:
+      throw UnsupportedError{};
+  }
+  Emit(opcode, {dst, left, right});
+}
+
+void BytecodeGenerator::VisitUnaryExpression(UnaryExpression* expr) {
+  auto dst = result_register_;
+  switch (expr->op) {
+    case Token::PLUS:
+      Emit(Opcode::ToNumber, {dst, VisitForRegister(expr->target)});
+      return;
+    case Token::SUB:
+      Emit(Opcode::Negate, {dst, VisitForRegister(expr->target)});
+      return;
+    case Token::NOT:
+      Emit(Opcode::LogicalNot, {dst, VisitForRegister(expr->target)});
+      return;
+    case Token::INC:
+    case Token::DEC: {
+      auto object = Bytecode::kNoRegister;
+      auto key = Bytecode::kNoRegister;
+      if (auto member_access = expr->target->AsMemberAccess()) {
+        object = VisitForRegister(member_access->target);
+        key = VisitForRegister(member_access->member);
+      }
+      VisitLoad(expr->target, dst, object, key);
+      Emit(expr->op == Token::INC ? Opcode::Increment : Opcode::Decrement,
+           {dst, dst});
+      VisitStore(expr->target, dst, object, key);
+      return;
+    }
+    default:
+      throw UnsupportedError{};
+  }
+}
+
+void BytecodeGenerator::VisitPostfixExpression(PostfixExpression* expr) {
+  auto dst = result_register_;
+  auto object = Bytecode::kNoRegister;
+  auto key = Bytecode::kNoRegister;
+  if (auto member_access = expr->target->AsMemberAccess()) {
+    object = VisitForRegister(member_access->target);
+    key = VisitForRegister(member_access->member);
+  }
+  VisitLoad(expr->target, dst, object, key);
+  auto value = NewRegister();
+  Emit(expr->op == Token::INC ? Opcode::Increment : Opcode::Decrement,
+       {value, dst});
+  VisitStore(expr->target, value, object, key);
+}
+
+void BytecodeGenerator::VisitMemberAccess(MemberAccess* member_access) {
+  auto dst = result_register_;
+  auto object = VisitForRegister(member_access->target);
+  auto key = VisitForRegister(member_access->member);
+  VisitLoad(member_access, dst, object, key);
+}
+
+void BytecodeGenerator::VisitIdentifier(Identifier* identifier) {
+  VisitLoad(identifier, result_register_, Bytecode::kNoRegister,
+            Bytecode::kNoRegister);
+}
+
+void BytecodeGenerator::VisitIdentifierName(IdentifierName* identifier_name) {
+  Emit(Opcode::LoadConstant,
+       {result_register_, AddConstant(identifier_name->name)});
+}
+
+void BytecodeGenerator::VisitIntLiteral(IntLiteral* literal) {
+  Emit(Opcode::LoadConstant, {result_register_, AddConstant(literal->value())});
+}
+
+void BytecodeGenerator::VisitDoubleLiteral(DoubleLiteral* literal) {
+  Emit(Opcode::LoadConstant, {result_register_, AddConstant(literal->value())});
+}
+
+void BytecodeGenerator::VisitStringLiteral(StringLiteral* literal) {
+  Emit(Opcode::LoadConstant, {result_register_, AddConstant(literal->value())});
+}
+
+void BytecodeGenerator::VisitBooleanLiteral(BooleanLiteral* literal) {
+  Emit(Opcode::LoadConstant,
+       {result_register_,
+        AddConstant(Constant::BooleanHandle(literal->value()))});
+}
+
+void BytecodeGenerator::VisitArrayLiteral(ArrayLiteral* literal) {
+  auto dst = result_register_;
+  auto count = static_cast<int32_t>(literal->elements.size());
+  auto first = NewRegisters(count);
+  for (int32_t i = 0; i < count; i++) {
+    VisitForRegister(literal->elements[i], first + i);
+  }
+  Emit(Opcode::CreateArray, {dst, first, count});
+}
+
+void BytecodeGenerator::VisitObjectLiteral(ObjectLiteral* literal) {
+  auto dst = result_register_;
+  auto count = static_cast<int32_t>(literal->properties.size());
+  auto first = NewRegisters(count * 2);
+  for (int32_t i = 0; i < count; i++) {
+    auto& prop = literal->properties[i];
+    VisitForRegister(prop->name, first + i * 2);
+    VisitForRegister(prop->value, first + i * 2 + 1);
+  }
+  Emit(Opcode::CreateObject, {dst, first, count});
+}
+
+void BytecodeGenerator::VisitUndefinedLiteral(UndefinedLiteral* /* literal */) {
+  Emit(Opcode::LoadConstant,
+       {result_register_, AddConstant(Constant::UndefinedHandle())});
+}
+
+void BytecodeGenerator::VisitFunctionCall(FunctionCall* call) {
+  auto dst = result_register_;
+  auto callee = NewRegister();
+  auto self = Bytecode::kNoRegister;
+  if (auto member_access = call->target->AsMemberAccess()) {
+    self = VisitForRegister(member_access->target);
+    auto key = VisitForRegister(member_access->member);
+    VisitLoad(member_access, callee, self, key);
+  } else if (call->target->AsIdentifier()) {
+    VisitForRegister(call->target, callee);
+  } else {
+    throw UnsupportedError{};
+  }
+  auto argc = static_cast<int32_t>(call->args.size());
+  auto first = NewRegisters(argc);
+  for (int32_t i = 0; i < argc; i++) {
+    VisitForRegister(call->args[i], first + i);
+  }
+  Emit(Opcode::Call, {dst, callee, self, first, argc, AddNode(call)});
+}
+
+void BytecodeGenerator::VisitFunctionDecl(FunctionDecl* fn_decl) {
+  Emit(Opcode::DeclareFunction, {AddNode(fn_decl)});
+}
+
+void BytecodeGenerator::VisitStatement(Node* stmt) {
+  RegisterScope register_scope{this};
+  if (stmt->AsStatement()) {
+    stmt->Accept(this);
+  } else {
+    VisitForRegister(stmt);
+  }
+}
+
+void BytecodeGenerator::VisitForRegister(Node* expr, int32_t dst) {
+  RegisterScope register_scope{this};
+  auto result_register = result_register_;
+  result_register_ = dst;
+  expr->Accept(this);
+  result_register_ = result_register;
+}
+
+int32_t BytecodeGenerator::VisitForRegister(Node* expr) {
+  auto dst = NewRegister();
+  VisitForRegister(expr, dst);
+  return dst;
+}
+
+void BytecodeGenerator::VisitLoad(Expression* target, int32_t dst,
+                                  int32_t object, int32_t key) {
+  if (auto identifier = target->AsIdentifier()) {
+    if (identifier->IsResolved()) {
+      Emit(Opcode::LoadLocal, {dst, identifier->slot});
+    } else {
+      Emit(Opcode::LoadName, {dst, AddConstant(identifier->name)});
+    }
+  } else if (target->AsMemberAccess()) {
+    Emit(Opcode::LoadProperty, {dst, object, key, AddNode(target)});
+  } else {
+    throw UnsupportedError{};
+  }
+}
+
+void BytecodeGenerator::VisitStore(Expression* target, int32_t src,
+                                   int32_t object, int32_t key) {
+  if (auto identifier = target->AsIdentifier()) {
+    if (identifier->IsResolved()) {
+      Emit(Opcode::StoreLocal, {identifier->slot, src});
+    } else {
+      Emit(Opcode::StoreName, {AddConstant(identifier->name), src});
+    }
+  } else if (target->AsMemberAccess()) {
+    Emit(Opcode::StoreProperty, {object, key, src, AddNode(target)});
+  } else {
+    throw UnsupportedError{};
+  }
+}
+
+int32_t BytecodeGenerator::NewRegister() { return NewRegisters(1); }
+
+int32_t BytecodeGenerator::NewRegisters(int32_t count) {
+  auto first = next_register_;
+  next_register_ += count;
+  bytecode_->register_count =
+      std::max(bytecode_->register_count, next_register_);
+  return first;
+}
+
+int32_t BytecodeGenerator::AddConstant(Handle<Object> value) {
+  auto& constants = bytecode_->constants;
+  for (size_t i = 0; i < constants.size(); i++) {
+    if (constants[i] == value) {
+      return static_cast<int32_t>(i);
+    }
+  }
+  constants.push_back(value);
+  return static_cast<int32_t>(constants.size() - 1);
+}
+
+int32_t BytecodeGenerator::AddNode(Node* node) {
+  bytecode_->nodes.push_back(node);
+  return static_cast<int32_t>(bytecode_->nodes.size() - 1);
+}
+
+void BytecodeGenerator::Emit(Opcode opcode,
+                             std::initializer_list<int32_t> operands) {
+  assert(static_cast<int>(operands.size()) == Bytecode::OperandCount(opcode));
+  auto& code = bytecode_->code;
+  code.push_back(static_cast<int32_t>(opcode));
+  code.insert(code.end(), operands);
+}
+
+size_t BytecodeGenerator::EmitJump(Opcode opcode, int32_t src) {
+  if (opcode == Opcode::Jump) {
+    Emit(opcode, {0});
+  } else {
+    Emit(opcode, {src, 0});
+  }
+  return Position() - 1;
+}
+
+void BytecodeGenerator::PatchJump(size_t jump, size_t target) {
+  bytecode_->code[jump] = static_cast<int32_t>(target);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <initializer_list>
+#include <vector>
+#include "ast.hh"
+#include "bytecode.hh"
+
+namespace kipper {
+namespace internal {
+
+/// Lowers an AST into register-based bytecode.
+///
+/// Variables still live in Contexts because scoping is dynamic, registers
+/// only hold temporaries. Generate() returns nullptr for code the VM cannot
+/// run, the caller then keeps walking the AST.
+class BytecodeGenerator final : public NodeVisitor {
+ public:
+  static unique_ptr<Bytecode> Generate(TranslationUnit* unit);
+
+  static unique_ptr<Bytecode> Generate(FunctionDecl* fn_decl);
+
+#define DECLARE_VISIT(Node) void Visit##Node(Node*) override final;
+  VISIT_NODES(DECLARE_VISIT)
+#undef DECLARE_VISIT
+
+  static constexpr int kMaxBlockDepth = 64;
+
+ private:
+  struct Loop {
+    std::vector<size_t> breaks;
+    std::vector<size_t> continues;
+    int block_depth;
+  };
+
+  class RegisterScope {
+   public:
+    explicit RegisterScope(BytecodeGenerator* generator)
+        : generator_{generator}, next_register_{generator->next_register_} {}
+
+    ~RegisterScope() { generator_->next_register_ = next_register_; }
+
+   private:
+    BytecodeGenerator* generator_;
+    int32_t next_register_;
+  };
+
+  BytecodeGenerator() : bytecode_{std::make_unique<Bytecode>()} {}
+
+  unique_ptr<Bytecode> Finish();
+
+  void VisitStatement(Node* stmt);
+
+  void VisitForRegister(Node* expr, int32_t dst);
+
+  int32_t VisitForRegister(Node* expr);
+
+  void VisitLoad(Expression* target, int32_t dst, int32_t object, int32_t key);
+
+  void VisitStore(Expression* target, int32_t src, int32_t object,
+                  int32_t key);
+
+  void VisitLoop(Loop& loop, Node* condition, Node* update, Statement* body);
+
+  void VisitJumpToLoop(bool is_break);
+
+  int32_t NewRegister();
+
+  int32_t NewRegisters(int32_t count);
+
+  int32_t AddConstant(Handle<Object> value);
+
+  int32_t AddNode(Node* node);
+
+  void Emit(Opcode opcode, std::initializer_list<int32_t> operands = {});
+
+  size_t EmitJump(Opcode opcode, int32_t src = Bytecode::kNoRegister);
+
+  void PatchJump(size_t jump, size_t target);
+
+  size_t Position() const { return bytecode_->code.size(); }
+
+  unique_ptr<Bytecode> bytecode_;
+  std::vector<Loop*> loops_;
+  int32_t result_register_{Bytecode::kNoRegister};
+  int32_t next_register_{0};
+  int block_depth_{0};
+};
+
+}  // namespace internal
+}  // namespace kipper
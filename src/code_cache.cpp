@@ -0,0 +1,798 @@
+#include "code_cache.hh"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <unordered_map>
+#include "ast.hh"
+#include "compiler.hh"
+#include "heap.hh"
+#include "log.hh"
+#include "value.hh"
+
+using namespace kipper::internal;
+
+namespace fs = std::filesystem;
+
+std::string CodeCache::directory_;
+
+namespace {
+
+constexpr char kMagic[4] = {'K', 'S', 'C', 'C'};
+
+enum NodeKind : uint8_t {
+#define DECLARE_KIND(Node) k##Node,
+  VISIT_NODES(DECLARE_KIND)
+#undef DECLARE_KIND
+      kNullNode = 0xff
+};
+
+// What a field accepts, checked before a read node is cast to it.
+enum Category : uint8_t {
+  kStatementNode = 1,
+  kExpressionNode = 2,
+  kNameNode = 4,
+  kFunctionNode = 8,
+  kOptionalNode = 16,
+};
+
+constexpr uint8_t kCategories[] = {
+    0,                // TranslationUnit
+    kStatementNode,   // BlockStatement
+    kStatementNode,   // IfStatement
+    kStatementNode,   // WhileStatement
+    kStatementNode,   // ForStatement
+    kStatementNode,   // ReturnStatement
+    kStatementNode,   // BreakStatement
+    kStatementNode,   // ContinueStatement
+    kStatementNode,   // ExpressionStatement
+    kExpressionNode,  // Assignment
+    kExpressionNode,  // ConditionalExpression
+    kExpressionNode,  // BinaryExpression
+    kExpressionNode,  // UnaryExpression
+    kExpressionNode,  // PostfixExpression
+    kExpressionNode,  // MemberAccess
+    kExpressionNode,  // Identifier
+    kNameNode,        // IdentifierName
+    kExpressionNode,  // IntLiteral
+    kExpressionNode,  // DoubleLiteral
+    kExpressionNode,  // StringLiteral
+    kExpressionNode,  // BooleanLiteral
+    kExpressionNode,  // ArrayLiteral
+    kExpressionNode,  // ObjectLiteral
+    kExpressionNode,  // UndefinedLiteral
+    kExpressionNode,  // FunctionCall
+    kFunctionNode,    // FunctionDecl
+};
+static_assert(sizeof(kCategories) == kFunctionDecl + 1);
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint64_t hash;
+  uint32_t code_size;
+  uint32_t optimized;
+};
+
+// 64-bit FNV-1a of the code and the compilation flags.
+uint64_t HashSource(std::string_view code, bool optimized) {
+  uint64_t hash = 14695981039346656037ULL;
+  auto mix = [&hash](uint8_t byte) {
+    hash ^= byte;
+    hash *= 1099511628211ULL;
+  };
+  for (auto ch : code) {
+    mix(static_cast<uint8_t>(ch));
+  }
+  mix(static_cast<uint8_t>(CodeCache::kVersion));
+  mix(optimized);
+  return hash;
+}
+
+fs::path EntryPath(const std::string& directory, uint64_t hash) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.ksc",
+                static_cast<unsigned long long>(hash));
+  return fs::path{directory} / name;
+}
+
+class CodeWriter final : public NodeVisitor {
+ public:
+  explicit CodeWriter(const SourceFile* source) : source_{source} {}
+
+  /// Returns the entry: header, line starts, strings, then nodes.
+  std::string Write(TranslationUnit* unit, uint64_t hash, bool optimized);
+
+#define DECLARE_VISIT(Node) void Visit##Node(Node*) override final;
+  VISIT_NODES(DECLARE_VISIT)
+#undef DECLARE_VISIT
+
+ private:
+  void WriteUInt(uint64_t value, std::string& out) {
+    while (value >= 0x80) {
+      out += static_cast<char>(value | 0x80);
+      value >>= 7;
+    }
+    out += static_cast<char>(value);
+  }
+
+  void WriteUInt(uint64_t value) { WriteUInt(value, nodes_); }
+
+  void WriteInt(int64_t value) {
+    WriteUInt(static_cast<uint64_t>(value) << 1 ^ (value < 0 ? ~0ULL : 0));
+  }
+
+  /// Writes the range as the distance of its begin from the previous one
+  /// and its length, both small numbers in preorder.
+  void WriteRange(const SourceRange& range) {
+    auto begin = Offset(range.begin);
+    WriteInt(begin - last_begin_);
+    WriteInt(Offset(range.end) - begin);
+    last_begin_ = begin;
+  }
+
+  int64_t Offset(uint32_t position) {
+    return position ? position - source_->base + 1 : 0;
+  }
+
+  void WriteString(std::string_view value) {
+    auto index = strings_.emplace(value, strings_.size()).first->second;
+    WriteUInt(index);
+  }
+
+  void WriteNode(NodeKind kind, Node* node) {
+    nodes_ += static_cast<char>(kind);
+    WriteRange(node->loc);
+  }
+
+  void Visit(Node* node) {
+    if (node) {
+      node->Accept(this);
+    } else {
+      nodes_ += static_cast<char>(kNullNode);
+    }
+  }
+
+  template <class T>
+  void VisitList(const std::vector<T*>& nodes) {
+    WriteUInt(nodes.size());
+    for (auto node : nodes) {
+      Visit(node);
+    }
+  }
+
+  const SourceFile* source_;
+  std::unordered_map<std::string_view, size_t> strings_;
+  std::string nodes_;
+  int64_t last_begin_{0};
+};
+
+std::string CodeWriter::Write(TranslationUnit* unit, uint64_t hash,
+                              bool optimized) {
+  Visit(unit);
+  Header header{{}, CodeCache::kVersion, hash,
+                static_cast<uint32_t>(source_->code.size()), optimized};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  std::string out{reinterpret_cast<const char*>(&header), sizeof(header)};
+  WriteUInt(source_->line_starts.size(), out);
+  for (size_t i = 1; i < source_->line_starts.size(); i++) {
+    WriteUInt(source_->line_starts[i] - source_->line_starts[i - 1], out);
+  }
+  std::vector<std::string_view> strings(strings_.size());
+  for (auto& [value, index] : strings_) {
+    strings[index] = value;
+  }
+  WriteUInt(strings.size(), out);
+  for (auto value : strings) {
+    WriteUInt(value.size(), out);
+    out += value;
+  }
+  return out + nodes_;
+}
+
+void CodeWriter::VisitTranslationUnit(TranslationUnit* unit) {
+  WriteNode(kTranslationUnit, unit);
+  VisitList(unit->fn_decls);
+  VisitList(unit->stmts);
+}
+
+void CodeWriter::VisitBlockStatement(BlockStatement* block) {
+  WriteNode(kBlockStatement, block);
+  VisitList(block->stmts);
+}
+
+void CodeWriter::VisitIfStatement(IfStatement* if_stmt) {
+  WriteNode(kIfStatement, if_stmt);
+  Visit(if_stmt->condition);
+  Visit(if_stmt->then_stmt);
+  Visit(if_stmt->else_stmt);
+}
+
+void CodeWriter::VisitWhileStatement(WhileStatement* while_stmt) {
+  WriteNode(kWhileStatement, while_stmt);
+  Visit(while_stmt->condition);
+  Visit(while_stmt->loop_stmt);
+}
+
+void CodeWriter::VisitForStatement(ForStatement* for_stmt) {
+  WriteNode(kForStatement, for_stmt);
+  Visit(for_stmt->init);
+  Visit(for_stmt->condition);
+  Visit(for_stmt->update);
+  Visit(for_stmt->loop_stmt);
+}
+
+void CodeWriter::VisitReturnStatement(ReturnStatement* return_stmt) {
+  WriteNode(kReturnStatement, return_stmt);
+  Visit(return_stmt->value);
+}
+
+void CodeWriter::VisitBreakStatement(BreakStatement* stmt) {
+  WriteNode(kBreakStatement, stmt);
+}
+
+void CodeWriter::VisitContinueStatement(ContinueStatement* stmt) {
+  WriteNode(kContinueStatement, stmt);
+}
+
+void CodeWriter::VisitExpressionStatement(ExpressionStatement* stmt) {
+  WriteNode(kExpressionStatement, stmt);
+  Visit(stmt->expr);
+}
+
+void CodeWriter::VisitAssignment(Assignment* assignment) {
+  WriteNode(kAssignment, assignment);
+  WriteUInt(assignment->op);
+  Visit(assignment->target);
+  Visit(assignment->value);
+}
+
+void CodeWriter::VisitConditionalExpression(ConditionalExpression* expr) {
+  WriteNode(kConditionalExpression, expr);
+  Visit(expr->condition);
+  Visit(expr->then_expr);
+  Visit(expr->else_expr);
+}
+
+void CodeWriter::VisitBinaryExpression(BinaryExpression* expr) {
+  WriteNode(kBinaryExpression, expr);
+  WriteUInt(expr->op);
+  Visit(expr->left);
+  Visit(expr->right);
+}
+
+void CodeWriter::VisitUnaryExpression(UnaryExpression* expr) {
+  WriteNode(kUnaryExpression, expr);
+  WriteUInt(expr->op);
+  Visit(expr->target);
+}
+
+void CodeWriter::VisitPostfixExpression(PostfixExpression* expr) {
+  WriteNode(kPostfixExpression, expr);
+  WriteUInt(expr->op);
+  Visit(expr->target);
+}
+
+void CodeWriter::VisitMemberAccess(MemberAccess* member_access) {
+  WriteNode(kMemberAccess, member_access);
+  WriteUInt(member_access->type);
+  Visit(member_access->target);
+  Visit(member_access->member);
+}
+
+void CodeWriter::VisitIdentifier(Identifier* identifier) {
+  WriteNode(kIdentifier, identifier);
+  WriteString(identifier->name->Value());
+  WriteUInt(identifier->depth + 1);
+  WriteUInt(identifier->slot + 1);
+}
+
+void CodeWriter::VisitIdentifierName(IdentifierName* identifier) {
+  WriteNode(kIdentifierName, identifier);
+  WriteString(identifier->name->Value());
+}
+
+void CodeWriter::VisitIntLiteral(IntLiteral* literal) {
+  WriteNode(kIntLiteral, literal);
+  WriteUInt(static_cast<uint32_t>(Int32::Cast(*literal->value())->Value()));
+}
+
+void CodeWriter::VisitDoubleLiteral(DoubleLiteral* literal) {
+  WriteNode(kDoubleLiteral, literal);
+  auto value = Double::Cast(*literal->value())->Value();
+  nodes_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void CodeWriter::VisitStringLiteral(StringLiteral* literal) {
+  WriteNode(kStringLiteral, literal);
+  WriteString(literal->value()->Value());
+}
+
+void CodeWriter::VisitBooleanLiteral(BooleanLiteral* literal) {
+  WriteNode(kBooleanLiteral, literal);
+  WriteUInt(literal->value());
+}
+
+void CodeWriter::VisitArrayLiteral(ArrayLiteral* literal) {
+  WriteNode(kArrayLiteral, literal);
+  VisitList(literal->elements);
+}
+
+void CodeWriter::VisitObjectLiteral(ObjectLiteral* literal) {
+  WriteNode(kObjectLiteral, literal);
+  WriteUInt(literal->properties.size());
+  for (auto prop : literal->properties) {
+    WriteRange(prop->loc);
+    Visit(prop->name);
+    Visit(prop->value);
+  }
+}
+
+void CodeWriter::VisitUndefinedLiteral(UndefinedLiteral* literal) {
+  WriteNode(kUndefinedLiteral, literal);
+}
+
+void CodeWriter::VisitFunctionCall(FunctionCall* call) {
+  WriteNode(kFunctionCall, call);
+  Visit(call->target);
+  VisitList(call->args);
+}
+
+void CodeWriter::VisitFunctionDecl(FunctionDecl* fn_decl) {
+  WriteNode(kFunctionDecl, fn_decl);
+  WriteUInt(fn_decl->uses_arguments);
+  if (fn_decl->name) {
+    WriteUInt(1);
+    WriteString(fn_decl->name->Value());
+  } else {
+    WriteUInt(0);
+  }
+  VisitList(fn_decl->params);
+  WriteUInt(fn_decl->lazy);
+  if (fn_decl->lazy) {
+    WriteRange(fn_decl->body_loc);
+  } else {
+    VisitList(fn_decl->body);
+  }
+}
+
+/// Rebuilds the nodes of an entry. Every read is bounds checked, every node
+/// is checked to fit its field and every resolved identifier to name a
+/// binding of its function, so a damaged entry is reported by throwing a
+/// KError rather than trusted.
+class CodeReader {
+ public:
+  CodeReader(SourceFile* source, std::string_view data)
+      : source_{source}, data_{data} {}
+
+  unique_ptr<TranslationUnit> Read();
+
+ private:
+  template <class T = Node>
+  T* ReadNode(uint8_t categories) {
+    return static_cast<T*>(ReadAnyNode(categories));
+  }
+
+  Node* ReadAnyNode(uint8_t categories);
+
+  void ReadFunctionBody(FunctionDecl* fn_decl);
+
+  template <class T>
+  void ReadList(std::vector<T*>& nodes, uint8_t categories) {
+    auto size = ReadSize();
+    nodes.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+      nodes.push_back(ReadNode<T>(categories));
+    }
+  }
+
+  uint64_t ReadUInt() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      auto byte = static_cast<uint8_t>(ReadBytes(1)[0]);
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (byte < 0x80) {
+        return value;
+      }
+    }
+    throw KError{"malformed number in code cache entry"};
+  }
+
+  /// Reads a count of items taking at least one byte each.
+  size_t ReadSize() {
+    auto size = ReadUInt();
+    if (size > data_.size() - position_) {
+      throw KError{"truncated code cache entry"};
+    }
+    return size;
+  }
+
+  const char* ReadBytes(size_t size) {
+    if (size > data_.size() - position_) {
+      throw KError{"truncated code cache entry"};
+    }
+    auto result = data_.data() + position_;
+    position_ += size;
+    return result;
+  }
+
+  int64_t ReadInt() {
+    auto value = ReadUInt();
+    return static_cast<int64_t>(value >> 1 ^ (value & 1 ? ~0ULL : 0));
+  }
+
+  SourceRange ReadRange() {
+    auto begin = last_begin_ + ReadInt();
+    auto end = begin + ReadInt();
+    last_begin_ = begin;
+    return SourceRange{ToPosition(begin), ToPosition(end)};
+  }
+
+  uint32_t ToPosition(int64_t offset) {
+    if (offset < 0 || offset > static_cast<int64_t>(source_->code.size()) + 1) {
+      throw KError{"code cache entry position out of the source"};
+    }
+    return offset ? static_cast<uint32_t>(offset - 1) + source_->base : 0;
+  }
+
+  /// Reads an operator that `accepts` holds for, the one its node
+  /// evaluates.
+  template <typename Accepts>
+  Token::Kind ReadOperator(Accepts accepts) {
+    auto op = ReadUInt();
+    if (op >= Token::SIZE || !accepts(static_cast<Token::Kind>(op))) {
+      throw KError{"unknown operator in code cache entry"};
+    }
+    return static_cast<Token::Kind>(op);
+  }
+
+  std::string_view& ReadString() {
+    auto index = ReadUInt();
+    if (index >= strings_.size()) {
+      throw KError{"unknown string in code cache entry"};
+    }
+    return strings_[index];
+  }
+
+  /// Interns a string once for all the identifiers that use it.
+  Handle<String> ReadSymbol() {
+    auto& value = ReadString();
+    auto& symbol = symbols_[&value - strings_.data()];
+    if (!symbol) {
+      symbol = Handle{String::NewSymbol(value)};
+    }
+    return symbol;
+  }
+
+  int ReadSlot() { return static_cast<int>(ReadUInt()) - 1; }
+
+  /// Checks that `identifier` resolves where the ScopeAnalyzer would have
+  /// resolved it, so that running it stays within the function Context.
+  void CheckSlot(Identifier* identifier) {
+    if (identifier->depth < 0 && identifier->slot < 0) {
+      return;
+    }
+    auto slot = static_cast<size_t>(identifier->slot);
+    if (identifier->slot < 0 || slot >= locals_.size() ||
+        locals_[slot].Get() != identifier->name.Get() ||
+        identifier->depth != block_depth_) {
+      throw KError{"unresolvable identifier in code cache entry"};
+    }
+  }
+
+  SourceFile* source_;
+  std::string_view data_;
+  size_t position_{0};
+  int64_t last_begin_{0};
+  Zone* zone_{nullptr};
+  std::vector<std::string_view> strings_;
+  std::vector<Handle<String>> symbols_;
+  // The bindings of the function being read, as the ScopeAnalyzer lists
+  // them, and the blocks entered in it.
+  std::vector<Handle<String>> locals_;
+  int block_depth_{0};
+};
+
+unique_ptr<TranslationUnit> CodeReader::Read() {
+  position_ = sizeof(Header);
+  auto line_count = ReadSize();
+  std::vector<uint32_t> line_starts{0};
+  line_starts.reserve(line_count);
+  for (size_t i = 1; i < line_count; i++) {
+    line_starts.push_back(line_starts.back() +
+                          static_cast<uint32_t>(ReadUInt()));
+    if (line_starts.back() > source_->code.size()) {
+      throw KError{"code cache entry line out of the source"};
+    }
+  }
+  strings_.resize(ReadSize());
+  for (auto& value : strings_) {
+    auto size = ReadSize();
+    value = std::string_view{ReadBytes(size), size};
+  }
+  symbols_.resize(strings_.size());
+
+  if (ReadBytes(1)[0] != static_cast<char>(kTranslationUnit)) {
+    throw KError{"code cache entry does not start with a script"};
+  }
+  auto unit = std::make_unique<TranslationUnit>();
+  zone_ = &unit->zone;
+  unit->loc = ReadRange();
+  ReadList(unit->fn_decls, kFunctionNode);
+  ReadList(unit->stmts, kStatementNode);
+  if (position_ != data_.size()) {
+    throw KError{"trailing data in code cache entry"};
+  }
+  source_->line_starts = std::move(line_starts);
+  return unit;
+}
+
+Node* CodeReader::ReadAnyNode(uint8_t categories) {
+  auto kind = static_cast<uint8_t>(ReadBytes(1)[0]);
+  if (kind == kNullNode && (categories & kOptionalNode)) {
+    return nullptr;
+  }
+  if (kind >= sizeof(kCategories) || !(kCategories[kind] & categories)) {
+    throw KError{"misplaced node in code cache entry"};
+  }
+  auto loc = ReadRange();
+
+  constexpr uint8_t kExpression = kExpressionNode;
+  constexpr uint8_t kStatement = kStatementNode;
+  constexpr uint8_t kOptionalExpression = kExpression | kOptionalNode;
+  switch (kind) {
+    case kBlockStatement: {
+      auto block = CreateNode<BlockStatement>(zone_, loc);
+      block_depth_++;
+      ReadList(block->stmts, kStatement);
+      block_depth_--;
+      return block;
+    }
+    case kIfStatement: {
+      auto if_stmt = CreateNode<IfStatement>(zone_, loc);
+      if_stmt->condition = ReadNode<Expression>(kExpression);
+      if_stmt->then_stmt = ReadNode<Statement>(kStatement);
+      if_stmt->else_stmt = ReadNode<Statement>(kStatement | kOptionalNode);
+      return if_stmt;
+    }
+    case kWhileStatement: {
+      auto condition = ReadNode<Expression>(kExpression);
+      auto loop_stmt = ReadNode<Statement>(kStatement);
+      return CreateNode<WhileStatement>(zone_, loc, condition, loop_stmt);
+    }
+    case kForStatement: {
+      auto for_stmt = CreateNode<ForStatement>(zone_, loc);
+      for_stmt->init = ReadNode<Expression>(kOptionalExpression);
+      for_stmt->condition = ReadNode<Expression>(kOptionalExpression);
+      for_stmt->update = ReadNode<Expression>(kOptionalExpression);
+      for_stmt->loop_stmt = ReadNode<Statement>(kStatement);
+      return for_stmt;
+    }
+    case kReturnStatement: {
+      auto return_stmt = CreateNode<ReturnStatement>(zone_, loc);
+      return_stmt->value = ReadNode<Expression>(kOptionalExpression);
+      return return_stmt;
+    }
+    case kBreakStatement:
+      return CreateNode<BreakStatement>(zone_, loc);
+    case kContinueStatement:
+      return CreateNode<ContinueStatement>(zone_, loc);
+    case kExpressionStatement: {
+      auto stmt = CreateNode<ExpressionStatement>(zone_, loc);
+      stmt->expr = ReadNode<Expression>(kExpression);
+      return stmt;
+    }
+    case kAssignment: {
+      auto assignment = CreateNode<Assignment>(zone_, loc);
+      assignment->op = ReadOperator(Token::IsAssignmentOperator);
+      assignment->target = ReadNode<Expression>(kExpression);
+      assignment->value = ReadNode<Expression>(kExpression);
+      return assignment;
+    }
+    case kConditionalExpression: {
+      auto expr = CreateNode<ConditionalExpression>(zone_, loc);
+      expr->condition = ReadNode<Expression>(kExpression);
+      expr->then_expr = ReadNode<Expression>(kExpression);
+      expr->else_expr = ReadNode<Expression>(kExpression);
+      return expr;
+    }
+    case kBinaryExpression: {
+      auto op = ReadOperator(Token::IsBinaryOperator);
+      auto left = ReadNode<Expression>(kExpression);
+      auto right = ReadNode<Expression>(kExpression);
+      return CreateNode<BinaryExpression>(zone_, loc, left, right, op);
+    }
+    case kUnaryExpression: {
+      auto expr = CreateNode<UnaryExpression>(zone_, loc);
+      expr->op = ReadOperator([](Token::Kind op) {
+        return op == Token::PLUS || op == Token::SUB || op == Token::NOT ||
+               op == Token::INC || op == Token::DEC;
+      });
+      expr->target = ReadNode<Expression>(kExpression);
+      return expr;
+    }
+    case kPostfixExpression: {
+      auto op = ReadOperator(
+          [](Token::Kind op) { return op == Token::INC || op == Token::DEC; });
+      auto target = ReadNode<Expression>(kExpression);
+      return CreateNode<PostfixExpression>(zone_, loc, target, op);
+    }
+    case kMemberAccess: {
+      auto type = ReadUInt();
+      if (type > MemberAccess::DOTTED) {
+        throw KError{"unknown member access in code cache entry"};
+      }
+      auto target = ReadNode<Expression>(kExpression);
+      auto member = ReadNode(kExpression | kNameNode);
+      return CreateNode<MemberAccess>(zone_, loc, target, member,
+                                      static_cast<MemberAccess::Type>(type));
+    }
+    case kIdentifier: {
+      auto identifier = CreateNode<Identifier>(zone_, loc, ReadSymbol());
+      identifier->depth = ReadSlot();
+      identifier->slot = ReadSlot();
+      CheckSlot(identifier);
+      return identifier;
+    }
+    case kIdentifierName:
+      return CreateNode<IdentifierName>(zone_, loc, ReadSymbol());
+    case kIntLiteral: {
+      auto value = static_cast<int32_t>(static_cast<uint32_t>(ReadUInt()));
+      return CreateNode<IntLiteral>(zone_, loc, Handle{Int32::Make(value)});
+    }
+    case kDoubleLiteral: {
+      double value;
+      std::memcpy(&value, ReadBytes(sizeof(value)), sizeof(value));
+      return CreateNode<DoubleLiteral>(zone_, loc,
+                                       Handle{Double::Make(value)});
+    }
+    case kStringLiteral: {
+      auto value = Handle{String::New(ReadString(), TENURED)};
+      return CreateNode<StringLiteral>(zone_, loc, value);
+    }
+    case kBooleanLiteral:
+      return CreateNode<BooleanLiteral>(
+          zone_, loc, Constant::BooleanHandle(ReadUInt() != 0));
+    case kArrayLiteral: {
+      auto literal = CreateNode<ArrayLiteral>(zone_, loc);
+      ReadList(literal->elements, kExpression);
+      return literal;
+    }
+    case kObjectLiteral: {
+      auto literal = CreateNode<ObjectLiteral>(zone_, loc);
+      auto size = ReadSize();
+      literal->properties.reserve(size);
+      for (size_t i = 0; i < size; i++) {
+        auto prop = CreateNode<PropertyAssignment>(zone_, ReadRange());
+        prop->name = ReadNode(kExpression | kNameNode);
+        prop->value = ReadNode<Expression>(kExpression);
+        literal->properties.push_back(prop);
+      }
+      return literal;
+    }
+    case kUndefinedLiteral:
+      return CreateNode<UndefinedLiteral>(zone_, loc);
+    case kFunctionCall: {
+      auto call = CreateNode<FunctionCall>(zone_, loc,
+                                           ReadNode<Expression>(kExpression));
+      ReadList(call->args, kExpression);
+      return call;
+    }
+    case kFunctionDecl: {
+      auto fn_decl = CreateNode<FunctionDecl>(zone_, loc);
+      fn_decl->uses_arguments = ReadUInt() != 0;
+      if (!ReadUInt()) {
+        throw KError{"unnamed function in code cache entry"};
+      }
+      fn_decl->name = ReadSymbol();
+      ReadList(fn_decl->params, kNameNode);
+      fn_decl->lazy = ReadUInt() != 0;
+      if (!fn_decl->lazy) {
+        ReadFunctionBody(fn_decl);
+        return fn_decl;
+      }
+      fn_decl->body_loc = ReadRange();
+      if (fn_decl->body_loc.begin == 0) {
+        throw KError{"lazy function body out of the source"};
+      }
+      fn_decl->zone = zone_;
+      return fn_decl;
+    }
+  }
+  UNREACHABLE();
+  return nullptr;
+}
+
+void CodeReader::ReadFunctionBody(FunctionDecl* fn_decl) {
+  // Mirrors ScopeAnalyzer::VisitFunctionDecl. `arguments_` only gets its
+  // slot in the Context of functions that use it.
+  std::vector<Handle<String>> locals;
+  for (auto param : fn_decl->params) {
+    auto name = param->name;
+    if (std::none_of(locals.begin(), locals.end(), [name](auto local) {
+          return local.Get() == name.Get();
+        })) {
+      locals.push_back(name);
+    }
+  }
+  if (fn_decl->uses_arguments) {
+    locals.push_back(Handle{String::Cast(Heap::arguments_symbol())});
+  }
+  std::swap(locals_, locals);
+  auto block_depth = block_depth_;
+  block_depth_ = 0;
+  ReadList(fn_decl->body, kStatementNode);
+  block_depth_ = block_depth;
+  std::swap(locals_, locals);
+}
+
+}  // namespace
+
+unique_ptr<TranslationUnit> CodeCache::Load(SourceFile* source,
+                                            bool optimized) {
+  if (!enabled()) {
+    return nullptr;
+  }
+  auto hash = HashSource(source->code, optimized);
+  std::ifstream istrm{EntryPath(directory_, hash),
+                      std::ios::in | std::ios::binary | std::ios::ate};
+  if (!istrm.is_open()) {
+    return nullptr;
+  }
+  std::string data(static_cast<size_t>(istrm.tellg()), '\0');
+  istrm.seekg(0, std::ios::beg);
+  istrm.read(data.data(), data.size());
+
+  Header header;
+  if (!istrm || data.size() < sizeof(header)) {
+    return nullptr;
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.hash != hash ||
+      header.code_size != source->code.size() ||
+      header.optimized != optimized) {
+    return nullptr;
+  }
+  try {
+    return CodeReader{source, data}.Read();
+  } catch (const KError& e) {
+    LOG_DEBUG("KS ignores code cache entry of {}: {}", source->filename,
+              e.what());
+    return nullptr;
+  }
+}
+
+void CodeCache::Store(SourceFile* source, TranslationUnit* unit,
+                      bool optimized) {
+  if (!enabled()) {
+    return;
+  }
+  auto hash = HashSource(source->code, optimized);
+  auto data = CodeWriter{source}.Write(unit, hash, optimized);
+
+  // Written aside and renamed, so that concurrent compilations of the same
+  // script never read a partial entry.
+  std::error_code error;
+  fs::create_directories(directory_, error);
+  auto path = EntryPath(directory_, hash);
+  auto temp = path;
+  temp += ".tmp" + std::to_string(std::random_device{}());
+  {
+    std::ofstream ostrm{temp, std::ios::out | std::ios::binary};
+    ostrm.write(data.data(), data.size());
+    if (!ostrm) {
+      LOG_DEBUG("KS fails to write code cache entry {}", temp.string());
+      ostrm.close();
+      fs::remove(temp, error);
+      return;
+    }
+  }
+  fs::rename(temp, path, error);
+  if (error) {
+    LOG_DEBUG("KS fails to write code cache entry {}: {}", path.string(),
+              error.message());
+    fs::remove(temp, error);
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include "kipper.hh"
+
+namespace kipper {
+namespace internal {
+
+struct SourceFile;
+struct TranslationUnit;
+
+/// On-disk cache of analyzed ASTs.
+///
+/// An entry holds the line table, the strings and the nodes of a script, the
+/// nodes in preorder with their source ranges relative to the script and the
+/// slots the ScopeAnalyzer resolved. Lazy function bodies are stored as their
+/// source range and still parsed on their first call. Entries are named by a
+/// 64-bit FNV-1a hash of the source code and the compilation flags, and are
+/// checked against the code size and the full hash before use, so an edited
+/// script simply misses. Nothing is cached while the directory is empty.
+class CodeCache : public AllStatic {
+ public:
+  static void SetDirectory(std::string_view directory) {
+    directory_ = directory;
+  }
+
+  static bool enabled() { return !directory_.empty(); }
+
+  /// Returns the cached AST of `source` and fills in its line starts, or
+  /// nullptr if there is no valid entry.
+  static unique_ptr<TranslationUnit> Load(SourceFile* source, bool optimized);
+
+  /// Writes the AST of `source`; failures only cost the next compilation.
+  static void Store(SourceFile* source, TranslationUnit* unit, bool optimized);
+
+  /// Bump whenever the nodes, their fields or the Token kinds change.
+  static constexpr uint32_t kVersion = 2;
+
+ private:
+  static std::string directory_;
+};
+
+}  // namespace internal
+}  // namespace kipper
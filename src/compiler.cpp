@@ -1,17 +1,32 @@
 #include "compiler.hh"
+#include <algorithm>
 #include <iostream>
-#include <unordered_map>
+#include <limits>
+#include <mutex>
 #include "ast.hh"
+#include "ast_optimizer.hh"
 #include "ast_print.hh"
+#include "code_cache.hh"
 #include "kipper.hh"
 #include "log.hh"
+#include "mapped_file.hh"
 #include "message.hh"
 #include "parser.hh"
+#include "profiler.hh"
 #include "scanner.hh"
+#include "scope_analyzer.hh"
 
 using namespace kipper::internal;
 
-static std::unordered_map<std::string_view, std::string_view> scripts;
+// The registered sources, sorted by base. Position 0 stands for code
+// without a source, and the positions of a deleted source are handed out
+// again.
+static std::vector<SourceFile*> sources;
+// Syntax errors resolve their location on the CompileJob workers.
+static std::mutex sources_mutex;
+
+bool Compiler::optimization_enabled_{true};
+bool Compiler::lazy_parsing_enabled_{true};
 
 class CodeStreamBuf : public std::streambuf {
  public:
@@ -21,16 +36,113 @@ class CodeStreamBuf : public std::streambuf {
   }
 };
 
-Node::Ptr Compiler::Compile(std::string_view code, std::string_view filename) {
-  LOG_DEBUG("KS compiles file: {}", filename);
-  if (!filename.empty()) {
-    scripts[filename] = code;
+// Gives `source`, whose code is set, the first free positions that fit it,
+// after the last source while there is room.
+static SourceFilePtr AddSource(unique_ptr<SourceFile> source) {
+  std::lock_guard lock{sources_mutex};
+  uint64_t size = source->code.size() + 1;
+  constexpr uint64_t kLimit = std::numeric_limits<uint32_t>::max();
+  auto end = [](SourceFile* source) {
+    return uint64_t{source->base} + source->code.size() + 1;
+  };
+  uint64_t base = sources.empty() ? 1 : end(sources.back());
+  auto it = sources.end();
+  if (base + size > kLimit) {
+    base = 1;
+    for (it = sources.begin(); it != sources.end(); base = end(*it++)) {
+      if (base + size <= (*it)->base) {
+        break;
+      }
+    }
+    if (it == sources.end()) {
+      throw KError{"compiled source code exceeds the 4 GB position space"};
+    }
+  }
+  source->base = static_cast<uint32_t>(base);
+  sources.insert(it, source.get());
+  return SourceFilePtr{source.release()};
+}
+
+static SourceFilePtr AddSource(std::string_view code,
+                               std::string_view filename) {
+  auto source = std::make_unique<SourceFile>();
+  source->filename = filename;
+  source->buffer = code;
+  source->code = source->buffer;
+  return AddSource(std::move(source));
+}
+
+void SourceFileDeleter::operator()(SourceFile* source) const {
+  {
+    std::lock_guard lock{sources_mutex};
+    auto it = std::lower_bound(
+        sources.begin(), sources.end(), source->base,
+        [](SourceFile* source, uint32_t base) { return source->base < base; });
+    assert(it != sources.end() && *it == source);
+    sources.erase(it);
+  }
+  delete source;
+}
+
+static SourceFile* FindSource(uint32_t position) {
+  std::lock_guard lock{sources_mutex};
+  auto find = std::upper_bound(
+      sources.begin(), sources.end(), position,
+      [](uint32_t position, auto source) { return position < source->base; });
+  return find == sources.begin() ? nullptr : *(find - 1);
+}
+
+// Runs the passes following the parser on the AST of `source`.
+static void Analyze(SourceFile* source, TranslationUnit* unit,
+                    bool optimization_enabled) {
+  if (optimization_enabled) {
+    AstOptimizer::Optimize(unit);
+  }
+  ScopeAnalyzer::Analyze(unit);
+  CodeCache::Store(source, unit, optimization_enabled);
+}
+
+unique_ptr<Node> Compiler::Compile(std::string_view code,
+                                   std::string_view filename) {
+  return Compile(AddSource(code, filename));
+}
+
+unique_ptr<Node> Compiler::Compile(std::istream& input,
+                                   std::string_view filename) {
+  constexpr size_t kChunkSize = 64 * KB;
+  auto source = std::make_unique<SourceFile>();
+  source->filename = filename;
+  auto& buffer = source->buffer;
+  while (input) {
+    auto size = buffer.size();
+    buffer.resize(size + kChunkSize);
+    input.read(buffer.data() + size, kChunkSize);
+    buffer.resize(size + static_cast<size_t>(input.gcount()));
   }
+  if (input.bad()) {
+    throw KError{"failed to read " + source->filename};
+  }
+  source->code = buffer;
+  return Compile(AddSource(std::move(source)));
+}
 
-  auto loc = Location{filename};
-  Parser parser{code, loc};
+unique_ptr<Node> Compiler::CompileFile(std::string_view path) {
+  auto source = std::make_unique<SourceFile>();
+  source->filename = path;
+  source->file = std::make_unique<MappedFile>(source->filename);
+  source->code = source->file->contents();
+  return Compile(AddSource(std::move(source)));
+}
 
-  Node::Ptr result = parser.Parse();
+unique_ptr<Node> Compiler::Compile(SourceFilePtr source) {
+  LOG_DEBUG("KS compiles file: {}", source->filename);
+  auto result = CodeCache::Load(source.get(), optimization_enabled_);
+  if (result == nullptr) {
+    Parser parser{source.get()};
+    result = parser.Parse();
+    Analyze(source.get(), result.get(), optimization_enabled_);
+  }
+  result->source = std::move(source);
 
 #if !defined(NDEBUG) && defined(ENABLE_AST_PRINT)
   AstPrinter ast_printer{std::cout};
@@ -40,47 +152,93 @@ Node::Ptr Compiler::Compile(std::string_view code, std::string_view filename) {
   return result;
 }
 
-std::string_view Compiler::GetLocationSourceCode(
-    const Location& loc) {
-  if (loc.begin.filename.empty()) {
-    return std::string_view{};
+void Compiler::CompileFunction(FunctionDecl* fn_decl) {
+  assert(fn_decl->lazy);
+  LOG_DEBUG("KS compiles function: {}", fn_decl->name->Value());
+  // The AST outlives the HandleScopes of the running code.
+  auto source = FindSource(fn_decl->loc.begin);
+  PersistentHandleScope handle_scope{&source->handles};
+  Parser parser{source};
+  parser.ParseLazyFunction(fn_decl);
+  if (optimization_enabled_) {
+    AstOptimizer::Optimize(fn_decl);
   }
-  auto find = scripts.find(loc.begin.filename);
-  if (find == scripts.end()) {
-    return std::string_view{};
+  ScopeAnalyzer::Analyze(fn_decl);
+}
+
+CompileJob::CompileJob(std::string_view code, std::string_view filename)
+    : source_{AddSource(code, filename)} {
+  LOG_DEBUG("KS compiles file in the background: {}", filename);
+  unit_ = CodeCache::Load(source_.get(), Compiler::optimization_enabled_);
+  if (unit_) {
+    cached_ = true;
+    done_ = true;
+    return;
   }
-  auto script = find->second;
-  auto current_line = 1;
-  auto current_column = 1;
-  auto source_start = 0;
-  auto source_end = 0;
-  for (auto ch : script) {
-    if (current_line == loc.begin.line && current_column == loc.begin.column) {
-      break;
-    }
-    if (ch != '\n') {
-      current_column++;
-    } else {
-      current_column = 1;
-      current_line++;
-    }
-    source_start++;
+  worker_ = std::thread{&CompileJob::Parse, this};
+}
+
+CompileJob::~CompileJob() {
+  if (worker_.joinable()) {
+    worker_.join();
   }
-  source_end = source_start;
-  for (auto ch : script.substr(source_start)) {
-    if (current_line == loc.end.line && current_column == loc.end.column) {
-      break;
-    }
-    if (ch != '\n') {
-      current_column++;
-    } else {
-      current_column = 1;
-      current_line++;
+}
+
+void CompileJob::Parse() {
+  Profiler::BlockSamplingOnThisThread();
+  try {
+    Parser parser{source_.get()};
+    unit_ = parser.Parse(&deferred_);
+  } catch (...) {
+    error_ = std::current_exception();
+  }
+  done_ = true;
+}
+
+unique_ptr<Node> CompileJob::Finish() {
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+  if (!unit_) {
+    return nullptr;
+  }
+  if (!cached_) {
+    for (auto& value : deferred_) {
+      value.Allocate();
     }
-    source_end++;
+    deferred_.clear();
+    Analyze(source_.get(), unit_.get(), Compiler::optimization_enabled_);
   }
-  if (source_end >= source_start) {
-    return script.substr(source_start, source_end - source_start);
+  unit_->source = std::move(source_);
+  return std::move(unit_);
+}
+
+static Position Resolve(const SourceFile& source, uint32_t position) {
+  auto offset = position - source.base;
+  auto& line_starts = source.line_starts;
+  auto line = std::upper_bound(line_starts.begin(), line_starts.end(), offset) -
+              line_starts.begin();
+  return Position{source.filename, static_cast<unsigned>(line),
+                  offset - line_starts[line - 1] + 1};
+}
+
+Location Compiler::Resolve(const SourceRange& range) {
+  auto source = FindSource(range.begin);
+  if (source == nullptr) {
+    return Location{};
+  }
+  return Location{::Resolve(*source, range.begin),
+                  ::Resolve(*source, range.end)};
+}
+
+std::string_view Compiler::GetLocationSourceCode(const SourceRange& range) {
+  auto source = FindSource(range.begin);
+  if (source == nullptr || range.end < range.begin) {
+    return std::string_view{};
   }
-  return std::string_view{};
+  return std::string_view{source->code}.substr(range.begin - source->base,
+                                               range.end - range.begin);
 }
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <atomic>
+#include <exception>
+#include <iosfwd>
 #include <string>
+#include <thread>
+#include <vector>
 #include "handle.hh"
 #include "kipper.hh"
 #include "location.hh"
@@ -8,24 +13,122 @@
 namespace kipper {
 namespace internal {
 
+class MappedFile;
 class String;
+struct DeferredValue;
+struct FunctionDecl;
 struct Node;
+struct TranslationUnit;
 
 class KSSyntaxError : public KSError {
  public:
-  KSSyntaxError(const Location& loc, const char* message)
+  KSSyntaxError(const SourceRange& loc, const char* message)
       : KSError{loc, message} {}
 
-  KSSyntaxError(const Location& loc, const std::string& message)
+  KSSyntaxError(const SourceRange& loc, const std::string& message)
       : KSError{loc, message} {}
 };
 
+/// A compiled script, at positions [base, base + code.size()] of the
+/// position space SourceRanges refer to.
+struct SourceFile {
+  std::string filename;
+  /// Points into `buffer` or `file`, and is followed by a '\0'. Kept with
+  /// the script since function bodies are parsed on their first call.
+  std::string_view code;
+  uint32_t base;
+  /// Offsets of the line starts from `base`, filled in by the Scanner.
+  std::vector<uint32_t> line_starts{0};
+  std::string buffer;
+  unique_ptr<MappedFile> file;
+  /// Handles of the function bodies parsed on their first call, freed with
+  /// the script.
+  PersistentHandles handles;
+};
+
+/// Unregisters a SourceFile, freeing its positions for later sources.
+struct SourceFileDeleter {
+  void operator()(SourceFile* source) const;
+};
+
+/// Owns a registered SourceFile. The TranslationUnit compiled from it holds
+/// it, so a source lives exactly as long as its script.
+using SourceFilePtr = std::unique_ptr<SourceFile, SourceFileDeleter>;
+
 class Compiler {
  public:
+  /// Compiles a copy of `code`.
   static unique_ptr<Node> Compile(std::string_view code,
                                   std::string_view filename);
 
-  static std::string_view GetLocationSourceCode(const Location& loc);
+  /// Compiles the code read from `input` in chunks, without another copy.
+  static unique_ptr<Node> Compile(std::istream& input,
+                                  std::string_view filename);
+
+  /// Compiles the file at `path` from a MappedFile.
+  static unique_ptr<Node> CompileFile(std::string_view path);
+
+  /// Runs the AstOptimizer on compiled code when enabled (the default).
+  static void EnableOptimization(bool enabled) {
+    optimization_enabled_ = enabled;
+  }
+
+  /// Only pre-parses function bodies at first, parsing each one on its first
+  /// call through CompileFunction() (the default).
+  static void EnableLazyParsing(bool enabled) {
+    lazy_parsing_enabled_ = enabled;
+  }
+
+  static bool lazy_parsing_enabled() { return lazy_parsing_enabled_; }
+
+  /// Parses, optimizes and analyzes the body of a lazy `fn_decl`.
+  static void CompileFunction(FunctionDecl* fn_decl);
+
+  /// Returns the file, line and column of `range`.
+  static Location Resolve(const SourceRange& range);
+
+  static std::string_view GetLocationSourceCode(const SourceRange& range);
+
+ private:
+  static unique_ptr<Node> Compile(SourceFilePtr source);
+
+  static bool optimization_enabled_;
+  static bool lazy_parsing_enabled_;
+
+  friend class CompileJob;
+};
+
+/// A script scanned and parsed on a worker thread.
+///
+/// The worker leaves the heap alone: the parser records the names and
+/// literals of the script instead of allocating them, and Finish() allocates
+/// them on the calling thread before optimizing and analyzing the AST as
+/// Compiler::Compile() does. A script found in the CodeCache needs no
+/// worker.
+class CompileJob {
+ public:
+  CompileJob(std::string_view code, std::string_view filename);
+
+  /// Waits for the worker, a job must not be dropped while it parses.
+  ~CompileJob();
+
+  /// Whether the worker is done, Finish() then does not block.
+  bool done() const { return done_; }
+
+  /// Waits for the worker and returns the script, or throws its syntax
+  /// error.
+  unique_ptr<Node> Finish();
+
+ private:
+  void Parse();
+
+  SourceFilePtr source_;
+  unique_ptr<TranslationUnit> unit_;
+  std::vector<DeferredValue> deferred_;
+  bool cached_{false};
+  std::exception_ptr error_;
+  std::atomic<bool> done_{false};
+  std::thread worker_;
 };
 
 }  // namespace internal
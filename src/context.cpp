@@ -4,33 +4,30 @@
 
 using namespace kipper::internal;
 
-#define RESOLVE_CONTEXT(_context, name)                                 \
-  do {                                                                  \
-    for (auto i = (_context)->chunks_.size() - 2; i > 0; i -= 2) {      \
-      if (*reinterpret_cast<String**>((_context)->chunks_.data()[i]) == \
-          (name).get()) {                                               \
-        return Handle((_context)->chunks_.data()[i + 1]);               \
-      }                                                                 \
-    }                                                                   \
-  } while (false)
+// Chunks beyond the inline one, linked through their first slot once
+// released. Blocks are entered over and over by loops, recycling keeps them
+// off the allocator.
+static Object** free_var_chunks{nullptr};
 
-static constexpr int kContextChunkLimit = 1 << 4;
-
-inline static Object** AllocateVarChunk() {
-  return static_cast<Object**>(
-      Allocator::AllocateArray(kPointerSize, kContextChunkLimit));
+inline static Object** AllocateVarChunk(int size) {
+  if (auto chunk = free_var_chunks; chunk) {
+    free_var_chunks = reinterpret_cast<Object**>(*chunk);
+    return chunk;
+  }
+  return static_cast<Object**>(Allocator::AllocateArray(kPointerSize, size));
 }
 
 inline static void DeallocateVarChunk(Object** chunk) {
-  return Allocator::DeallocateArray(chunk, kPointerSize, kContextChunkLimit);
+  *chunk = reinterpret_cast<Object*>(free_var_chunks);
+  free_var_chunks = chunk;
 }
 
 Context::Context(Context* parent)
     : parent_{parent},
       next_{nullptr},
       chunks_{List<Object**>{0}},
-      chunk_start_{nullptr},
-      chunk_end_{nullptr} {
+      chunk_start_{slots_},
+      chunk_end_{slots_ + kChunkSlots} {
   if (parent_) {
     parent_->next_ = this;
   }
@@ -40,7 +37,9 @@ Context::~Context() {
   for (auto i = 0; i < chunks_.size(); i++) {
     DeallocateVarChunk(chunks_[i]);
   }
-  parent_->next_ = nullptr;
+  if (parent_) {
+    parent_->next_ = nullptr;
+  }
 }
 
 Handle<Object> Context::Resolve(String* name) {
@@ -57,9 +56,9 @@ Handle<Object> Context::Push(String* name, Object* value) {
     return result;
   }
   if (chunk_start_ == chunk_end_) {
-    chunk_start_ = AllocateVarChunk();
+    chunk_start_ = AllocateVarChunk(kChunkSlots);
     chunks_.Add(chunk_start_);
-    chunk_end_ = chunk_start_ + kContextChunkLimit;
+    chunk_end_ = chunk_start_ + kChunkSlots;
   }
   *chunk_start_ = name;
   auto value_handle = chunk_start_ + 1;
@@ -68,67 +67,71 @@ Handle<Object> Context::Push(String* name, Object* value) {
   return Handle{value_handle};
 }
 
+Handle<Object> Context::Slot(int index) {
+  constexpr int kVarsPerChunk = kChunkSlots >> 1;
+  auto chunk_index = index / kVarsPerChunk;
+  assert(chunk_index <= chunks_.size());
+  auto chunk = chunk_index == 0 ? slots_ : chunks_[chunk_index - 1];
+  return Handle{chunk + (index % kVarsPerChunk) * 2 + 1};
+}
+
 void Context::IterateContext(ObjectVisitor* visitor) {
   IterateContextInternal(Heap::GlobalContext(), visitor);
 }
 
+template <class Visitor>
+bool Context::ForEachChunk(Visitor visitor) {
+  for (auto i = 0, last = chunks_.size(); i <= last; i++) {
+    auto chunk = i == 0 ? slots_ : chunks_[i - 1];
+    if (visitor(chunk, i == last ? chunk_start_ : chunk + kChunkSlots)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 Handle<Object> Context::Search(String* name) {
   for (auto ctx_it = this; ctx_it; ctx_it = ctx_it->parent_) {
-    if (ctx_it->chunk_start_) {
-      for (auto symbol_it = ctx_it->chunks_.Last();
-           symbol_it != ctx_it->chunk_start_; symbol_it += 2) {
-        if (*reinterpret_cast<String**>(symbol_it) == name) {
-          return Handle{symbol_it + 1};
-        }
-      }
-      for (auto i = 0, len = ctx_it->chunks_.size() - 1; i < len; i++) {
-        for (auto symbol_it = ctx_it->chunks_[i],
-                  obj_end = ctx_it->chunks_[i] + kContextChunkLimit;
-             symbol_it != obj_end; symbol_it += 2) {
-          if (*reinterpret_cast<String**>(symbol_it) == name) {
-            return Handle{symbol_it + 1};
-          }
-        }
-      }
+    if (auto result = ctx_it->SearchCurrentContext(name); result) {
+      return result;
     }
   }
   return Handle<Object>{};
 }
 
 Handle<Object> Context::SearchCurrentContext(String* name) {
-  if (chunk_start_) {
-    for (auto symbol_it = chunks_.Last(), end = chunk_start_ - 2;
-         symbol_it != end; symbol_it += 2) {
+  Object** value = nullptr;
+  ForEachChunk([name, &value](Object** symbol_it, Object** end) {
+    for (; symbol_it != end; symbol_it += 2) {
       if (*reinterpret_cast<String**>(symbol_it) == name) {
-        return Handle{symbol_it + 1};
+        value = symbol_it + 1;
+        return true;
       }
     }
-    for (auto i = chunks_.size() - 2; i >= 0; i--) {
-      for (auto symbol = chunks_[i] + kContextChunkLimit - 2, end = chunks_[i];
-           symbol != end; symbol -= 2) {
-        if (*reinterpret_cast<String**>(symbol) == name) {
-          return Handle{symbol + 1};
-        }
-      }
+    return false;
+  });
+  return Handle{value};
+}
+
+std::vector<std::pair<String*, Object*>> Context::Variables() {
+  std::vector<std::pair<String*, Object*>> variables;
+  ForEachChunk([&variables](Object** symbol_it, Object** end) {
+    for (; symbol_it != end; symbol_it += 2) {
+      variables.emplace_back(reinterpret_cast<String*>(symbol_it[0]),
+                             symbol_it[1]);
     }
-  }
-  return Handle<Object>{};
+    return false;
+  });
+  return variables;
 }
 
 void Context::IterateContextInternal(Context* ctx, ObjectVisitor* visitor) {
   for (auto ctx_it = ctx; ctx_it; ctx_it = ctx_it->next_) {
-    if (ctx_it->chunk_start_) {
-      for (auto obj_it = ctx_it->chunks_.Last(); obj_it != ctx_it->chunk_start_;
-           obj_it++) {
+    ctx_it->ForEachChunk([visitor](Object** obj_it, Object** end) {
+      for (; obj_it != end; obj_it++) {
         visitor->Visit(obj_it);
       }
-      for (auto i = 0, len = ctx_it->chunks_.size() - 1; i < len; i++) {
-        for (auto obj_it = ctx_it->chunks_[i],
-                  obj_end = ctx_it->chunks_[i] + kContextChunkLimit;
-             obj_it != obj_end; obj_it++) {
-          visitor->Visit(obj_it);
-        }
-      }
-    }
+      return false;
+    });
   }
 }
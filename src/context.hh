@@ -1,5 +1,7 @@
 #pragma once
 
+#include <utility>
+#include <vector>
 #include "handle.hh"
 #include "kipper.hh"
 #include "list.hh"
@@ -10,6 +12,11 @@ namespace internal {
 class Object;
 class String;
 
+/// Variables of a function or block scope.
+///
+/// The first name/value chunk is stored inline so that scopes declaring only
+/// a few variables never allocate, further chunks are recycled through a
+/// free list.
 class Context {
  public:
   using Ptr = unique_ptr<Context>;
@@ -22,6 +29,18 @@ class Context {
 
   Handle<Object> Push(String* name, Object* value);
 
+  /// Returns the variable pushed `index`-th into this context.
+  Handle<Object> Slot(int index);
+
+  /// Names and values of the variables, in the order they were pushed.
+  std::vector<std::pair<String*, Object*>> Variables();
+
+  /// Values of the variables stored inline, the one pushed `index`-th is at
+  /// InlineSlots()[index * 2] for index < kInlineVariables.
+  Object** InlineSlots() { return slots_ + 1; }
+
+  static constexpr int kInlineVariables = 8;
+
   Context* parent() { return parent_; }
 
   Handle<Object> self() const { return self_; }
@@ -30,11 +49,19 @@ class Context {
 
   static void IterateContext(ObjectVisitor* visitor);
 
+  DISABLE_DEFAULT_OP(Context)
  private:
+  static constexpr int kChunkSlots = kInlineVariables * 2;
+
   Handle<Object> Search(String* name);
 
   Handle<Object> SearchCurrentContext(String* name);
 
+  /// Calls `visitor(begin, end)` on the used part of every chunk until it
+  /// returns true.
+  template <class Visitor>
+  bool ForEachChunk(Visitor visitor);
+
   static void IterateContextInternal(Context* ctx, ObjectVisitor* visitor);
 
   Context* parent_;
@@ -43,6 +70,7 @@ class Context {
   Object** chunk_start_;
   Object** chunk_end_;
   Handle<Object> self_;
+  Object* slots_[kChunkSlots];
 };
 
 }  // namespace internal
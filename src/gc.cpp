@@ -274,6 +274,17 @@ void CopyingCollector::WriteBarrier(HeapObject* obj) {
   }
 }
 
+// Young objects are not traced by the mark-compact collector, so each of them
+// keeps the old objects it refers to alive and gets those references adjusted.
+static void IterateNewSpaceObjects(ObjectVisitor* visitor) {
+  auto scan = Heap::new_space()->ToSpaceLow();
+  while (scan < Heap::new_space()->free) {
+    auto obj = HeapObject::Make(scan);
+    obj->IterateBody(visitor);
+    scan += obj->Size();
+  }
+}
+
 void MarkCompactCollector::Collect() {
   Mark();
   Compact();
@@ -282,6 +293,7 @@ void MarkCompactCollector::Collect() {
 void MarkCompactCollector::Mark() {
   MarkObjectVisitor mark_object_visitor;
   Heap::IterateRoots(&mark_object_visitor);
+  IterateNewSpaceObjects(&mark_object_visitor);
   CleanupSymbolTable();
 }
 
@@ -310,6 +322,7 @@ void MarkCompactCollector::AdjustPtr() {
   AdjustPtrVisitor adjust_ptr_visitor;
   Heap::IterateRoots(&adjust_ptr_visitor);
   Heap::IterateSymbolTable(&adjust_ptr_visitor);
+  IterateNewSpaceObjects(&adjust_ptr_visitor);
 
   RSetAdjustPtrObjectVisitor rset_adjust_ptr_visitor;
   IterateRSet(Heap::old_space(), &rset_adjust_ptr_visitor);
@@ -336,7 +349,7 @@ void MarkCompactCollector::MoveObject() {
     auto obj_size = obj->Size();
     if (metadata.IsMarked()) {
       auto new_addr_obj = metadata.Forwarding();
-      memcpy(new_addr_obj->address(), obj->address(), obj_size);
+      memmove(new_addr_obj->address(), obj->address(), obj_size);
       auto new_metadata = new_addr_obj->metadata();
       new_metadata.ResetForwarding();
       new_metadata.ResetMarked();
@@ -8,17 +8,34 @@ static constexpr int kHandleSize = 1 * KB;
 
 HandleArea HandleScope::current_ = {nullptr, nullptr, 0};
 HandleScope::HandleList HandleScope::handles_ = HandleList{0};
+PersistentHandles* HandleScope::persistent_{nullptr};
+PersistentHandles* PersistentHandles::first_{nullptr};
+
+// The last released chunk is kept, a scope entered by a loop right at a
+// chunk boundary would otherwise allocate and free one per iteration.
+static void** spare_handle_chunk{nullptr};
 
 inline void** AllocateHandleChunk() {
+  if (auto chunk = spare_handle_chunk; chunk) {
+    spare_handle_chunk = nullptr;
+    return chunk;
+  }
   return static_cast<void**>(
       Allocator::AllocateArray(kPointerSize, kHandleSize));
 }
 
 inline void DeallocateHandleChunk(void** chunk) {
+  if (spare_handle_chunk == nullptr) {
+    spare_handle_chunk = chunk;
+    return;
+  }
   Allocator::DeallocateArray(chunk, kPointerSize, kHandleSize);
 }
 
 void** HandleScope::MakeHandle(void* value) {
+  if (persistent_) {
+    return persistent_->MakeHandle(value);
+  }
   void** handle = current_.handle;
   if (handle == current_.end) {
     handle = AllocateHandleChunk();
@@ -33,6 +50,7 @@ void** HandleScope::MakeHandle(void* value) {
 }
 
 void HandleScope::IterateHandles(ObjectVisitor* visitor) {
+  PersistentHandles::IterateHandles(visitor);
   if (current_.handle) {
     for (auto obj_it = handles_.Last(); obj_it != current_.handle; obj_it++) {
       visitor->Visit(reinterpret_cast<Object**>(obj_it));
@@ -50,8 +68,50 @@ void HandleScope::IterateHandles(ObjectVisitor* visitor) {
 
 void HandleScope::Exit() {
   for (auto i = 0; i < current_.chunks; i++) {
-    Allocator::DeallocateArray(handles_.ReleaseLast(), kPointerSize,
-                               kHandleSize);
+    DeallocateHandleChunk(handles_.ReleaseLast());
   }
   current_ = prev_;
-}
\ No newline at end of file
+}
+PersistentHandles::~PersistentHandles() {
+  if (chunks_.size() == 0) {
+    return;
+  }
+  for (auto i = 0; i < chunks_.size(); i++) {
+    Allocator::DeallocateArray(chunks_[i], kPointerSize, kHandleSize);
+  }
+  (prev_ ? prev_->next_ : first_) = next_;
+  if (next_) {
+    next_->prev_ = prev_;
+  }
+}
+
+void** PersistentHandles::MakeHandle(void* value) {
+  if (handle_ == end_) {
+    if (chunks_.size() == 0) {
+      next_ = first_;
+      if (first_) {
+        first_->prev_ = this;
+      }
+      first_ = this;
+    }
+    handle_ = static_cast<void**>(
+        Allocator::AllocateArray(kPointerSize, kHandleSize));
+    end_ = handle_ + kHandleSize;
+    chunks_.Add(handle_);
+  }
+  *handle_ = value;
+  return handle_++;
+}
+
+void PersistentHandles::IterateHandles(ObjectVisitor* visitor) {
+  for (auto handles = first_; handles; handles = handles->next_) {
+    for (auto chunk_i = 0, len = handles->chunks_.size(); chunk_i < len;
+         chunk_i++) {
+      auto chunk = handles->chunks_[chunk_i];
+      auto end = chunk_i == len - 1 ? handles->handle_ : chunk + kHandleSize;
+      for (auto obj_it = chunk; obj_it != end; obj_it++) {
+        visitor->Visit(reinterpret_cast<Object**>(obj_it));
+      }
+    }
+  }
+}
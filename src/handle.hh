@@ -17,6 +17,7 @@ namespace internal {
 #endif
 
 class ObjectVisitor;
+class PersistentHandles;
 
 struct HandleArea {
   void** handle;
@@ -44,6 +45,52 @@ class HandleScope {
   const HandleArea prev_;
   static HandleArea current_;
   static HandleList handles_;
+  static PersistentHandles* persistent_;
+
+  friend class PersistentHandleScope;
+};
+
+/// Handles that outlive every HandleScope, until the block itself is freed.
+/// The GC visits the handles of every live block.
+class PersistentHandles {
+ public:
+  PersistentHandles() : chunks_{0} {}
+
+  ~PersistentHandles();
+
+  PersistentHandles(const PersistentHandles&) = delete;
+  PersistentHandles& operator=(const PersistentHandles&) = delete;
+
+  void** MakeHandle(void* value);
+
+  static void IterateHandles(ObjectVisitor* visitor);
+
+ private:
+  List<void**> chunks_;
+  void** handle_{nullptr};
+  void** end_{nullptr};
+  // Blocks holding handles, linked once they allocate their first chunk.
+  PersistentHandles* prev_{nullptr};
+  PersistentHandles* next_{nullptr};
+  static PersistentHandles* first_;
+};
+
+/// Makes the handles created during its lifetime go to `handles`, so they
+/// outlive every HandleScope. A lazily compiled function body keeps its
+/// AST constants in the handles of its script.
+class PersistentHandleScope {
+ public:
+  explicit PersistentHandleScope(PersistentHandles* handles)
+      : prev_{HandleScope::persistent_} {
+    HandleScope::persistent_ = handles;
+  }
+
+  ~PersistentHandleScope() { HandleScope::persistent_ = prev_; }
+
+  DISABLE_DEFAULT_OP(PersistentHandleScope)
+
+ private:
+  PersistentHandles* const prev_;
 };
 
 template <class T>
@@ -3,8 +3,10 @@
 #include "context.hh"
 #include "gc.hh"
 #include "handle.hh"
+#include "snapshot.hh"
 #include "space.hh"
 #include "value.hh"
+#include "vm.hh"
 
 using namespace kipper::internal;
 
@@ -33,8 +35,8 @@ OldSpace Heap::old_space_{nullptr, 0};
 Context *Heap::global_context_ = nullptr;
 SymbolTable Heap::symbol_table_;
 
-size_t Heap::young_space_size_ = 0;
 size_t Heap::semispace_size_ = 256 * KB;
+size_t Heap::young_space_size_ = Heap::semispace_size_ << 1U;
 size_t Heap::old_space_size_ = 16 * MB;
 uint8_t Heap::tenure_threshold_ = 2;
 bool Heap::initialized_ = false;
@@ -69,7 +71,9 @@ void Heap::Configure(size_t heap_size, uint8_t tenure_threshold) {
     old_space_size_ = NextPowerOf2(old_size);
   }
   young_space_size_ = semispace_size_ << 1U;
-  tenure_threshold_ = tenure_threshold;
+  if (tenure_threshold > 0) {
+    tenure_threshold_ = tenure_threshold;
+  }
 }
 
 void Heap::Initialize() {
@@ -82,7 +86,9 @@ void Heap::Initialize() {
   old_space_ = OldSpace{new_space_.end(), old_space_size_};
 
   global_context_ = new Context{nullptr};
-  InitializeRootList();
+  if (!Snapshot::Deserialize()) {
+    InitializeRootList();
+  }
 
   initialized_ = true;
 }
@@ -117,8 +123,21 @@ HeapObject *Heap::AllocateArrayNoGC(int32_t length, AllocationPolicy policy) {
   return length ? AllocateArrayNoGCInternal(length, policy) : empty_array();
 }
 
-HeapObject *Heap::AllocateKSArray(int32_t length, AllocationPolicy policy) {
-  ALLOC_WITH_GC_SUPPORT(AllocateKSArrayNoGC(length, policy));
+HeapObject *Heap::AllocateInt32ArrayNoGC(int32_t length,
+                                         AllocationPolicy policy) {
+  return length ? AllocateInt32ArrayNoGCInternal(length, policy)
+                : empty_int32_array();
+}
+
+HeapObject *Heap::AllocateDoubleArrayNoGC(int32_t length,
+                                          AllocationPolicy policy) {
+  return length ? AllocateDoubleArrayNoGCInternal(length, policy)
+                : empty_double_array();
+}
+
+HeapObject *Heap::AllocateKSArray(int32_t length, ElementsKind kind,
+                                  AllocationPolicy policy) {
+  ALLOC_WITH_GC_SUPPORT(AllocateKSArrayNoGC(length, kind, policy));
 }
 
 HeapObject *Heap::AllocateHeapNumber(AllocationPolicy policy) {
@@ -162,6 +181,7 @@ bool Heap::IsInOldSpace(HeapObject *obj) {
 void Heap::IterateRoots(ObjectVisitor *visitor) {
   Context::IterateContext(visitor);
   HandleScope::IterateHandles(visitor);
+  VM::IterateStack(visitor);
 
 #define ROOT_ITERATE(T, name) \
   visitor->Visit(reinterpret_cast<Object **>(&name##_));
@@ -263,8 +283,12 @@ void Heap::Collect(AllocationSpace space) {
 
 void Heap::InitializeRootList() {
   empty_array_ = AllocateArrayNoGCInternal(0, TENURED);
+  empty_int32_array_ = AllocateInt32ArrayNoGCInternal(0, TENURED);
+  empty_double_array_ = AllocateDoubleArrayNoGCInternal(0, TENURED);
   empty_hash_table_ = AllocateHashTableNoGCInternal(0, TENURED);
   empty_string_ = AllocateStringNoGCInternal(0, TENURED);
+  arguments_symbol_ = LookupSymbol("arguments_");
+  assert_symbol_ = LookupSymbol("Assert");
 
 #define ROOT_LIST_VERIFY(T, name) assert(name##_ != nullptr);
   ROOT_LIST(ROOT_LIST_VERIFY)
@@ -281,8 +305,9 @@ inline HeapObject *Heap::AllocateKSObjectNoGC(int32_t elements_size,
 }
 
 inline HeapObject *Heap::AllocateKSArrayNoGC(int32_t length,
+                                             ElementsKind kind,
                                              AllocationPolicy policy) {
-  return AllocateKSArrayNoGCInternal(length, policy);
+  return AllocateKSArrayNoGCInternal(length, kind, policy);
 }
 
 HeapObject *Heap::AllocateHeapNumberNoGC(AllocationPolicy policy) {
@@ -315,15 +340,13 @@ HeapObject *Heap::AllocateArrayNoGCInternal(int32_t length,
 
 HeapObject *Heap::AllocateHashTableNoGCInternal(int32_t elements_size,
                                                 AllocationPolicy policy) {
-  int capacity = NextPowerOf2(elements_size);
-  if (capacity < 2) {
-    capacity = 2;
-  }
-  auto table = HashTable::Cast(
-      Heap::AllocateArrayNoGC(HashTable::EnsureSize(capacity), policy));
-  table->SetElementsSize(0);
-  table->SetCapacity(capacity);
-  return table;
+  auto capacity = HashTable::CapacityFor(elements_size);
+  auto space = policy == NOT_TENURED ? NEW_SPACE : OLD_SPACE;
+  auto result = AllocateRaw(HashTable::EnsureSize(capacity), space);
+  InitializeMetadata(result, HeapObjectType::HASH_TABLE);
+  HashTable::Cast(result)->SetCapacity(capacity);
+  HashTable::Cast(result)->Clear();
+  return result;
 }
 
 HeapObject *Heap::AllocateStringNoGCInternal(int32_t length,
@@ -347,13 +370,53 @@ HeapObject *Heap::AllocateKSObjectNoGCInternal(int32_t elements_size,
   return result;
 }
 
+HeapObject *Heap::AllocateInt32ArrayNoGCInternal(int32_t length,
+                                                 AllocationPolicy policy) {
+  auto size = Int32Array::EnsureSize(length);
+  auto space = policy == NOT_TENURED ? NEW_SPACE : OLD_SPACE;
+  auto result = AllocateRaw(size, space);
+  InitializeMetadata(result, HeapObjectType::INT32_ARRAY);
+  auto array_result = Int32Array::Cast(result);
+  array_result->SetLength(length);
+  for (int i = 0; i < length; i++) {
+    array_result->Set(i, 0);
+  }
+  return result;
+}
+
+HeapObject *Heap::AllocateDoubleArrayNoGCInternal(int32_t length,
+                                                  AllocationPolicy policy) {
+  auto size = DoubleArray::EnsureSize(length);
+  auto space = policy == NOT_TENURED ? NEW_SPACE : OLD_SPACE;
+  auto result = AllocateRaw(size, space);
+  InitializeMetadata(result, HeapObjectType::DOUBLE_ARRAY);
+  auto array_result = DoubleArray::Cast(result);
+  array_result->SetLength(length);
+  for (int i = 0; i < length; i++) {
+    array_result->Set(i, 0);
+  }
+  return result;
+}
+
 HeapObject *Heap::AllocateKSArrayNoGCInternal(int32_t length,
+                                              ElementsKind kind,
                                               AllocationPolicy policy) {
-  auto elements = Array::Cast(AllocateArrayNoGC(length, policy));
+  HeapObject *elements = nullptr;
+  switch (kind) {
+    case PACKED_INT32_ELEMENTS:
+      elements = AllocateInt32ArrayNoGC(length, policy);
+      break;
+    case PACKED_DOUBLE_ELEMENTS:
+      elements = AllocateDoubleArrayNoGC(length, policy);
+      break;
+    case GENERIC_ELEMENTS:
+      elements = AllocateArrayNoGC(length, policy);
+      break;
+  }
   auto space = policy == NOT_TENURED ? NEW_SPACE : OLD_SPACE;
   auto result = AllocateRaw(KSArray::kSize, space);
   InitializeMetadata(result, HeapObjectType::KSARRAY);
-  KSArray::Cast(result)->SetElements(elements);
+  KSArray::Cast(result)->SetElements(elements, kind);
   KSArray::Cast(result)->SetLength(length);
   KSObject::Cast(result)->SetElements(HashTable::Cast(empty_hash_table()));
   return result;
@@ -7,10 +7,14 @@
 
 namespace kipper::internal {
 
-#define ROOT_LIST(K)              \
-  K(HeapObject, empty_array)      \
-  K(HeapObject, empty_hash_table) \
-  K(HeapObject, empty_string)
+#define ROOT_LIST(K)                \
+  K(HeapObject, empty_array)        \
+  K(HeapObject, empty_int32_array)  \
+  K(HeapObject, empty_double_array) \
+  K(HeapObject, empty_hash_table)   \
+  K(HeapObject, empty_string)       \
+  K(HeapObject, arguments_symbol)   \
+  K(HeapObject, assert_symbol)
 
 class Context;
 class NewSpace;
@@ -30,6 +34,11 @@ class Heap : public AllStatic {
 
   static Context* GlobalContext();
 
+#define ROOT_LIST_GETTER(T, name) \
+  static T* name() { return name##_; }
+  ROOT_LIST(ROOT_LIST_GETTER)
+#undef ROOT_LIST_GETTER
+
   static HeapObject* AllocateKSObject(int elements_size,
                                       AllocationPolicy policy = NOT_TENURED);
 
@@ -42,7 +51,13 @@ class Heap : public AllStatic {
   static HeapObject* AllocateArrayNoGC(int32_t length,
                                        AllocationPolicy policy = NOT_TENURED);
 
-  static HeapObject* AllocateKSArray(int32_t length,
+  static HeapObject* AllocateInt32ArrayNoGC(
+      int32_t length, AllocationPolicy policy = NOT_TENURED);
+
+  static HeapObject* AllocateDoubleArrayNoGC(
+      int32_t length, AllocationPolicy policy = NOT_TENURED);
+
+  static HeapObject* AllocateKSArray(int32_t length, ElementsKind kind,
                                      AllocationPolicy policy = NOT_TENURED);
 
   static HeapObject* AllocateHeapNumber(AllocationPolicy policy = NOT_TENURED);
@@ -94,7 +109,7 @@ class Heap : public AllStatic {
   static HeapObject* AllocateKSObjectNoGC(int32_t elements_size,
                                           AllocationPolicy policy);
 
-  static HeapObject* AllocateKSArrayNoGC(int32_t length,
+  static HeapObject* AllocateKSArrayNoGC(int32_t length, ElementsKind kind,
                                          AllocationPolicy policy);
 
   static HeapObject* AllocateHeapNumberNoGC(AllocationPolicy policy);
@@ -113,7 +128,14 @@ class Heap : public AllStatic {
   static HeapObject* AllocateKSObjectNoGCInternal(int32_t elements_size,
                                                   AllocationPolicy policy);
 
+  static HeapObject* AllocateInt32ArrayNoGCInternal(int32_t length,
+                                                    AllocationPolicy policy);
+
+  static HeapObject* AllocateDoubleArrayNoGCInternal(int32_t length,
+                                                     AllocationPolicy policy);
+
   static HeapObject* AllocateKSArrayNoGCInternal(int32_t length,
+                                                 ElementsKind kind,
                                                  AllocationPolicy policy);
 
   static HeapObject* AllocateSymbol(std::string_view symbol);
@@ -133,16 +155,13 @@ class Heap : public AllStatic {
   ROOT_LIST(ROOT_LIST_DECL)
 #undef ROOT_LIST_DECL
 
-#define ROOT_LIST_GETTER(T, name) \
-  static T* name() { return name##_; }
-  ROOT_LIST(ROOT_LIST_GETTER)
-#undef ROOT_LIST_GETTER
-
   static size_t semispace_size_;
   static size_t young_space_size_;
   static size_t old_space_size_;
   static uint8_t tenure_threshold_;
   static bool initialized_;
+
+  friend class Snapshot;
 };
 
 class AllocationError : public KError {
@@ -0,0 +1,64 @@
+#include "inline_cache.hh"
+#include "value.hh"
+
+using namespace kipper::internal;
+
+inline static bool IsSameKey(Object* entry_key, String* key) {
+  return entry_key == key ||
+         (entry_key->IsString() && String::Cast(entry_key)->Value() ==
+                                       key->Value());
+}
+
+Object* PropertyCache::Load(KSObject* receiver, String* key) {
+  if (auto index = Find(receiver, key); index != -1) {
+    return receiver->Elements()->ValueAt(entries_[index].entry);
+  }
+  return nullptr;
+}
+
+bool PropertyCache::Store(KSObject* receiver, String* key, Object* value) {
+  if (auto index = Find(receiver, key); index != -1) {
+    receiver->Elements()->SetValueAt(entries_[index].entry, value);
+    return true;
+  }
+  return false;
+}
+
+void PropertyCache::Update(KSObject* receiver, String* key, Object* value) {
+  if (state_ == MEGAMORPHIC) {
+    return;
+  }
+  auto table = receiver->Elements();
+  auto entry = table->Lookup(key);
+  if (entry == -1 || table->ValueAt(entry) != value) {
+    return;
+  }
+  if (size_ == kMaxEntries) {
+    state_ = MEGAMORPHIC;
+    return;
+  }
+  entries_[size_++] = Entry{table->Capacity(), entry};
+  state_ = size_ == 1 ? MONOMORPHIC : POLYMORPHIC;
+}
+
+bool PropertyCache::IsCacheable(Object* receiver, Object* key) {
+  return receiver->IsHeapObject() &&
+         HeapObject::Cast(receiver)->metadata().Type() ==
+             HeapObjectType::KSOBJECT &&
+         key->IsString();
+}
+
+int PropertyCache::Find(KSObject* receiver, String* key) {
+  if (size_ == 0 || state_ == MEGAMORPHIC) {
+    return -1;
+  }
+  auto table = receiver->Elements();
+  auto capacity = table->Capacity();
+  for (int i = 0; i < size_; i++) {
+    if (entries_[i].capacity == capacity &&
+        IsSameKey(table->KeyAt(entries_[i].entry), key)) {
+      return i;
+    }
+  }
+  return -1;
+}
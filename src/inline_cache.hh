@@ -0,0 +1,54 @@
+#pragma once
+
+#include "kipper.hh"
+
+namespace kipper {
+namespace internal {
+
+class KSObject;
+class Object;
+class String;
+
+/// Per-site cache of where a property key was found in its receiver.
+///
+/// Objects have no hidden classes, so the receiver's layout is described by
+/// the capacity of its element table together with the entry holding the key.
+/// Objects built the same way (e.g. by one object literal) share the layout.
+/// Every hit re-checks the key stored at the cached entry, so entries that
+/// went stale after a GC or a table resize simply miss.
+class PropertyCache {
+ public:
+  enum State { UNINITIALIZED, MONOMORPHIC, POLYMORPHIC, MEGAMORPHIC };
+
+  /// Returns the property value, or nullptr if the cache misses.
+  Object* Load(KSObject* receiver, String* key);
+
+  /// Stores into an existing property, returns false if the cache misses.
+  bool Store(KSObject* receiver, String* key, Object* value);
+
+  /// Records the entry of `key` in `receiver` after a generic access. Nothing
+  /// is recorded unless the entry holds `value`, i.e. when a property
+  /// interceptor answered instead of the element table.
+  void Update(KSObject* receiver, String* key, Object* value);
+
+  State state() const { return state_; }
+
+  static bool IsCacheable(Object* receiver, Object* key);
+
+  static constexpr int kMaxEntries = 4;
+
+ private:
+  struct Entry {
+    int capacity;
+    int entry;
+  };
+
+  int Find(KSObject* receiver, String* key);
+
+  Entry entries_[kMaxEntries];
+  int size_{0};
+  State state_{UNINITIALIZED};
+};
+
+}  // namespace internal
+}  // namespace kipper
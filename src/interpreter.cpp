@@ -1,14 +1,33 @@
 #include "interpreter.hh"
 #include <memory>
 #include "ast.hh"
+#include "bytecode_generator.hh"
 #include "compiler.hh"
 #include "context.hh"
 #include "kipper.hh"
 #include "message.hh"
+#include "profiler.hh"
 #include "value.hh"
+#include "vm.hh"
 
 using namespace kipper::internal;
 
+bool Interpreter::bytecode_enabled_{true};
+
+// Node counters only see the AST walker, so counting disables bytecode.
+static bool UsesBytecode(bool enabled) {
+  return enabled && !NodeCounters::enabled();
+}
+
+template <class T>
+static Bytecode* GetBytecode(T* node) {
+  if (!node->bytecode_generated) {
+    node->bytecode = BytecodeGenerator::Generate(node);
+    node->bytecode_generated = true;
+  }
+  return node->bytecode.get();
+}
+
 Handle<Object> Interpreter::Evaluate(std::string_view code,
                                      std::string_view filename,
                                      Context* context) {
@@ -27,36 +46,94 @@ Handle<Object> Interpreter::Evaluate(Node* ast, Context* context) {
   }
   Execution exec{this, context};
   ExecutionHandler exec_handler{exec};
+  Profiler::Scope profiler_scope{ast};
+  if (auto unit = ast->AsTranslationUnit();
+      unit && UsesBytecode(bytecode_enabled_)) {
+    if (auto bytecode = GetBytecode(unit)) {
+      VM::Execute(bytecode, exec);
+      return Constant::UndefinedHandle();
+    }
+  }
   return ast->Evaluate(exec);
 }
 
 Handle<Object> Interpreter::Call(Handle<Object> self, Handle<Object> obj,
                                  Handle<KSArray> args, Context* context) {
+  if (obj && obj->IsFunction() && Function::Cast(*obj)->IsFunctionTemplate()) {
+    return CallNative(self, obj, args, context);
+  }
+  auto argc = args->Length();
+  VM::Window argv{argc};
+  for (int32_t i = 0; i < argc; i++) {
+    argv[i] = args->Get(i);
+  }
+  return Call(self, obj, argv.slots(), argc, context);
+}
+
+Handle<Object> Interpreter::Call(Handle<Object> self, Handle<Object> obj,
+                                 Object** argv, int32_t argc,
+                                 Context* context) {
+  if (!obj || !obj->IsFunction()) {
+    throw KSNotFunctionError{SourceRange{}, "object is not a function"};
+  }
+  if (Function::Cast(*obj)->IsFunctionTemplate()) {
+    auto args = Handle{KSArray::New(argc)};
+    for (int32_t i = 0; i < argc; i++) {
+      KSArray::Set(args, i, Handle{argv + i});
+    }
+    return CallNative(self, obj, args, context);
+  }
   Execution exec{this, context};
-  if (obj && obj->IsFunction()) {
-    auto fn_decl = Function::Cast(*obj);
-    auto params = fn_decl->Params();
-    {
-      Handle<Object> return_val{static_cast<Object*>(nullptr)};
-      ExecutionHandler exec_handler{exec};
-      exec.context()->set_self(self);
-      for (int i = 0, params_lenth = params->Length(); i < params_lenth; i++) {
-        exec.context()->Push(String::Cast(params->Get(i)), args->Get(i));
-      }
-
-      exec.context()->Push(String::NewSymbol("arguments_"), args.Get());
-      if (fn_decl->IsFunctionTemplate()) {
-        return fn_decl->Body()(args, exec.context());
-      }
-      for (auto& stmt : *static_cast<FunctionDecl::Body*>(fn_decl->KSBody())) {
-        auto completion = stmt->Execute(exec);
-        if (completion.type == Completion::RETURN) {
-          *return_val.location() = completion.value.Get();
-          return return_val;
-        }
-      }
-      return Constant::UndefinedHandle();
+  Handle<Object> return_val{static_cast<Object*>(nullptr)};
+  ExecutionHandler exec_handler{exec};
+  exec.context()->set_self(self);
+  auto params = Function::Cast(*obj)->Params();
+  for (int32_t i = 0, params_length = params->Length(); i < params_length;
+       i++) {
+    exec.context()->Push(String::Cast(params->Get(i)),
+                         i < argc ? argv[i] : Constant::Undefined());
+  }
+  auto body = static_cast<FunctionDecl*>(Function::Cast(*obj)->KSBody());
+  if (body->lazy) {
+    Compiler::CompileFunction(body);
+  }
+  Profiler::Scope profiler_scope{body};
+  if (body->uses_arguments) {
+    auto arguments = Handle{KSArray::New(argc)};
+    for (int32_t i = 0; i < argc; i++) {
+      KSArray::Set(arguments, i, Handle{argv + i});
+    }
+    exec.context()->Push(String::Cast(Heap::arguments_symbol()),
+                         arguments.Get());
+  }
+  if (UsesBytecode(bytecode_enabled_)) {
+    if (auto bytecode = GetBytecode(body)) {
+      *return_val.location() = VM::Execute(bytecode, exec);
+      return return_val;
     }
   }
-  throw KSNotFunctionError{Location{}, "object is not a function"};
+  for (auto& stmt : body->body) {
+    auto completion = stmt->Execute(exec);
+    if (completion.type == Completion::RETURN) {
+      *return_val.location() = completion.value.Get();
+      return return_val;
+    }
+  }
+  return Constant::UndefinedHandle();
+}
+
+Handle<Object> Interpreter::CallNative(Handle<Object> self,
+                                       Handle<Object> fn, Handle<KSArray> args,
+                                       Context* context) {
+  Execution exec{this, context};
+  ExecutionHandler exec_handler{exec};
+  exec.context()->set_self(self);
+  auto params = Handle{Function::Cast(*fn)->Params()};
+  for (int32_t i = 0, params_length = params->Length(); i < params_length;
+       i++) {
+    auto arg = args->Get(i);
+    exec.context()->Push(String::Cast(params->Get(i)), arg);
+  }
+  exec.context()->Push(String::Cast(Heap::arguments_symbol()), args.Get());
+  return Function::Cast(*fn)->Body()(args, exec.context());
 }
@@ -13,7 +13,6 @@ namespace internal {
 class Interpreter;
 class Object;
 class String;
-class Location;
 struct Node;
 
 class Execution {
@@ -28,6 +27,7 @@ class Execution {
  private:
   friend class ExecutionHandler;
   friend class Interpreter;
+  friend class VM;
 
   Interpreter* interpreter_;
   Context* context_;
@@ -46,7 +46,28 @@ class Interpreter {
   Handle<Object> Call(Handle<Object> self, Handle<Object> obj,
                       Handle<KSArray> args, Context* context);
 
+  /// Calls `obj` with the `argc` arguments at `argv`, which must be GC roots
+  /// such as VM registers or a VM::Window. Only native functions and bodies
+  /// referencing `arguments_` get an arguments array.
+  Handle<Object> Call(Handle<Object> self, Handle<Object> obj, Object** argv,
+                      int32_t argc, Context* context);
+
+  /// Whether `obj` is the native Assert(), call sites append the location of
+  /// its condition as an extra argument.
+  static bool IsAssert(Object* obj) {
+    return obj->IsFunction() && Function::Cast(obj)->IsFunctionTemplate() &&
+           Function::Cast(obj)->Name() == Heap::assert_symbol();
+  }
+
+  /// Runs scripts and functions as bytecode when enabled (the default),
+  /// otherwise walks the AST.
+  static void EnableBytecode(bool enabled) { bytecode_enabled_ = enabled; }
+
   static Handle<Object> Add(Handle<Object> left, Handle<Object> right) {
+    Object* result;
+    if (Int32::Both(*left, *right) && Int32::Add(*left, *right, &result)) {
+      return Handle{result};
+    }
     if (left->IsString() || right->IsString()) {
       return Handle{left->ToString()->Concat(right->ToString())};
     }
@@ -54,10 +75,18 @@ class Interpreter {
   }
 
   static Handle<Object> Sub(Handle<Object> left, Handle<Object> right) {
+    Object* result;
+    if (Int32::Both(*left, *right) && Int32::Sub(*left, *right, &result)) {
+      return Handle{result};
+    }
     return Handle{Double::MakeFit(left->ToDouble() - right->ToDouble())};
   }
 
   static Handle<Object> Mult(Handle<Object> left, Handle<Object> right) {
+    Object* result;
+    if (Int32::Both(*left, *right) && Int32::Mul(*left, *right, &result)) {
+      return Handle{result};
+    }
     return Handle{Double::MakeFit(left->ToDouble() * right->ToDouble())};
   }
 
@@ -66,8 +95,30 @@ class Interpreter {
   }
 
   static Handle<Object> Mod(Handle<Object> left, Handle<Object> right) {
+    Object* result;
+    if (Int32::Both(*left, *right) && Int32::Mod(*left, *right, &result)) {
+      return Handle{result};
+    }
     return Handle{Double::MakeFit(fmod(left->ToDouble(), right->ToDouble()))};
   }
+
+  /// `value + delta` for ++ and --, a HeapNumber stays a HeapNumber.
+  static Object* Increment(Object* value, int32_t delta) {
+    Object* result;
+    if (Int32::Is(value) && Int32::Add(value, Int32::Make(delta), &result)) {
+      return result;
+    }
+    if (value->IsHeapNumber()) {
+      return HeapNumber::New(HeapNumber::Cast(value)->Value() + delta);
+    }
+    return Double::Make(value->ToDouble() + delta);
+  }
+
+ private:
+  Handle<Object> CallNative(Handle<Object> self, Handle<Object> fn,
+                            Handle<KSArray> args, Context* context);
+
+  static bool bytecode_enabled_;
 };
 
 class ExecutionHandler {
@@ -88,15 +139,16 @@ class ExecutionHandler {
 
 class KSReferenceError : public KSError {
  public:
-  KSReferenceError(const Location& loc, const char* msg) : KSError{loc, msg} {}
+  KSReferenceError(const SourceRange& loc, const char* msg)
+      : KSError{loc, msg} {}
 };
 
 class KSNotFunctionError : public KSError {
  public:
-  KSNotFunctionError(const Location& loc, const std::string& msg)
+  KSNotFunctionError(const SourceRange& loc, const std::string& msg)
       : KSError{loc, msg} {}
 
-  KSNotFunctionError(const Location& loc, const char* msg)
+  KSNotFunctionError(const SourceRange& loc, const char* msg)
       : KSError{loc, msg} {}
 };
 
@@ -0,0 +1,908 @@
+#include "jit.hh"
+#include <sys/mman.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <map>
+#include "assembler_x64.hh"
+#include "context.hh"
+#include "value.hh"
+
+using namespace kipper::internal;
+
+namespace {
+
+// Registers holding the arguments of the compiled code, all callee-saved.
+constexpr Register kRegisters = Register::rbx;
+constexpr Register kFrame = Register::r12;
+constexpr Register kInt32TagRegister = Register::r13;
+constexpr Register kLocals = Register::r14;
+
+int32_t IsToBooleanTrue(Object* value) {
+  return value->ToBoolean()->IsTrue();
+}
+
+uint64_t Bits(Object* value) { return reinterpret_cast<uint64_t>(value); }
+
+uint64_t Bits(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+ValueType TypeOf(Object* value) {
+  if (Int32::Is(value)) {
+    return ValueType::kInt32;
+  }
+  return value->IsDouble() ? ValueType::kDouble : ValueType::kUnknown;
+}
+
+bool IsNumber(ValueType type) { return type != ValueType::kUnknown; }
+
+/// The frame of the generated code and the calls into the VM, shared by the
+/// compilers. Only rax, rcx, rdx, rsi, rdi, xmm0 and xmm1 are used as
+/// scratch registers.
+class CodeGenerator {
+ protected:
+  /// Saves the registers above and loads the arguments into them.
+  void EmitPrologue();
+
+  /// Binds exit_, restores the registers and returns.
+  void EmitEpilogue();
+
+  /// Calls the VM::Stub of the bytecode at `pc`.
+  void EmitStub(const int32_t* pc);
+
+  /// Jumps to `not_int32` unless `reg` holds an Int32. Clobbers rcx.
+  void EmitInt32Check(Register reg, Label* not_int32);
+
+  void LoadRegister(Register dst, int32_t index) {
+    masm_.Load(dst, kRegisters, index * kPointerSize);
+  }
+
+  void StoreRegister(int32_t index, Register src) {
+    masm_.Store(kRegisters, index * kPointerSize, src);
+  }
+
+  Assembler masm_;
+  Label exception_;
+  Label exit_;
+};
+
+void CodeGenerator::EmitPrologue() {
+  // Five pushes leave the stack 16-byte aligned for calls.
+  masm_.Push(Register::rbp);
+  masm_.Mov(Register::rbp, Register::rsp);
+  masm_.Push(kRegisters);
+  masm_.Push(kFrame);
+  masm_.Push(kInt32TagRegister);
+  masm_.Push(kLocals);
+  masm_.Mov(kRegisters, Register::rdi);
+  masm_.Mov(kFrame, Register::rsi);
+  masm_.Mov(kLocals, Register::rdx);
+  masm_.Mov(kInt32TagRegister, Int32::kInt32Tag);
+}
+
+void CodeGenerator::EmitEpilogue() {
+  masm_.Bind(&exit_);
+  masm_.Pop(kLocals);
+  masm_.Pop(kInt32TagRegister);
+  masm_.Pop(kFrame);
+  masm_.Pop(kRegisters);
+  masm_.Pop(Register::rbp);
+  masm_.Ret();
+}
+
+void CodeGenerator::EmitStub(const int32_t* pc) {
+  auto stub = VM::StubFor(static_cast<Opcode>(*pc));
+  masm_.Mov(Register::rdi, kFrame);
+  masm_.Mov(Register::rsi, reinterpret_cast<uint64_t>(pc));
+  masm_.Mov(Register::rax, reinterpret_cast<uint64_t>(stub));
+  masm_.Call(Register::rax);
+  masm_.Test8(Register::rax, Register::rax);
+  masm_.Jump(Condition::kEqual, &exception_);
+}
+
+void CodeGenerator::EmitInt32Check(Register reg, Label* not_int32) {
+  masm_.Mov(Register::rcx, reg);
+  masm_.Shr(Register::rcx, kCanonicalBits);
+  masm_.Cmp32(Register::rcx,
+              static_cast<int32_t>(Int32::kInt32Tag >> kCanonicalBits));
+  masm_.Jump(Condition::kNotEqual, not_int32);
+}
+
+/// Emits one template per bytecode, no value is kept in a machine register
+/// across instructions.
+class BaselineCompiler : public CodeGenerator {
+ public:
+  explicit BaselineCompiler(Bytecode* bytecode)
+      : bytecode_{bytecode},
+        labels_(bytecode->code.size()),
+        entry_offsets_(bytecode->code.size(), -1) {}
+
+  unique_ptr<MachineCode> Compile();
+
+ private:
+  using Arithmetic = void (Assembler::*)(Register, Register);
+
+  void EmitBytecode(const int32_t* pc);
+
+  void EmitInt32Arithmetic(const int32_t* pc, Arithmetic op);
+
+  void EmitInt32Comparison(const int32_t* pc, Condition condition);
+
+  void EmitInt32Increment(const int32_t* pc, int8_t delta);
+
+  void EmitJumpIfToBooleanFalse(const int32_t* pc);
+
+  Bytecode* bytecode_;
+  std::vector<Label> labels_;
+  std::vector<int32_t> entry_offsets_;
+};
+
+unique_ptr<MachineCode> BaselineCompiler::Compile() {
+  EmitPrologue();
+  Label start;
+  masm_.Test(Register::rcx, Register::rcx);
+  masm_.Jump(Condition::kEqual, &start);
+  masm_.Jump(Register::rcx);
+  masm_.Bind(&start);
+
+  auto& code = bytecode_->code;
+  for (size_t offset = 0; offset < code.size();) {
+    masm_.Bind(&labels_[offset]);
+    entry_offsets_[offset] = masm_.pc_offset();
+    EmitBytecode(code.data() + offset);
+    offset += Bytecode::OperandCount(static_cast<Opcode>(code[offset])) + 1;
+  }
+
+  masm_.Bind(&exception_);
+  masm_.Xor32(Register::rax, Register::rax);
+  EmitEpilogue();
+  return MachineCode::New(masm_.code(), std::move(entry_offsets_));
+}
+
+void BaselineCompiler::EmitBytecode(const int32_t* pc) {
+  switch (static_cast<Opcode>(*pc)) {
+    case Opcode::LoadConstant:
+      masm_.Mov(Register::rax, reinterpret_cast<uint64_t>(
+                                   bytecode_->constants[pc[2]].location()));
+      masm_.Load(Register::rax, Register::rax, 0);
+      StoreRegister(pc[1], Register::rax);
+      break;
+    case Opcode::Move:
+      LoadRegister(Register::rax, pc[2]);
+      StoreRegister(pc[1], Register::rax);
+      break;
+    case Opcode::LoadLocal:
+      if (pc[2] >= Context::kInlineVariables) {
+        EmitStub(pc);
+        break;
+      }
+      masm_.Load(Register::rax, kLocals, pc[2] * 2 * kPointerSize);
+      StoreRegister(pc[1], Register::rax);
+      break;
+    case Opcode::StoreLocal:
+      if (pc[1] >= Context::kInlineVariables) {
+        EmitStub(pc);
+        break;
+      }
+      LoadRegister(Register::rax, pc[2]);
+      masm_.Store(kLocals, pc[1] * 2 * kPointerSize, Register::rax);
+      break;
+    case Opcode::Add:
+      EmitInt32Arithmetic(pc, &Assembler::Add32);
+      break;
+    case Opcode::Sub:
+      EmitInt32Arithmetic(pc, &Assembler::Sub32);
+      break;
+    case Opcode::Mul:
+      EmitInt32Arithmetic(pc, &Assembler::Imul32);
+      break;
+    case Opcode::Equal:
+      EmitInt32Comparison(pc, Condition::kEqual);
+      break;
+    case Opcode::NotEqual:
+      EmitInt32Comparison(pc, Condition::kNotEqual);
+      break;
+    case Opcode::LessThan:
+      EmitInt32Comparison(pc, Condition::kLess);
+      break;
+    case Opcode::GreaterThan:
+      EmitInt32Comparison(pc, Condition::kGreater);
+      break;
+    case Opcode::LessThanOrEqual:
+      EmitInt32Comparison(pc, Condition::kLessEqual);
+      break;
+    case Opcode::GreaterThanOrEqual:
+      EmitInt32Comparison(pc, Condition::kGreaterEqual);
+      break;
+    case Opcode::Increment:
+      EmitInt32Increment(pc, 1);
+      break;
+    case Opcode::Decrement:
+      EmitInt32Increment(pc, -1);
+      break;
+    case Opcode::Jump:
+      masm_.Jump(&labels_[pc[1]]);
+      break;
+    case Opcode::JumpIfNotTrue:
+      LoadRegister(Register::rax, pc[1]);
+      masm_.Mov(Register::rcx, Bits(Constant::Boolean(true)));
+      masm_.Cmp(Register::rax, Register::rcx);
+      masm_.Jump(Condition::kNotEqual, &labels_[pc[2]]);
+      break;
+    case Opcode::JumpIfToBooleanFalse:
+      EmitJumpIfToBooleanFalse(pc);
+      break;
+    case Opcode::Return:
+      LoadRegister(Register::rax, pc[1]);
+      masm_.Jump(&exit_);
+      break;
+    default:
+      EmitStub(pc);
+      break;
+  }
+}
+
+void BaselineCompiler::EmitInt32Arithmetic(const int32_t* pc, Arithmetic op) {
+  Label slow, done;
+  LoadRegister(Register::rax, pc[2]);
+  LoadRegister(Register::rdx, pc[3]);
+  EmitInt32Check(Register::rax, &slow);
+  EmitInt32Check(Register::rdx, &slow);
+  (masm_.*op)(Register::rax, Register::rdx);
+  masm_.Jump(Condition::kOverflow, &slow);
+  masm_.Or(Register::rax, kInt32TagRegister);
+  StoreRegister(pc[1], Register::rax);
+  masm_.Jump(&done);
+  masm_.Bind(&slow);
+  EmitStub(pc);
+  masm_.Bind(&done);
+}
+
+void BaselineCompiler::EmitInt32Comparison(const int32_t* pc,
+                                           Condition condition) {
+  Label slow, done;
+  LoadRegister(Register::rax, pc[2]);
+  LoadRegister(Register::rdx, pc[3]);
+  EmitInt32Check(Register::rax, &slow);
+  EmitInt32Check(Register::rdx, &slow);
+  masm_.Cmp32(Register::rax, Register::rdx);
+  masm_.Mov(Register::rax, Bits(Constant::Boolean(false)));
+  masm_.Mov(Register::rcx, Bits(Constant::Boolean(true)));
+  masm_.Cmov(condition, Register::rax, Register::rcx);
+  StoreRegister(pc[1], Register::rax);
+  masm_.Jump(&done);
+  masm_.Bind(&slow);
+  EmitStub(pc);
+  masm_.Bind(&done);
+}
+
+void BaselineCompiler::EmitInt32Increment(const int32_t* pc, int8_t delta) {
+  Label slow, done;
+  LoadRegister(Register::rax, pc[2]);
+  EmitInt32Check(Register::rax, &slow);
+  masm_.Add32(Register::rax, delta);
+  masm_.Jump(Condition::kOverflow, &slow);
+  masm_.Or(Register::rax, kInt32TagRegister);
+  StoreRegister(pc[1], Register::rax);
+  masm_.Jump(&done);
+  masm_.Bind(&slow);
+  EmitStub(pc);
+  masm_.Bind(&done);
+}
+
+void BaselineCompiler::EmitJumpIfToBooleanFalse(const int32_t* pc) {
+  Label done;
+  auto target = &labels_[pc[2]];
+  LoadRegister(Register::rdi, pc[1]);
+  masm_.Mov(Register::rcx, Bits(Constant::Boolean(true)));
+  masm_.Cmp(Register::rdi, Register::rcx);
+  masm_.Jump(Condition::kEqual, &done);
+  masm_.Mov(Register::rcx, Bits(Constant::Boolean(false)));
+  masm_.Cmp(Register::rdi, Register::rcx);
+  masm_.Jump(Condition::kEqual, target);
+  masm_.Mov(Register::rax, reinterpret_cast<uint64_t>(&IsToBooleanTrue));
+  masm_.Call(Register::rax);
+  masm_.Test32(Register::rax, Register::rax);
+  masm_.Jump(Condition::kEqual, target);
+  masm_.Bind(&done);
+}
+
+/// Compiles a recorded loop iteration, see Tracer.
+///
+/// VM registers and the inline local slots are both called variables here,
+/// numbered registers first. The compiler follows what is known about the
+/// type of each of them through the trace, a guard is only emitted where the
+/// type is not known yet. Variables read before the trace writes them get
+/// their guards once on entry instead.
+class TraceCompiler : public CodeGenerator {
+ public:
+  TraceCompiler(Bytecode* bytecode, int32_t header,
+                const std::vector<TraceStep>& steps)
+      : bytecode_{bytecode},
+        header_{header},
+        steps_{steps},
+        known_(bytecode->register_count + Context::kInlineVariables),
+        assumed_(known_.size()),
+        written_(known_.size()) {}
+
+  unique_ptr<MachineCode> Compile();
+
+ private:
+  using Arithmetic = void (Assembler::*)(Register, Register);
+  using DoubleArithmetic = void (Assembler::*)(XMMRegister, XMMRegister);
+
+  /// Returns true if the step was compiled together with `next`.
+  bool EmitStep(const TraceStep& step, const TraceStep* next);
+
+  void EmitArithmetic(const TraceStep& step, Arithmetic int32_op,
+                      DoubleArithmetic double_op);
+
+  bool EmitComparison(const TraceStep& step, const TraceStep* next,
+                      Condition condition);
+
+  void EmitIncrement(const TraceStep& step, int8_t delta);
+
+  void EmitNegate(const TraceStep& step);
+
+  void EmitJumpIfNotTrue(const TraceStep& step);
+
+  void EmitJumpIfToBooleanFalse(const TraceStep& step);
+
+  void EmitGenericStep(const int32_t* pc);
+
+  /// Makes sure variable `var` holds a `type` value from here on. A failing
+  /// guard leaves the trace at `offset`.
+  void Expect(int var, ValueType type, int32_t offset);
+
+  /// Loads the number in `var`, expected to be of `type`, as a double.
+  void LoadDouble(XMMRegister dst, int var, ValueType type, int32_t offset);
+
+  /// Boxes xmm0 into rax like Double::MakeFit().
+  void EmitMakeFit();
+
+  /// Jumps to `fail` unless `value` holds a `type` value. Clobbers rcx.
+  void EmitTypeCheck(Register value, ValueType type, Label* fail);
+
+  void LoadVariable(Register dst, int var);
+
+  void StoreVariable(int var, Register src);
+
+  void Define(int var, ValueType type) {
+    known_[var] = type;
+    written_[var] = true;
+  }
+
+  int Local(int32_t slot) const { return bytecode_->register_count + slot; }
+
+  const int32_t* PC(const TraceStep& step) const {
+    return bytecode_->code.data() + step.offset;
+  }
+
+  Label* Exit(int32_t offset) { return &exits_[offset]; }
+
+  Bytecode* bytecode_;
+  int32_t header_;
+  const std::vector<TraceStep>& steps_;
+  std::vector<ValueType> known_;
+  std::vector<ValueType> assumed_;  // on entry to the loop
+  std::vector<bool> written_;
+  std::map<int32_t, Label> exits_;  // by the offset they leave the trace at
+};
+
+unique_ptr<MachineCode> TraceCompiler::Compile() {
+  EmitPrologue();
+  Label loop, entry;
+  masm_.Jump(&entry);
+  masm_.Bind(&loop);
+  for (size_t i = 0; i < steps_.size(); i++) {
+    auto next = i + 1 < steps_.size() ? &steps_[i + 1] : nullptr;
+    if (EmitStep(steps_[i], next)) {
+      i++;
+    }
+  }
+  // The next iteration skips the entry guards if the trace kept the types
+  // they check.
+  auto stable = true;
+  for (size_t var = 0; var < known_.size(); var++) {
+    stable = stable && (assumed_[var] == ValueType::kUnknown ||
+                        known_[var] == assumed_[var]);
+  }
+  masm_.Jump(stable ? &loop : &entry);
+
+  masm_.Bind(&entry);
+  for (size_t var = 0; var < assumed_.size(); var++) {
+    if (assumed_[var] != ValueType::kUnknown) {
+      LoadVariable(Register::rax, var);
+      EmitTypeCheck(Register::rax, assumed_[var], Exit(header_));
+    }
+  }
+  masm_.Jump(&loop);
+
+  for (auto& [offset, label] : exits_) {
+    masm_.Bind(&label);
+    masm_.Mov32(Register::rax, offset);
+    masm_.Jump(&exit_);
+  }
+  masm_.Bind(&exception_);
+  masm_.Mov32(Register::rax, -1);
+  EmitEpilogue();
+  return MachineCode::New(masm_.code(), {});
+}
+
+bool TraceCompiler::EmitStep(const TraceStep& step, const TraceStep* next) {
+  auto pc = PC(step);
+  switch (static_cast<Opcode>(*pc)) {
+    case Opcode::LoadConstant: {
+      auto constant = bytecode_->constants[pc[2]];
+      auto type = TypeOf(constant.Get());
+      if (type == ValueType::kUnknown) {
+        masm_.Mov(Register::rax,
+                  reinterpret_cast<uint64_t>(constant.location()));
+        masm_.Load(Register::rax, Register::rax, 0);
+      } else {
+        masm_.Mov(Register::rax, Bits(constant.Get()));
+      }
+      StoreVariable(pc[1], Register::rax);
+      Define(pc[1], type);
+      break;
+    }
+    case Opcode::Move:
+      LoadVariable(Register::rax, pc[2]);
+      StoreVariable(pc[1], Register::rax);
+      Define(pc[1], known_[pc[2]]);
+      break;
+    case Opcode::LoadLocal:
+      if (pc[2] >= Context::kInlineVariables) {
+        EmitGenericStep(pc);
+        break;
+      }
+      if (IsNumber(step.types[0])) {
+        Expect(Local(pc[2]), step.types[0], step.offset);
+      }
+      LoadVariable(Register::rax, Local(pc[2]));
+      StoreVariable(pc[1], Register::rax);
+      Define(pc[1], known_[Local(pc[2])]);
+      break;
+    case Opcode::StoreLocal:
+      if (pc[1] >= Context::kInlineVariables) {
+        EmitGenericStep(pc);
+        break;
+      }
+      LoadVariable(Register::rax, pc[2]);
+      StoreVariable(Local(pc[1]), Register::rax);
+      Define(Local(pc[1]), known_[pc[2]]);
+      break;
+    case Opcode::Add:
+      EmitArithmetic(step, &Assembler::Add32, &Assembler::Addsd);
+      break;
+    case Opcode::Sub:
+      EmitArithmetic(step, &Assembler::Sub32, &Assembler::Subsd);
+      break;
+    case Opcode::Mul:
+      EmitArithmetic(step, &Assembler::Imul32, &Assembler::Mulsd);
+      break;
+    case Opcode::Div:
+      EmitArithmetic(step, nullptr, &Assembler::Divsd);
+      break;
+    case Opcode::Equal:
+      return EmitComparison(step, next, Condition::kEqual);
+    case Opcode::NotEqual:
+      return EmitComparison(step, next, Condition::kNotEqual);
+    case Opcode::LessThan:
+      return EmitComparison(step, next, Condition::kLess);
+    case Opcode::GreaterThan:
+      return EmitComparison(step, next, Condition::kGreater);
+    case Opcode::LessThanOrEqual:
+      return EmitComparison(step, next, Condition::kLessEqual);
+    case Opcode::GreaterThanOrEqual:
+      return EmitComparison(step, next, Condition::kGreaterEqual);
+    case Opcode::Increment:
+      EmitIncrement(step, 1);
+      break;
+    case Opcode::Decrement:
+      EmitIncrement(step, -1);
+      break;
+    case Opcode::Negate:
+      EmitNegate(step);
+      break;
+    case Opcode::Jump:
+      break;  // the trace is linear
+    case Opcode::JumpIfNotTrue:
+      EmitJumpIfNotTrue(step);
+      break;
+    case Opcode::JumpIfToBooleanFalse:
+      EmitJumpIfToBooleanFalse(step);
+      break;
+    default:
+      EmitGenericStep(pc);
+      break;
+  }
+  return false;
+}
+
+void TraceCompiler::EmitArithmetic(const TraceStep& step,
+                                   Arithmetic int32_op,
+                                   DoubleArithmetic double_op) {
+  auto pc = PC(step);
+  if (int32_op && step.types[0] == ValueType::kInt32 &&
+      step.types[1] == ValueType::kInt32) {
+    Expect(pc[2], ValueType::kInt32, step.offset);
+    Expect(pc[3], ValueType::kInt32, step.offset);
+    LoadVariable(Register::rax, pc[2]);
+    LoadVariable(Register::rdx, pc[3]);
+    (masm_.*int32_op)(Register::rax, Register::rdx);
+    masm_.Jump(Condition::kOverflow, Exit(step.offset));
+    masm_.Or(Register::rax, kInt32TagRegister);
+    StoreVariable(pc[1], Register::rax);
+    Define(pc[1], ValueType::kInt32);
+  } else if (IsNumber(step.types[0]) && IsNumber(step.types[1])) {
+    LoadDouble(XMMRegister::xmm0, pc[2], step.types[0], step.offset);
+    LoadDouble(XMMRegister::xmm1, pc[3], step.types[1], step.offset);
+    (masm_.*double_op)(XMMRegister::xmm0, XMMRegister::xmm1);
+    EmitMakeFit();
+    StoreVariable(pc[1], Register::rax);
+    Define(pc[1], ValueType::kNumber);
+  } else {
+    EmitGenericStep(pc);
+  }
+}
+
+bool TraceCompiler::EmitComparison(const TraceStep& step,
+                                   const TraceStep* next,
+                                   Condition condition) {
+  auto pc = PC(step);
+  auto relational =
+      condition != Condition::kEqual && condition != Condition::kNotEqual;
+  if (step.types[0] == ValueType::kInt32 &&
+      step.types[1] == ValueType::kInt32) {
+    Expect(pc[2], ValueType::kInt32, step.offset);
+    Expect(pc[3], ValueType::kInt32, step.offset);
+    LoadVariable(Register::rax, pc[2]);
+    LoadVariable(Register::rdx, pc[3]);
+    masm_.Cmp32(Register::rax, Register::rdx);
+  } else if (relational && IsNumber(step.types[0]) &&
+             IsNumber(step.types[1])) {
+    LoadDouble(XMMRegister::xmm0, pc[2], step.types[0], step.offset);
+    LoadDouble(XMMRegister::xmm1, pc[3], step.types[1], step.offset);
+    // Only "above" conditions are false for NaN operands, so the operands
+    // are swapped for less-than comparisons.
+    if (condition == Condition::kLess || condition == Condition::kLessEqual) {
+      masm_.Ucomisd(XMMRegister::xmm1, XMMRegister::xmm0);
+    } else {
+      masm_.Ucomisd(XMMRegister::xmm0, XMMRegister::xmm1);
+    }
+    condition = condition == Condition::kLess ||
+                        condition == Condition::kGreater
+                    ? Condition::kAbove
+                    : Condition::kAboveEqual;
+  } else {
+    EmitGenericStep(pc);
+    return false;
+  }
+
+  // A branch on the result becomes a guard, which leaves the trace at the
+  // comparison so that the interpreter redoes both.
+  if (next) {
+    auto jump = PC(*next);
+    auto opcode = static_cast<Opcode>(*jump);
+    if ((opcode == Opcode::JumpIfNotTrue ||
+         opcode == Opcode::JumpIfToBooleanFalse) &&
+        jump[1] == pc[1]) {
+      auto result = !next->taken;
+      masm_.Jump(result ? Negate(condition) : condition, Exit(step.offset));
+      masm_.Mov(Register::rax, Bits(Constant::Boolean(result)));
+      StoreVariable(pc[1], Register::rax);
+      Define(pc[1], ValueType::kUnknown);
+      return true;
+    }
+  }
+  masm_.Mov(Register::rax, Bits(Constant::Boolean(false)));
+  masm_.Mov(Register::rcx, Bits(Constant::Boolean(true)));
+  masm_.Cmov(condition, Register::rax, Register::rcx);
+  StoreVariable(pc[1], Register::rax);
+  Define(pc[1], ValueType::kUnknown);
+  return false;
+}
+
+void TraceCompiler::EmitIncrement(const TraceStep& step, int8_t delta) {
+  auto pc = PC(step);
+  if (step.types[0] != ValueType::kInt32) {
+    EmitGenericStep(pc);
+    return;
+  }
+  Expect(pc[2], ValueType::kInt32, step.offset);
+  LoadVariable(Register::rax, pc[2]);
+  masm_.Add32(Register::rax, delta);
+  masm_.Jump(Condition::kOverflow, Exit(step.offset));
+  masm_.Or(Register::rax, kInt32TagRegister);
+  StoreVariable(pc[1], Register::rax);
+  Define(pc[1], ValueType::kInt32);
+}
+
+void TraceCompiler::EmitNegate(const TraceStep& step) {
+  auto pc = PC(step);
+  if (!IsNumber(step.types[0])) {
+    EmitGenericStep(pc);
+    return;
+  }
+  LoadDouble(XMMRegister::xmm0, pc[2], step.types[0], step.offset);
+  masm_.Movq(Register::rax, XMMRegister::xmm0);
+  masm_.Mov(Register::rcx, Bits(-0.0));
+  masm_.Xor(Register::rax, Register::rcx);
+  StoreVariable(pc[1], Register::rax);
+  Define(pc[1], ValueType::kDouble);
+}
+
+void TraceCompiler::EmitJumpIfNotTrue(const TraceStep& step) {
+  auto pc = PC(step);
+  LoadVariable(Register::rax, pc[1]);
+  masm_.Mov(Register::rcx, Bits(Constant::Boolean(true)));
+  masm_.Cmp(Register::rax, Register::rcx);
+  masm_.Jump(step.taken ? Condition::kEqual : Condition::kNotEqual,
+             Exit(step.offset));
+}
+
+void TraceCompiler::EmitJumpIfToBooleanFalse(const TraceStep& step) {
+  auto pc = PC(step);
+  auto exit = Exit(step.offset);
+  Label done;
+  LoadVariable(Register::rdi, pc[1]);
+  masm_.Mov(Register::rcx, Bits(Constant::Boolean(true)));
+  masm_.Cmp(Register::rdi, Register::rcx);
+  masm_.Jump(Condition::kEqual, step.taken ? exit : &done);
+  masm_.Mov(Register::rcx, Bits(Constant::Boolean(false)));
+  masm_.Cmp(Register::rdi, Register::rcx);
+  masm_.Jump(Condition::kEqual, step.taken ? &done : exit);
+  masm_.Mov(Register::rax, reinterpret_cast<uint64_t>(&IsToBooleanTrue));
+  masm_.Call(Register::rax);
+  masm_.Test32(Register::rax, Register::rax);
+  masm_.Jump(step.taken ? Condition::kNotEqual : Condition::kEqual, exit);
+  masm_.Bind(&done);
+}
+
+void TraceCompiler::EmitGenericStep(const int32_t* pc) {
+  EmitStub(pc);
+  switch (static_cast<Opcode>(*pc)) {
+    case Opcode::StoreName:
+    case Opcode::StoreProperty:
+    case Opcode::DeclareFunction:
+    case Opcode::Call:
+      // May assign to the function's variables by name.
+      for (int32_t slot = 0; slot < Context::kInlineVariables; slot++) {
+        Define(Local(slot), ValueType::kUnknown);
+      }
+      if (static_cast<Opcode>(*pc) == Opcode::Call) {
+        Define(pc[1], ValueType::kUnknown);
+      }
+      break;
+    case Opcode::StoreLocal:
+    case Opcode::EnterBlock:
+    case Opcode::ExitBlock:
+      break;
+    default:
+      Define(pc[1], ValueType::kUnknown);
+      break;
+  }
+}
+
+void TraceCompiler::Expect(int var, ValueType type, int32_t offset) {
+  if (known_[var] == type) {
+    return;
+  }
+  if (!written_[var] && assumed_[var] == ValueType::kUnknown) {
+    assumed_[var] = type;
+  } else {
+    LoadVariable(Register::rax, var);
+    EmitTypeCheck(Register::rax, type, Exit(offset));
+  }
+  known_[var] = type;
+}
+
+void TraceCompiler::LoadDouble(XMMRegister dst, int var, ValueType type,
+                               int32_t offset) {
+  Expect(var, type, offset);
+  LoadVariable(Register::rax, var);
+  if (type == ValueType::kInt32) {
+    masm_.Cvtsi2sd(dst, Register::rax);
+  } else {
+    masm_.Movq(dst, Register::rax);
+  }
+}
+
+void TraceCompiler::EmitMakeFit() {
+  Label not_int32, done;
+  // Out of range and NaN convert to kMinInt32, which only round-trips for
+  // kMinInt32 itself.
+  masm_.Cvttsd2si(Register::rax, XMMRegister::xmm0);
+  masm_.Cvtsi2sd(XMMRegister::xmm1, Register::rax);
+  masm_.Ucomisd(XMMRegister::xmm0, XMMRegister::xmm1);
+  masm_.Jump(Condition::kNotEqual, &not_int32);
+  masm_.Jump(Condition::kParityEven, &not_int32);  // NaN
+  masm_.Or(Register::rax, kInt32TagRegister);
+  masm_.Jump(&done);
+  masm_.Bind(&not_int32);
+  masm_.Movq(Register::rax, XMMRegister::xmm0);
+  masm_.Bind(&done);
+}
+
+void TraceCompiler::EmitTypeCheck(Register value, ValueType type,
+                                  Label* fail) {
+  if (type == ValueType::kInt32) {
+    EmitInt32Check(value, fail);
+  } else {
+    assert(type == ValueType::kDouble);
+    masm_.Mov(Register::rcx, Double::kDoubleLimit);
+    masm_.Cmp(value, Register::rcx);
+    masm_.Jump(Condition::kAbove, fail);
+  }
+}
+
+void TraceCompiler::LoadVariable(Register dst, int var) {
+  if (var < bytecode_->register_count) {
+    LoadRegister(dst, var);
+  } else {
+    masm_.Load(dst, kLocals,
+               (var - bytecode_->register_count) * 2 * kPointerSize);
+  }
+}
+
+void TraceCompiler::StoreVariable(int var, Register src) {
+  if (var < bytecode_->register_count) {
+    StoreRegister(var, src);
+  } else {
+    masm_.Store(kLocals, (var - bytecode_->register_count) * 2 * kPointerSize,
+                src);
+  }
+}
+
+}  // namespace
+
+int32_t Jit::threshold_{Jit::kDefaultThreshold};
+
+int32_t Tracer::threshold_{Tracer::kDefaultThreshold};
+
+unique_ptr<MachineCode> MachineCode::New(const std::vector<uint8_t>& code,
+                                         std::vector<int32_t> entry_offsets) {
+  auto memory = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    return nullptr;
+  }
+  std::memcpy(memory, code.data(), code.size());
+  if (mprotect(memory, code.size(), PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, code.size());
+    return nullptr;
+  }
+  return unique_ptr<MachineCode>{new MachineCode{
+      static_cast<uint8_t*>(memory), code.size(), std::move(entry_offsets)}};
+}
+
+MachineCode::~MachineCode() { munmap(memory_, size_); }
+
+Object* MachineCode::Run(Object** registers, VM::Frame* frame,
+                         Object** locals, int32_t pc) const {
+  auto entry = reinterpret_cast<Entry>(memory_);
+  auto resume = pc == 0 ? nullptr : memory_ + entry_offsets_[pc];
+  return entry(registers, frame, locals, resume);
+}
+
+int32_t MachineCode::RunTrace(Object** registers, VM::Frame* frame,
+                              Object** locals) const {
+  return reinterpret_cast<TraceEntry>(memory_)(registers, frame, locals);
+}
+
+void Jit::Compile(Bytecode* bytecode) {
+  if (Tracer::Traces(bytecode)) {
+    // Traces are entered from the interpreter only.
+    bytecode->hotness = 0;
+    return;
+  }
+  bytecode->machine_code = BaselineCompiler{bytecode}.Compile();
+  if (!bytecode->machine_code) {
+    // Out of executable memory, keep interpreting.
+    bytecode->hotness = std::numeric_limits<int32_t>::min();
+  }
+}
+
+bool TraceRecorder::Record(const int32_t* pc, Object** registers,
+                           Object** locals) {
+  TraceStep step{static_cast<int32_t>(pc - bytecode_->code.data()),
+                 {ValueType::kUnknown, ValueType::kUnknown},
+                 false};
+  switch (static_cast<Opcode>(*pc)) {
+    case Opcode::Jump:
+      if (pc[1] == loop_->header) {
+        Tracer::Compile(bytecode_, loop_, steps_);
+        return false;
+      }
+      if (pc[1] < step.offset) {
+        return Abort();  // an inner loop
+      }
+      break;
+    case Opcode::JumpIfNotTrue:
+      step.taken = !registers[pc[1]]->IsTrue();
+      break;
+    case Opcode::JumpIfToBooleanFalse:
+      step.taken = !registers[pc[1]]->ToBoolean()->IsTrue();
+      break;
+    case Opcode::Return:
+      return Abort();
+    case Opcode::LoadLocal:
+      if (pc[2] < Context::kInlineVariables) {
+        step.types[0] = TypeOf(locals[pc[2] * 2]);
+      }
+      break;
+    case Opcode::Increment:
+    case Opcode::Decrement:
+    case Opcode::Negate:
+      step.types[0] = TypeOf(registers[pc[2]]);
+      break;
+    case Opcode::Add:
+    case Opcode::Sub:
+    case Opcode::Mul:
+    case Opcode::Div:
+    case Opcode::Equal:
+    case Opcode::NotEqual:
+    case Opcode::LessThan:
+    case Opcode::GreaterThan:
+    case Opcode::LessThanOrEqual:
+    case Opcode::GreaterThanOrEqual:
+      step.types[0] = TypeOf(registers[pc[2]]);
+      step.types[1] = TypeOf(registers[pc[3]]);
+      break;
+    default:
+      break;
+  }
+  if (steps_.size() == Tracer::kMaxTraceLength) {
+    return Abort();
+  }
+  steps_.push_back(step);
+  return true;
+}
+
+bool TraceRecorder::Abort() {
+  // Try again later, a loop may take another path the next time.
+  loop_->aborts++;
+  loop_->hotness = 0;
+  return false;
+}
+
+LoopTrace* Tracer::Tick(Bytecode* bytecode, int32_t header) {
+  if (threshold_ < 0) {
+    return nullptr;
+  }
+  auto& loops = bytecode->loops;
+  auto it = std::find_if(loops.begin(), loops.end(),
+                         [=](auto& loop) { return loop->header == header; });
+  auto loop = it != loops.end()
+                  ? it->get()
+                  : loops.emplace_back(new LoopTrace{header}).get();
+  if (loop->code) {
+    return loop;
+  }
+  if (loop->aborts >= kMaxAborts || ++loop->hotness <= threshold_) {
+    return nullptr;
+  }
+  return loop;
+}
+
+bool Tracer::Traces(Bytecode* bytecode) {
+  return std::any_of(
+      bytecode->loops.begin(), bytecode->loops.end(),
+      [](auto& loop) { return loop->code || loop->aborts < kMaxAborts; });
+}
+
+void Tracer::Compile(Bytecode* bytecode, LoopTrace* loop,
+                     const std::vector<TraceStep>& steps) {
+  if (loop->code) {
+    return;  // traced by a recursive call meanwhile
+  }
+  loop->code = TraceCompiler{bytecode, loop->header, steps}.Compile();
+  if (!loop->code) {
+    loop->aborts = kMaxAborts;
+  }
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "bytecode.hh"
+#include "kipper.hh"
+#include "vm.hh"
+
+namespace kipper {
+namespace internal {
+
+class Object;
+
+/// Executable x86-64 code compiled from one Bytecode.
+///
+/// The code works on the registers of a VM::Frame and the function Context's
+/// inline slots, so the VM can switch to it in the middle of a loop.
+class MachineCode {
+ public:
+  /// Copies `code` to executable memory, `entry_offsets` maps bytecode
+  /// offsets to code offsets. Returns nullptr if no memory can be mapped.
+  static unique_ptr<MachineCode> New(const std::vector<uint8_t>& code,
+                                     std::vector<int32_t> entry_offsets);
+
+  ~MachineCode();
+
+  /// Runs the code from the instruction at bytecode offset `pc`, returns
+  /// nullptr if the code stopped at an exception stored in `frame`.
+  Object* Run(Object** registers, VM::Frame* frame, Object** locals,
+              int32_t pc) const;
+
+  /// Runs the code of a loop trace, returns the bytecode offset the
+  /// interpreter continues at, or -1 if the code stopped at an exception.
+  int32_t RunTrace(Object** registers, VM::Frame* frame,
+                   Object** locals) const;
+
+  DISABLE_DEFAULT_OP(MachineCode)
+ private:
+  using Entry = Object* (*)(Object** registers, VM::Frame* frame,
+                            Object** locals, const uint8_t* resume);
+  using TraceEntry = int32_t (*)(Object** registers, VM::Frame* frame,
+                                 Object** locals);
+
+  MachineCode(uint8_t* memory, size_t size, std::vector<int32_t> entry_offsets)
+      : memory_{memory},
+        size_{size},
+        entry_offsets_{std::move(entry_offsets)} {}
+
+  uint8_t* memory_;
+  size_t size_;
+  std::vector<int32_t> entry_offsets_;
+};
+
+/// Baseline compiler from Bytecode to machine code.
+///
+/// Every bytecode becomes a fixed template: moves, jumps and the int32 fast
+/// paths of arithmetic and comparisons are emitted inline, anything else
+/// calls the VM::Stub sharing the interpreter's implementation.
+/// Values stay NaN-boxed in the VM registers, so GC and exceptions see the
+/// same state as with the interpreter.
+class Jit : public AllStatic {
+ public:
+  /// Counts an invocation or a loop iteration of `bytecode`, and compiles it
+  /// once the count exceeds the threshold. Returns the machine code if any.
+  static MachineCode* Tick(Bytecode* bytecode) {
+    if (!bytecode->machine_code && threshold_ >= 0 &&
+        ++bytecode->hotness > threshold_) {
+      Compile(bytecode);
+    }
+    return bytecode->machine_code.get();
+  }
+
+  /// A negative `threshold` disables the Jit.
+  static void SetThreshold(int32_t threshold) { threshold_ = threshold; }
+
+  static constexpr int32_t kDefaultThreshold = 1000;
+
+ private:
+  static void Compile(Bytecode* bytecode);
+
+  static int32_t threshold_;
+};
+
+/// What a trace knows about a value, from the lattice kUnknown > kNumber >
+/// kInt32 and kDouble.
+enum class ValueType : uint8_t { kUnknown, kNumber, kInt32, kDouble };
+
+/// One executed instruction of a recorded loop iteration.
+struct TraceStep {
+  int32_t offset;
+  ValueType types[2];  // of the operands read, see TraceRecorder::Record()
+  bool taken;          // whether a conditional jump jumped
+};
+
+/// The back edge count and the trace of a loop.
+struct LoopTrace {
+  explicit LoopTrace(int32_t header) : header{header} {}
+
+  int32_t header;  // offset of the first instruction of the loop
+  int32_t hotness{0};
+  int32_t aborts{0};
+  unique_ptr<MachineCode> code;
+};
+
+/// Records the instructions the interpreter runs through one iteration of a
+/// hot loop, together with the types of their operands and the direction of
+/// every branch.
+class TraceRecorder {
+ public:
+  TraceRecorder(Bytecode* bytecode, LoopTrace* loop)
+      : bytecode_{bytecode}, loop_{loop} {}
+
+  /// Records the instruction at `pc` before the interpreter runs it. Returns
+  /// false once the iteration is complete or cannot be traced, the
+  /// instruction at `pc` is then left to the interpreter.
+  bool Record(const int32_t* pc, Object** registers, Object** locals);
+
+  DISABLE_DEFAULT_OP(TraceRecorder)
+ private:
+  bool Abort();
+
+  Bytecode* bytecode_;
+  LoopTrace* loop_;
+  std::vector<TraceStep> steps_;
+};
+
+/// Tracing compiler for hot loops.
+///
+/// Once a loop header has seen enough back edges, the interpreter records
+/// one iteration of the loop and the Tracer compiles it to a linear piece of
+/// machine code. Arithmetic and comparisons are specialized to the int32 and
+/// double operands seen while recording, branches become guards, and type
+/// guards on values live into the loop are hoisted out of it. A guard that
+/// fails leaves the trace at the guarded instruction, which the interpreter
+/// then runs.
+class Tracer : public AllStatic {
+ public:
+  /// Counts a back edge to `header`. Returns the loop once it is hot, to be
+  /// run if it has code or recorded otherwise.
+  static LoopTrace* Tick(Bytecode* bytecode, int32_t header);
+
+  /// Whether a loop of `bytecode` runs on a trace or may get one, such
+  /// bytecode is left to the interpreter rather than the Jit.
+  static bool Traces(Bytecode* bytecode);
+
+  /// A negative `threshold` disables tracing.
+  static void SetThreshold(int32_t threshold) { threshold_ = threshold; }
+
+  static constexpr int32_t kDefaultThreshold = 100;
+  static constexpr int32_t kMaxTraceLength = 512;
+  static constexpr int32_t kMaxAborts = 3;
+
+ private:
+  friend class TraceRecorder;
+
+  static void Compile(Bytecode* bytecode, LoopTrace* loop,
+                      const std::vector<TraceStep>& steps);
+
+  static int32_t threshold_;
+};
+
+}  // namespace internal
+}  // namespace kipper
@@ -23,5 +23,6 @@ void Kipper::Initialize() {
   initialized_ = true;
 }
 
-KSError::KSError(const Location& loc, const char* msg)
-    : KError{msg}, what_{Message::Format("{}: {}", loc, msg)} {}
\ No newline at end of file
+KSError::KSError(const SourceRange& loc, const char* msg)
+    : KError{msg},
+      what_{Message::Format("{}: {}", Compiler::Resolve(loc), msg)} {}
\ No newline at end of file
@@ -17,6 +17,12 @@ namespace internal {
   T& operator=(const T&) = delete; \
   T& operator=(T&&) = delete;
 
+#if defined(__GNUC__)
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
 #ifndef NDEBUG
 #define UNREACHABLE()                                              \
   do {                                                             \
@@ -75,10 +81,10 @@ class KError : public std::runtime_error {
 
 class KSError : public KError {
  public:
-  KSError(const Location& loc, const std::string& msg)
+  KSError(const SourceRange& loc, const std::string& msg)
       : KSError{loc, msg.data()} {}
 
-  KSError(const Location& loc, const char* msg);
+  KSError(const SourceRange& loc, const char* msg);
 
   virtual ~KSError() = default;
 
@@ -1,11 +1,32 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <string_view>
 
 namespace kipper {
 namespace internal {
 
+/// A range of source code, as offsets in the position space all compiled
+/// scripts share. Compiler::Resolve() turns it into a Location.
+struct SourceRange {
+  /// The first position, 0 for code without a source.
+  uint32_t begin = 0;
+  /// The position past the range.
+  uint32_t end = 0;
+};
+
+/// Join two ranges, in place.
+inline SourceRange& operator+=(SourceRange& res, const SourceRange& end) {
+  res.end = end.end;
+  return res;
+}
+
+/// Join two ranges.
+inline SourceRange operator+(SourceRange res, const SourceRange& end) {
+  return res += end;
+}
+
 class Position {
  public:
   explicit Position(std::string_view f = std::string_view{}, unsigned l = 1u,
@@ -0,0 +1,66 @@
+#include "mapped_file.hh"
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define KIPPER_MMAP
+#else
+#include <fstream>
+#include <sstream>
+#endif
+
+using namespace kipper::internal;
+
+#if defined(KIPPER_MMAP)
+
+MappedFile::MappedFile(const std::string& path) {
+  auto fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw KError{"failed to open " + path};
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || !S_ISREG(status.st_mode)) {
+    close(fd);
+    throw KError{"failed to read " + path};
+  }
+  auto size = static_cast<size_t>(status.st_size);
+  // Reserves zeroed pages with room for the '\0', then maps the file over
+  // their start. The rest of its last page reads as zeros too.
+  auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  mapped_size_ = (size / page_size + 1) * page_size;
+  auto region = mmap(nullptr, mapped_size_, PROT_READ,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (region != MAP_FAILED && size > 0 &&
+      mmap(region, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+          MAP_FAILED) {
+    munmap(region, mapped_size_);
+    region = MAP_FAILED;
+  }
+  close(fd);
+  if (region == MAP_FAILED) {
+    throw KError{"failed to map " + path};
+  }
+  contents_ = {static_cast<const char*>(region), size};
+}
+
+MappedFile::~MappedFile() {
+  munmap(const_cast<char*>(contents_.data()), mapped_size_);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+  std::ifstream input{path, std::ios::in | std::ios::binary};
+  if (!input.is_open()) {
+    throw KError{"failed to open " + path};
+  }
+  std::stringstream contents;
+  contents << input.rdbuf();
+  buffer_ = contents.str();
+  contents_ = buffer_;
+}
+
+MappedFile::~MappedFile() = default;
+
+#endif
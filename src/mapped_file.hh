@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include "kipper.hh"
+
+namespace kipper {
+namespace internal {
+
+/// The read-only contents of a file, followed by a '\0' as the Scanner
+/// expects. Mapped into memory where the platform allows, so that the page
+/// cache is the only copy, and read otherwise. A mapped file must not be
+/// truncated while it is in use.
+class MappedFile {
+ public:
+  /// Throws a KError if `path` cannot be opened or read.
+  explicit MappedFile(const std::string& path);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::string_view contents() const { return contents_; }
+
+ private:
+  std::string_view contents_;
+  size_t mapped_size_{0};
+  std::string buffer_;
+};
+
+}  // namespace internal
+}  // namespace kipper
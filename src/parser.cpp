@@ -1,4 +1,5 @@
 #include "parser.hh"
+#include <utility>
 #include "compiler.hh"
 #include "message.hh"
 #include "value.hh"
@@ -36,16 +37,17 @@ class FunctionScopeHandler {
 }  // namespace kipper::internal
 
 template <typename... Args>
-void ReportError(const Location& loc, const char* format, Args... args) {
+void ReportError(const SourceRange& loc, const char* format, Args... args) {
   throw KSSyntaxError{loc, Message::Format(format, args...)};
 }
 
-Parser::Parser(std::string_view code, const Location& loc)
-    : code_{code}, loc_{loc} {}
-
-Node::Ptr Parser::Parse() {
-  scanner_.Initialize(code_, loc_);
-  auto unit = CreateNode<TranslationUnit>(scanner_.CurrentLocation());
+unique_ptr<TranslationUnit> Parser::Parse(
+    std::vector<DeferredValue>* deferred) {
+  deferred_ = deferred;
+  scanner_.Initialize(source_);
+  auto unit = std::make_unique<TranslationUnit>();
+  unit->loc = scanner_.CurrentLocation();
+  zone_ = &unit->zone;
   while (!Look(Token::END)) {
     if (Look(Token::FUNCTION)) {
       unit->fn_decls.push_back(ParseFunctionDecl());
@@ -56,35 +58,64 @@ Node::Ptr Parser::Parse() {
   return unit;
 }
 
-FunctionDecl::Ptr Parser::ParseFunctionDecl() {
+FunctionDecl* Parser::ParseFunctionDecl() {
   assert(Look(Token::FUNCTION));
-  auto result = CreateNode<FunctionDecl>(scanner_.CurrentLocation());
+  auto result = CreateNode<FunctionDecl>(zone_, scanner_.CurrentLocation());
   Next();
+  if (Look(Token::ID)) {
+    result->name = Symbol();
+    Defer(result, DeferredValue::FUNCTION_NAME);
+  }
   Expect(Token::ID);
-  result->name = Handle{String::NewSymbol(scanner_.CurrentLiteral())};
   Expect(Token::LP);
   if (!Look(Token::RP)) {
     FunctionDecl::Params params{};
     do {
-      params.push_back(Identifier::Ptr{
-          static_cast<Identifier*>(ParseIdentifierName().release())});
+      params.push_back(ParseIdentifierName());
     } while (Accept(Token::COMMA));
     result->params = std::move(params);
   }
   Expect(Token::RP);
+  if (Compiler::lazy_parsing_enabled()) {
+    // Checks the syntax of the body, dropping its nodes along the way.
+    Zone zone;
+    auto unit_zone = std::exchange(zone_, &zone);
+    preparsing_ = true;
+    ParseFunctionBody(result);
+    preparsing_ = false;
+    zone_ = unit_zone;
+    result->body = FunctionDecl::Body{};
+    result->lazy = true;
+    result->zone = zone_;
+  } else {
+    ParseFunctionBody(result);
+  }
+  result->loc += result->body_loc;
+  return result;
+}
+
+void Parser::ParseLazyFunction(FunctionDecl* fn_decl) {
+  assert(fn_decl->lazy);
+  scanner_.Initialize(source_, fn_decl->body_loc.begin - source_->base);
+  zone_ = fn_decl->zone;
+  ParseFunctionBody(fn_decl);
+  fn_decl->lazy = false;
+}
+
+void Parser::ParseFunctionBody(FunctionDecl* fn_decl) {
+  auto loc = scanner_.CurrentLocation();
   Expect(Token::LC);
   FunctionScopeHandler fn_scope{this};
   FunctionDecl::Body body{};
   while (!Look(Token::RC)) {
     body.push_back(ParseStatement());
   }
-  result->loc += scanner_.CurrentLocation();
-  result->body = std::move(body);
+  fn_decl->body_loc = loc + scanner_.CurrentLocation();
+  fn_decl->body = std::move(body);
   Expect(Token::RC);
-  return result;
 }
 
-Statement::Ptr Parser::ParseStatement() {
+Statement* Parser::ParseStatement() {
   switch (Peek()) {
     case Token::LC:
       return ParseBlockStatement();
@@ -106,9 +137,9 @@ Statement::Ptr Parser::ParseStatement() {
   UNREACHABLE();
 }
 
-Statement::Ptr Parser::ParseBlockStatement() {
+Statement* Parser::ParseBlockStatement() {
   assert(Look(Token::LC));
-  auto result = CreateNode<BlockStatement>(scanner_.CurrentLocation());
+  auto result = CreateNode<BlockStatement>(zone_, scanner_.CurrentLocation());
   Expect(Token::LC);
   BlockStatement::Statements stmts;
   while (!Look(Token::RC)) {
@@ -120,16 +151,16 @@ Statement::Ptr Parser::ParseBlockStatement() {
   return result;
 }
 
-Statement::Ptr Parser::ParseIfStatement() {
+Statement* Parser::ParseIfStatement() {
   assert(Look(Token::IF));
-  auto if_stmt = CreateNode<IfStatement>(scanner_.CurrentLocation());
+  auto if_stmt = CreateNode<IfStatement>(zone_, scanner_.CurrentLocation());
   Next();
   Expect(Token::LP);
   if_stmt->condition = ParseExpression();
   Expect(Token::RP);
   auto then = ParseStatement();
   if_stmt->loc += then->loc;
-  if_stmt->then_stmt = std::move(then);
+  if_stmt->then_stmt = then;
   if (Accept(Token::ELSE)) {
     if_stmt->else_stmt = ParseStatement();
     if_stmt->loc += if_stmt->else_stmt->loc;
@@ -137,7 +168,7 @@ Statement::Ptr Parser::ParseIfStatement() {
   return if_stmt;
 }
 
-Statement::Ptr Parser::ParseWhileStatement() {
+Statement* Parser::ParseWhileStatement() {
   assert(Look(Token::WHILE));
   auto loc = scanner_.CurrentLocation();
   Next();
@@ -146,13 +177,13 @@ Statement::Ptr Parser::ParseWhileStatement() {
   Expect(Token::RP);
   BreakableScopeHandler breakable_scope{this};
   auto loop_stmt = ParseStatement();
-  return CreateNode<WhileStatement>(loc + loop_stmt->loc, std::move(condition),
-                                    std::move(loop_stmt));
+  return CreateNode<WhileStatement>(zone_, loc + loop_stmt->loc, condition,
+                                    loop_stmt);
 }
 
-Statement::Ptr Parser::ParseForStatement() {
+Statement* Parser::ParseForStatement() {
   assert(Look(Token::FOR));
-  auto for_stmt = CreateNode<ForStatement>(scanner_.CurrentLocation());
+  auto for_stmt = CreateNode<ForStatement>(zone_, scanner_.CurrentLocation());
   Next();
   Expect(Token::LP);
   if (!Look(Token::SEMI)) {
@@ -169,13 +200,13 @@ Statement::Ptr Parser::ParseForStatement() {
   Expect(Token::RP);
   BreakableScopeHandler breakable_scope{this};
   for_stmt->loop_stmt = ParseStatement();
-  for_stmt->loc = for_stmt->loop_stmt->loc;
+  for_stmt->loc += for_stmt->loop_stmt->loc;
   return for_stmt;
 }
 
-Statement::Ptr Parser::ParseReturnStatement() {
+Statement* Parser::ParseReturnStatement() {
   assert(Look(Token::RETURN));
-  auto result = CreateNode<ReturnStatement>(scanner_.CurrentLocation());
+  auto result = CreateNode<ReturnStatement>(zone_, scanner_.CurrentLocation());
   Next();
   if (scanner_.has_line_terminator() || Look(Token::END)) {
     return result;
@@ -189,9 +220,9 @@ Statement::Ptr Parser::ParseReturnStatement() {
   return result;
 }
 
-Statement::Ptr Parser::ParseBreakStatement() {
+Statement* Parser::ParseBreakStatement() {
   assert(Look(Token::BREAK));
-  auto result = CreateNode<BreakStatement>(scanner_.CurrentLocation());
+  auto result = CreateNode<BreakStatement>(zone_, scanner_.CurrentLocation());
   Next();
   ExpectEnd();
   if (!is_breakable_scope_) {
@@ -200,9 +231,10 @@ Statement::Ptr Parser::ParseBreakStatement() {
   return result;
 }
 
-Statement::Ptr Parser::ParseContinueStatement() {
+Statement* Parser::ParseContinueStatement() {
   assert(Look(Token::CONTINUE));
-  auto result = CreateNode<ContinueStatement>(scanner_.CurrentLocation());
+  auto result =
+      CreateNode<ContinueStatement>(zone_, scanner_.CurrentLocation());
   Next();
   ExpectEnd();
   if (!is_breakable_scope_) {
@@ -211,125 +243,68 @@ Statement::Ptr Parser::ParseContinueStatement() {
   return result;
 }
 
-Statement::Ptr Parser::ParseExpressionStatement() {
+Statement* Parser::ParseExpressionStatement() {
   auto expr = ParseExpression();
-  auto expr_stmt = CreateNode<ExpressionStatement>(expr->loc);
-  expr_stmt->expr = std::move(expr);
+  auto expr_stmt = CreateNode<ExpressionStatement>(zone_, expr->loc);
+  expr_stmt->expr = expr;
   expr_stmt->loc = expr_stmt->expr->loc;
   ExpectEnd();
   return expr_stmt;
 }
 
-Expression::Ptr Parser::ParseExpression() { return ParseAssignment(); }
+Expression* Parser::ParseExpression() { return ParseAssignment(); }
 
-Expression::Ptr Parser::ParseAssignment() {
+Expression* Parser::ParseAssignment() {
   auto conditional = ParseConditionalExpression();
   if (conditional->IsLeftHandSideExpression() &&
       Token::IsAssignmentOperator(Peek())) {
     auto op = Peek();
     Next();
     auto value = ParseAssignment();
-    auto assignment = CreateNode<Assignment>(conditional->loc + value->loc);
-    assignment->target = std::move(conditional);
+    auto assignment =
+        CreateNode<Assignment>(zone_, conditional->loc + value->loc);
+    assignment->target = conditional;
     assignment->op = op;
-    assignment->value = std::move(value);
+    assignment->value = value;
     return assignment;
   }
   return conditional;
 }
 
-Expression::Ptr Parser::ParseConditionalExpression() {
-  auto logic_or = ParseLogicOrExpression();
+Expression* Parser::ParseConditionalExpression() {
+  auto condition = ParseBinaryExpression(1);
   if (Accept(Token::QUES)) {
     auto then = ParseAssignment();
     Expect(Token::COLON);
     auto else_expr = ParseAssignment();
-    auto conditional =
-        CreateNode<ConditionalExpression>(logic_or->loc + else_expr->loc);
-    conditional->condition = std::move(logic_or);
-    conditional->then_expr = std::move(then);
-    conditional->else_expr = std::move(else_expr);
+    auto conditional = CreateNode<ConditionalExpression>(
+        zone_, condition->loc + else_expr->loc);
+    conditional->condition = condition;
+    conditional->then_expr = then;
+    conditional->else_expr = else_expr;
     return conditional;
   }
-  return logic_or;
+  return condition;
 }
 
-Expression::Ptr Parser::ParseLogicOrExpression() {
-  auto result = ParseLogicAndExpression();
-  while (Accept(Token::LOGIC_OR)) {
-    auto right = ParseLogicAndExpression();
-    auto loc = result->loc + right->loc;
-    result = CreateNode<BinaryExpression>(loc, std::move(result),
-                                          std::move(right), Token::LOGIC_OR);
-  }
-  return result;
-}
-
-Expression::Ptr Parser::ParseLogicAndExpression() {
-  auto result = ParseEqualityExpression();
-  while (Accept(Token::LOGIC_AND)) {
-    auto right = ParseEqualityExpression();
-    auto loc = result->loc + right->loc;
-    result = CreateNode<BinaryExpression>(loc, std::move(result),
-                                          std::move(right), Token::LOGIC_AND);
-  }
-  return result;
-}
-
-Expression::Ptr Parser::ParseEqualityExpression() {
-  auto result = ParseRelationalExpression();
-  while (Look(Token::EQ) || Look(Token::NE)) {
-    auto op = Peek();
-    Next();
-    auto right = ParseRelationalExpression();
-    auto loc = result->loc + right->loc;
-    result = CreateNode<BinaryExpression>(loc, std::move(result),
-                                          std::move(right), op);
-  }
-  return result;
-}
-
-Expression::Ptr Parser::ParseRelationalExpression() {
-  auto result = ParseAdditiveExpression();
-  while (Look(Token::LT) || Look(Token::GT) || Look(Token::LTE) ||
-         Look(Token::GTE)) {
-    auto op = Peek();
-    Next();
-    auto right = ParseAdditiveExpression();
-    auto loc = result->loc + right->loc;
-    result = CreateNode<BinaryExpression>(loc, std::move(result),
-                                          std::move(right), op);
-  }
-  return result;
-}
-
-Expression::Ptr Parser::ParseAdditiveExpression() {
-  auto result = ParseMultiplicativeExpression();
-  while (Look(Token::PLUS) || Look(Token::SUB)) {
-    auto op = Peek();
-    Next();
-    auto right = ParseMultiplicativeExpression();
-    auto loc = result->loc + right->loc;
-    result = CreateNode<BinaryExpression>(loc, std::move(result),
-                                          std::move(right), op);
-  }
-  return result;
-}
-
-Expression::Ptr Parser::ParseMultiplicativeExpression() {
+// Precedence climbing: every binary operator is left-associative, so the
+// right operand only takes operators that bind more tightly.
+Expression* Parser::ParseBinaryExpression(int min_precedence) {
   auto result = ParseUnaryExpression();
-  while (Look(Token::MUL) || Look(Token::DIV) || Look(Token::MOD)) {
+  while (true) {
     auto op = Peek();
+    auto precedence = Token::GetPrecedence(op);
+    if (precedence < min_precedence) {
+      return result;
+    }
     Next();
-    auto right = ParseUnaryExpression();
+    auto right = ParseBinaryExpression(precedence + 1);
     auto loc = result->loc + right->loc;
-    result = CreateNode<BinaryExpression>(loc, std::move(result),
-                                          std::move(right), op);
+    result = CreateNode<BinaryExpression>(zone_, loc, result, right, op);
   }
-  return result;
 }
 
-Expression::Ptr Parser::ParseUnaryExpression() {
+Expression* Parser::ParseUnaryExpression() {
   auto op = Peek();
   switch (op) {
     case Token::INC:
@@ -341,7 +316,7 @@ Expression::Ptr Parser::ParseUnaryExpression() {
     default:
       return ParsePostfixExpression();
   }
-  auto result = CreateNode<UnaryExpression>(scanner_.CurrentLocation());
+  auto result = CreateNode<UnaryExpression>(zone_, scanner_.CurrentLocation());
   Next();
   result->target = ParseUnaryExpression();
   result->op = op;
@@ -349,28 +324,24 @@ Expression::Ptr Parser::ParseUnaryExpression() {
   return result;
 }
 
-Expression::Ptr Parser::ParsePostfixExpression() {
-  auto result = ParseLeftHandSideExpression();
+Expression* Parser::ParsePostfixExpression() {
+  auto result = ParseCallExpression();
   if (Look(Token::INC) || Look(Token::DEC)) {
     auto op = Peek();
     auto loc = result->loc + scanner_.CurrentLocation();
-    result = CreateNode<PostfixExpression>(loc, std::move(result), op);
+    result = CreateNode<PostfixExpression>(zone_, loc, result, op);
     Next();
   }
   return result;
 }
 
-Expression::Ptr Parser::ParseLeftHandSideExpression() {
-  return ParseCallExpression();
-}
-
-Expression::Ptr Parser::ParseCallExpression() {
-  auto result = ParseMemberExpression();
+Expression* Parser::ParseCallExpression() {
+  auto result = ParsePrimaryExpression();
   while (true) {
     if (Accept(Token::LP)) {
       if (Look(Token::RP)) {
         auto loc = result->loc + scanner_.CurrentLocation();
-        result = CreateNode<FunctionCall>(loc, std::move(result));
+        result = CreateNode<FunctionCall>(zone_, loc, result);
         Next();
         continue;
       }
@@ -380,53 +351,31 @@ Expression::Ptr Parser::ParseCallExpression() {
       } while (Accept(Token::COMMA));
       auto loc = result->loc + scanner_.CurrentLocation();
       result =
-          CreateNode<FunctionCall>(loc, std::move(result), std::move(args));
+          CreateNode<FunctionCall>(zone_, loc, result, std::move(args));
       Expect(Token::RP);
       continue;
     }
-    if (Accept(Token::LBRACKET)) {
-      auto member = ParseExpression();
-      Expect(Token::RBRACKET);
-      auto loc = result->loc + member->loc;
-      result = CreateNode<MemberAccess>(loc, std::move(result),
-                                        std::move(member), MemberAccess::KEYED);
-      continue;
-    }
-    if (Accept(Token::DOT)) {
-      auto member = ParseIdentifierName();
-      auto loc = result->loc + member->loc;
-      result = CreateNode<MemberAccess>(
-          loc, std::move(result), std::move(member), MemberAccess::DOTTED);
-      continue;
-    }
-    break;
-  }
-  return result;
-}
-
-Expression::Ptr Parser::ParseMemberExpression() {
-  auto result = ParsePrimaryExpression();
-  while (true) {
     if (Accept(Token::LBRACKET)) {
       auto member = ParseExpression();
       auto loc = result->loc + scanner_.CurrentLocation();
-      result = CreateNode<MemberAccess>(loc, std::move(result),
-                                        std::move(member), MemberAccess::KEYED);
+      result = CreateNode<MemberAccess>(zone_, loc, result, member,
+                                        MemberAccess::KEYED);
       Expect(Token::RBRACKET);
       continue;
     }
     if (Accept(Token::DOT)) {
       auto member = ParseIdentifierName();
       auto loc = result->loc + member->loc;
-      result = CreateNode<MemberAccess>(
-          loc, std::move(result), std::move(member), MemberAccess::DOTTED);
+      result = CreateNode<MemberAccess>(zone_, loc, result, member,
+                                        MemberAccess::DOTTED);
+      continue;
     }
     break;
   }
   return result;
 }
 
-Expression::Ptr Parser::ParsePrimaryExpression() {
+Expression* Parser::ParsePrimaryExpression() {
   switch (Peek()) {
     case Token::ID:
       return ParseIdentifier();
@@ -434,20 +383,24 @@ Expression::Ptr Parser::ParsePrimaryExpression() {
     case Token::FALSE: {
       auto value = Constant::BooleanHandle(Peek() == Token::TRUE);
       auto result =
-          CreateNode<BooleanLiteral>(scanner_.CurrentLocation(), value);
+          CreateNode<BooleanLiteral>(zone_, scanner_.CurrentLocation(), value);
       Next();
       return result;
     }
     case Token::INT_LITERAL: {
-      auto value = Handle{Int32::Make(atoi(scanner_.CurrentLiteral().data()))};
-      auto result = CreateNode<IntLiteral>(scanner_.CurrentLocation(), value);
+      auto number = static_cast<int32_t>(scanner_.CurrentNumber());
+      auto value = MakeHandle(Int32::Make(number));
+      auto result =
+          CreateNode<IntLiteral>(zone_, scanner_.CurrentLocation(), value);
+      Defer(result, DeferredValue::INT);
       Next();
       return result;
     }
     case Token::DOUBLE_LITERAL: {
-      auto value = Handle{Double::Make(atoi(scanner_.CurrentLiteral().data()))};
+      auto value = MakeHandle(Double::Make(scanner_.CurrentNumber()));
       auto result =
-          CreateNode<DoubleLiteral>(scanner_.CurrentLocation(), value);
+          CreateNode<DoubleLiteral>(zone_, scanner_.CurrentLocation(), value);
+      Defer(result, DeferredValue::DOUBLE);
       Next();
       return result;
     }
@@ -464,7 +417,8 @@ Expression::Ptr Parser::ParsePrimaryExpression() {
       return result;
     }
     case Token::UNDEFINED: {
-      auto result = CreateNode<UndefinedLiteral>(scanner_.CurrentLocation());
+      auto result =
+          CreateNode<UndefinedLiteral>(zone_, scanner_.CurrentLocation());
       Next();
       return result;
     }
@@ -477,13 +431,13 @@ Expression::Ptr Parser::ParsePrimaryExpression() {
   return nullptr;
 }
 
-Expression::Ptr Parser::ParseArrayLiteral() {
+Expression* Parser::ParseArrayLiteral() {
   assert(Look(Token::LBRACKET));
   auto start_loc = scanner_.CurrentLocation();
   Next();
   if (Look(Token::RBRACKET)) {
     auto result =
-        CreateNode<ArrayLiteral>(start_loc + scanner_.CurrentLocation());
+        CreateNode<ArrayLiteral>(zone_, start_loc + scanner_.CurrentLocation());
     Next();
     return result;
   }
@@ -492,38 +446,39 @@ Expression::Ptr Parser::ParseArrayLiteral() {
     elements.push_back(ParseAssignment());
   } while (Accept(Token::COMMA));
   auto array_literal =
-      CreateNode<ArrayLiteral>(start_loc + scanner_.CurrentLocation());
+      CreateNode<ArrayLiteral>(zone_, start_loc + scanner_.CurrentLocation());
   Expect(Token::RBRACKET);
   array_literal->elements = std::move(elements);
   return array_literal;
 }
 
-Expression::Ptr Parser::ParseObjectLiteral() {
+Expression* Parser::ParseObjectLiteral() {
   assert(Look(Token::LC));
   auto start_loc = scanner_.CurrentLocation();
   Next();
   if (Look(Token::RC)) {
-    auto result =
-        CreateNode<ObjectLiteral>(start_loc + scanner_.CurrentLocation());
+    auto result = CreateNode<ObjectLiteral>(
+        zone_, start_loc + scanner_.CurrentLocation());
     Next();
     return result;
   }
   ObjectLiteral::Properties properties;
   do {
-    auto property = CreateNode<PropertyAssignment>(scanner_.CurrentLocation());
+    auto property =
+        CreateNode<PropertyAssignment>(zone_, scanner_.CurrentLocation());
     property->name = ParsePropertyName();
     Expect(Token::COLON);
     property->value = ParseAssignment();
     property->loc += property->value->loc;
-    properties.push_back(std::move(property));
+    properties.push_back(property);
   } while (Accept(Token::COMMA));
   auto result = CreateNode<ObjectLiteral>(
-      start_loc + scanner_.CurrentLocation(), std::move(properties));
+      zone_, start_loc + scanner_.CurrentLocation(), std::move(properties));
   Expect(Token::RC);
   return result;
 }
 
-Node::Ptr Parser::ParsePropertyName() {
+Node* Parser::ParsePropertyName() {
   switch (Peek()) {
     case Token::ID:
       return ParseIdentifierName();
@@ -539,30 +494,80 @@ Node::Ptr Parser::ParsePropertyName() {
   return nullptr;
 }
 
-Expression::Ptr Parser::ParseStringLiteral() {
+Expression* Parser::ParseStringLiteral() {
   assert(Look(Token::STRING_LITERAL));
-  auto literal = Handle{String::New(scanner_.CurrentLiteral().data(), TENURED)};
-  auto str = CreateNode<StringLiteral>(scanner_.CurrentLocation(), literal);
+  auto literal =
+      preparsing_ || deferred_
+          ? Handle<String>{}
+          : Handle{String::New(scanner_.CurrentLiteral(), TENURED)};
+  auto str =
+      CreateNode<StringLiteral>(zone_, scanner_.CurrentLocation(), literal);
+  Defer(str, DeferredValue::STRING);
   Next();
   return str;
 }
 
-Expression::Ptr Parser::ParseIdentifier() {
+Expression* Parser::ParseIdentifier() {
   assert(Look(Token::ID));
-  auto symbol = Handle{String::NewSymbol(scanner_.CurrentLiteral())};
-  auto id = CreateNode<Identifier>(scanner_.CurrentLocation(), symbol);
+  auto symbol = Symbol();
+  auto id = CreateNode<Identifier>(zone_, scanner_.CurrentLocation(), symbol);
+  Defer(id, DeferredValue::IDENTIFIER);
   Next();
   return id;
 }
 
-Node::Ptr Parser::ParseIdentifierName() {
+IdentifierName* Parser::ParseIdentifierName() {
   assert(Look(Token::ID));
-  auto symbol = Handle{String::NewSymbol(scanner_.CurrentLiteral())};
-  auto id_name = CreateNode<IdentifierName>(scanner_.CurrentLocation(), symbol);
+  auto symbol = Symbol();
+  auto id_name =
+      CreateNode<IdentifierName>(zone_, scanner_.CurrentLocation(), symbol);
+  Defer(id_name, DeferredValue::IDENTIFIER_NAME);
   Next();
   return id_name;
 }
 
+inline Handle<String> Parser::Symbol() {
+  if (preparsing_ || deferred_) {
+    return Handle<String>{};
+  }
+  return Handle{String::NewSymbol(scanner_.CurrentLiteral())};
+}
+
+inline void Parser::Defer(Node* node, DeferredValue::Kind kind) {
+  if (deferred_ && !preparsing_) {
+    deferred_->push_back(DeferredValue{node, kind, scanner_.CurrentLiteral(),
+                                       scanner_.CurrentNumber()});
+  }
+}
+
+void DeferredValue::Allocate() {
+  switch (kind) {
+    case FUNCTION_NAME:
+      static_cast<FunctionDecl*>(node)->name =
+          Handle{String::NewSymbol(literal)};
+      return;
+    case IDENTIFIER:
+      static_cast<Identifier*>(node)->name = Handle{String::NewSymbol(literal)};
+      return;
+    case IDENTIFIER_NAME:
+      static_cast<IdentifierName*>(node)->name =
+          Handle{String::NewSymbol(literal)};
+      return;
+    case STRING:
+      static_cast<StringLiteral*>(node)->set_value(
+          Handle{String::New(literal, TENURED)});
+      return;
+    case INT:
+      static_cast<IntLiteral*>(node)->set_value(
+          Handle{Int32::Make(static_cast<int32_t>(number))});
+      return;
+    case DOUBLE:
+      static_cast<DoubleLiteral*>(node)->set_value(
+          Handle{Double::Make(number)});
+      return;
+  }
+}
+
 inline void Parser::Expect(Token::Kind kind) {
   if (Accept(kind)) {
     return;
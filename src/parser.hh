@@ -1,80 +1,105 @@
 #pragma once
 
 #include <string_view>
+#include <vector>
 #include "ast.hh"
+#include "compiler.hh"
 #include "scanner.hh"
 
 namespace kipper {
 namespace internal {
 
-class Parser {
- public:
-  Parser(std::string_view code, const Location& loc);
+/// A name or literal of a script parsed off the main thread, which is left
+/// empty in its node until Allocate() runs on the main thread.
+struct DeferredValue {
+  enum Kind { FUNCTION_NAME, IDENTIFIER, IDENTIFIER_NAME, STRING, INT, DOUBLE };
 
-  Node::Ptr Parse();
+  void Allocate();
 
- private:
-  FunctionDecl::Ptr ParseFunctionDecl();
+  Node* node;
+  Kind kind;
+  std::string_view literal;
+  double number;
+};
 
-  Statement::Ptr ParseStatement();
+class Parser {
+ public:
+  explicit Parser(SourceFile* source) : source_{source} {}
 
-  Statement::Ptr ParseBlockStatement();
+  /// Parses the source. With `deferred`, the heap is left alone and the
+  /// names and literals to allocate are appended to it instead.
+  unique_ptr<TranslationUnit> Parse(
+      std::vector<DeferredValue>* deferred = nullptr);
 
-  Statement::Ptr ParseIfStatement();
+  /// Parses the body of a lazy function of the source.
+  void ParseLazyFunction(FunctionDecl* fn_decl);
+
+ private:
+  FunctionDecl* ParseFunctionDecl();
 
-  Statement::Ptr ParseWhileStatement();
+  void ParseFunctionBody(FunctionDecl* fn_decl);
 
-  Statement::Ptr ParseForStatement();
+  Statement* ParseStatement();
 
-  Statement::Ptr ParseReturnStatement();
+  Statement* ParseBlockStatement();
 
-  Statement::Ptr ParseBreakStatement();
+  Statement* ParseIfStatement();
 
-  Statement::Ptr ParseContinueStatement();
+  Statement* ParseWhileStatement();
 
-  Statement::Ptr ParseExpressionStatement();
+  Statement* ParseForStatement();
 
-  Expression::Ptr ParseExpression();
+  Statement* ParseReturnStatement();
 
-  Expression::Ptr ParseAssignment();
+  Statement* ParseBreakStatement();
 
-  Expression::Ptr ParseConditionalExpression();
+  Statement* ParseContinueStatement();
 
-  Expression::Ptr ParseLogicOrExpression();
+  Statement* ParseExpressionStatement();
 
-  Expression::Ptr ParseLogicAndExpression();
+  Expression* ParseExpression();
 
-  Expression::Ptr ParseEqualityExpression();
+  Expression* ParseAssignment();
 
-  Expression::Ptr ParseRelationalExpression();
+  Expression* ParseConditionalExpression();
 
-  Expression::Ptr ParseAdditiveExpression();
+  /// Parses operators with at least `min_precedence`, see
+  /// Token::GetPrecedence().
+  Expression* ParseBinaryExpression(int min_precedence);
 
-  Expression::Ptr ParseMultiplicativeExpression();
+  Expression* ParseUnaryExpression();
 
-  Expression::Ptr ParseUnaryExpression();
+  Expression* ParsePostfixExpression();
 
-  Expression::Ptr ParsePostfixExpression();
+  Expression* ParseCallExpression();
 
-  Expression::Ptr ParseLeftHandSideExpression();
+  Expression* ParsePrimaryExpression();
 
-  Expression::Ptr ParseCallExpression();
+  Expression* ParseArrayLiteral();
 
-  Expression::Ptr ParseMemberExpression();
+  Expression* ParseObjectLiteral();
 
-  Expression::Ptr ParsePrimaryExpression();
+  Node* ParsePropertyName();
 
-  Expression::Ptr ParseArrayLiteral();
+  Expression* ParseStringLiteral();
 
-  Expression::Ptr ParseObjectLiteral();
+  Expression* ParseIdentifier();
 
-  Node::Ptr ParsePropertyName();
+  IdentifierName* ParseIdentifierName();
 
-  Expression::Ptr ParseStringLiteral();
+  /// The current identifier interned, or an empty handle while pre-parsing
+  /// or deferring.
+  Handle<String> Symbol();
 
-  Expression::Ptr ParseIdentifier();
+  /// A handle to a literal value, or an empty one while pre-parsing or
+  /// deferring.
+  template <class T>
+  Handle<T> MakeHandle(T* value) {
+    return preparsing_ || deferred_ ? Handle<T>{} : Handle<T>{value};
+  }
 
-  Node::Ptr ParseIdentifierName();
+  /// Records that `node` takes the value of the current token, if deferring.
+  void Defer(Node* node, DeferredValue::Kind kind);
 
   Token::Kind Peek() const { return scanner_.Peek(); }
 
@@ -88,11 +113,15 @@ class Parser {
 
   [[nodiscard]] bool Accept(Token::Kind kind);
 
-  std::string_view code_;
-  Location loc_;
+  SourceFile* source_;
+  Zone* zone_{nullptr};
   Scanner scanner_;
   bool is_breakable_scope_{false};
   bool is_fn_scope_{false};
+  // Set while checking the syntax of a lazy function body, whose nodes go
+  // to a scratch zone and whose names and literals are not allocated.
+  bool preparsing_{false};
+  std::vector<DeferredValue>* deferred_{nullptr};
 
   friend class BreakableScopeHandler;
   friend class FunctionScopeHandler;
@@ -0,0 +1,215 @@
+#include "profiler.hh"
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include "ast.hh"
+#include "compiler.hh"
+#include "value.hh"
+#if defined(__unix__) || defined(__APPLE__)
+#include <signal.h>
+#include <sys/time.h>
+#define KIPPER_SIGPROF
+#endif
+
+using namespace kipper::internal;
+
+Profiler::Frame Profiler::stack_[kMaxDepth];
+volatile int Profiler::depth_{0};
+unique_ptr<Profiler::Frame[]> Profiler::frames_;
+unique_ptr<int32_t[]> Profiler::depths_;
+int32_t Profiler::sample_count_{0};
+int32_t Profiler::frame_count_{0};
+bool Profiler::running_{false};
+
+#if defined(KIPPER_SIGPROF)
+static struct sigaction previous_action;
+#endif
+
+// Runs in the signal handler, so it must neither allocate nor lock.
+void Profiler::Sample(int) {
+  auto depth = std::min(static_cast<int>(depth_), kMaxDepth);
+  if (depth == 0 || sample_count_ == kMaxSamples ||
+      frame_count_ + depth > kMaxSampledFrames) {
+    return;
+  }
+  std::copy(stack_, stack_ + depth, frames_.get() + frame_count_);
+  frame_count_ += depth;
+  depths_[sample_count_++] = depth;
+}
+
+bool Profiler::Start(int32_t interval_us) {
+#if defined(KIPPER_SIGPROF)
+  if (running_) {
+    return false;
+  }
+  frames_.reset(new Frame[kMaxSampledFrames]);
+  depths_.reset(new int32_t[kMaxSamples]);
+  sample_count_ = 0;
+  frame_count_ = 0;
+
+  struct sigaction action {};
+  action.sa_handler = &Sample;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, &previous_action) != 0) {
+    return false;
+  }
+  itimerval timer{};
+  timer.it_interval.tv_sec = interval_us / 1000000;
+  timer.it_interval.tv_usec = interval_us % 1000000;
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+    sigaction(SIGPROF, &previous_action, nullptr);
+    return false;
+  }
+  running_ = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void Profiler::BlockSamplingOnThisThread() {
+#if defined(KIPPER_SIGPROF)
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGPROF);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+#endif
+}
+
+static std::string FrameName(Node* node, const SourceRange* location) {
+  std::string name;
+  if (auto fn = node->AsFunctionDecl()) {
+    name = fn->name ? fn->name->ToStdString() : "(anonymous)";
+  } else {
+    name = "(script)";
+  }
+  auto position = Compiler::Resolve(location ? *location : node->loc).begin;
+  std::stringstream frame;
+  frame << name << " (" << position.filename << ':' << position.line << ')';
+  return frame.str();
+}
+
+std::string Profiler::Stop() {
+#if defined(KIPPER_SIGPROF)
+  if (!running_) {
+    return std::string{};
+  }
+  itimerval timer{};
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  sigaction(SIGPROF, &previous_action, nullptr);
+  running_ = false;
+
+  std::map<std::string, int32_t> stacks;
+  for (int32_t sample = 0, frame = 0; sample < sample_count_; sample++) {
+    std::string stack;
+    for (auto end = frame + depths_[sample]; frame < end; frame++) {
+      if (!stack.empty()) {
+        stack += ';';
+      }
+      stack += FrameName(frames_[frame].node, frames_[frame].location);
+    }
+    stacks[stack]++;
+  }
+  frames_.reset();
+  depths_.reset();
+
+  std::stringstream collapsed;
+  for (auto& [stack, count] : stacks) {
+    collapsed << stack << ' ' << count << '\n';
+  }
+  return collapsed.str();
+#else
+  return std::string{};
+#endif
+}
+
+bool NodeCounters::enabled_{false};
+NodeCounters::Scope* NodeCounters::current_{nullptr};
+std::vector<Node*> NodeCounters::nodes_;
+
+#if defined(KIPPER_NODE_COUNTERS)
+void NodeCounters::Scope::Enter() {
+  if (node_->hits++ == 0) {
+    nodes_.push_back(node_);
+  }
+  parent_ = current_;
+  current_ = this;
+  children_ = 0;
+  start_ = ReadTicks();
+}
+
+void NodeCounters::Scope::Exit() {
+  auto elapsed = ReadTicks() - start_;
+  node_->ticks += elapsed - std::min(children_, elapsed);
+  current_ = parent_;
+  if (parent_) {
+    parent_->children_ += elapsed;
+  }
+}
+#endif
+
+bool NodeCounters::Start() {
+#if defined(KIPPER_NODE_COUNTERS)
+  enabled_ = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
+#if defined(KIPPER_NODE_COUNTERS)
+// The first line of the node's source, shortened to fit a report line.
+static std::string Excerpt(const SourceRange& loc) {
+  constexpr size_t kMaxExcerpt = 48;
+  auto source = Compiler::GetLocationSourceCode(loc);
+  source = source.substr(0, source.find('\n'));
+  if (source.size() <= kMaxExcerpt) {
+    return std::string{source};
+  }
+  return std::string{source.substr(0, kMaxExcerpt - 3)} + "...";
+}
+#endif
+
+std::string NodeCounters::Stop(int32_t top) {
+#if defined(KIPPER_NODE_COUNTERS)
+  if (!enabled_) {
+    return std::string{};
+  }
+  enabled_ = false;
+  uint64_t total = 0;
+  for (auto node : nodes_) {
+    total += node->ticks;
+  }
+  auto count = std::min(nodes_.size(), static_cast<size_t>(std::max(top, 0)));
+  std::partial_sort(nodes_.begin(), nodes_.begin() + count, nodes_.end(),
+                    [](Node* a, Node* b) {
+                      return a->ticks != b->ticks ? a->ticks > b->ticks
+                                                  : a->hits > b->hits;
+                    });
+
+  std::stringstream report;
+  report << std::setw(7) << "self%" << std::setw(12) << "hits"
+         << std::setw(16) << "self ticks" << "  location: source\n";
+  for (size_t i = 0; i < count; i++) {
+    auto node = nodes_[i];
+    auto begin = Compiler::Resolve(node->loc).begin;
+    report << std::fixed << std::setprecision(1) << std::setw(6)
+           << (total ? 100.0 * node->ticks / total : 0.0) << '%'
+           << std::setw(12) << node->hits << std::setw(16) << node->ticks
+           << "  " << begin.filename << ':' << begin.line << ':'
+           << begin.column << ": " << Excerpt(node->loc) << '\n';
+  }
+  for (auto node : nodes_) {
+    node->hits = 0;
+    node->ticks = 0;
+  }
+  nodes_.clear();
+  return report.str();
+#else
+  static_cast<void>(top);
+  return std::string{};
+#endif
+}
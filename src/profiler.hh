@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "kipper.hh"
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace kipper {
+namespace internal {
+
+struct Node;
+
+/// Sampling CPU profiler.
+///
+/// Running scripts and functions keep a shadow stack of their AST nodes,
+/// each with the location of the call it is making. While profiling, a
+/// SIGPROF timer copies that stack into a preallocated sample buffer, and
+/// Stop() folds the samples into collapsed stacks as read by flamegraph.pl.
+class Profiler : public AllStatic {
+ public:
+  /// Marks a TranslationUnit or FunctionDecl as running for its lifetime.
+  class Scope {
+   public:
+    explicit Scope(Node* node) {
+      if (depth_ < kMaxDepth) {
+        stack_[depth_] = {node, nullptr};
+      }
+      std::atomic_signal_fence(std::memory_order_release);
+      depth_++;
+    }
+
+    ~Scope() {
+      depth_--;
+      std::atomic_signal_fence(std::memory_order_release);
+      SetLocation(nullptr);
+    }
+
+    DISABLE_DEFAULT_OP(Scope)
+  };
+
+  /// Records the location of the call the innermost function makes.
+  static void SetLocation(const SourceRange* location) {
+    if (depth_ > 0 && depth_ <= kMaxDepth) {
+      stack_[depth_ - 1].location = location;
+    }
+  }
+
+  /// Samples every `interval_us` microseconds of CPU time. Returns false if
+  /// the profiler is running already or the platform has no SIGPROF.
+  static bool Start(int32_t interval_us);
+
+  /// Stops sampling and returns the samples as collapsed stacks, one
+  /// "outer;...;inner count" line per distinct stack.
+  static std::string Stop();
+
+  /// Keeps SIGPROF off the calling thread. The sampled stack belongs to the
+  /// thread running scripts, so other threads the engine starts call this
+  /// first; the timer then always interrupts the thread it samples.
+  static void BlockSamplingOnThisThread();
+
+  static constexpr int kMaxDepth = 256;
+  static constexpr int kMaxSamples = 64 * KB;
+  static constexpr int kMaxSampledFrames = 1 * MB;
+
+ private:
+  struct Frame {
+    Node* node;
+    const SourceRange* location;
+  };
+
+  static void Sample(int signal);
+
+  static Frame stack_[kMaxDepth];
+  static volatile int depth_;
+  static unique_ptr<Frame[]> frames_;
+  static unique_ptr<int32_t[]> depths_;
+  static int32_t sample_count_;
+  static int32_t frame_count_;
+  static bool running_;
+};
+
+/// Per-node execution counters for the AST walker.
+///
+/// While counting, scripts and functions are walked rather than run as
+/// bytecode, and every node executed bumps its hit count and adds the ticks
+/// (TSC cycles on x86, nanoseconds elsewhere) spent in it but not in its
+/// children. Stop() lists the hottest nodes with their source code. Builds
+/// without KIPPER_NODE_COUNTERS compile the counting out of the walker and
+/// the counters out of the nodes.
+class NodeCounters : public AllStatic {
+ public:
+  /// Counts `node` for its lifetime; does nothing unless counting.
+  class Scope {
+   public:
+    explicit Scope(Node* node) : node_{enabled_ ? node : nullptr} {
+      if (node_) {
+        Enter();
+      }
+    }
+
+    ~Scope() {
+      if (node_) {
+        Exit();
+      }
+    }
+
+    DISABLE_DEFAULT_OP(Scope)
+
+   private:
+    void Enter();
+    void Exit();
+
+    Node* node_;
+    Scope* parent_;
+    uint64_t start_;
+    uint64_t children_;
+  };
+
+  static bool enabled() { return enabled_; }
+
+  /// Starts counting. Returns false in builds without KIPPER_NODE_COUNTERS.
+  static bool Start();
+
+  /// Stops counting, returns the `top` nodes with the most self ticks, one
+  /// per line, and clears the counters. Call it before the counted scripts
+  /// are freed.
+  static std::string Stop(int32_t top);
+
+  static uint64_t ReadTicks() {
+#if defined(_MSC_VER) && defined(_M_X64) || defined(__x86_64__) || \
+    defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+ private:
+  static bool enabled_;
+  static Scope* current_;
+  static std::vector<Node*> nodes_;
+};
+
+}  // namespace internal
+}  // namespace kipper
+
+#if defined(KIPPER_NODE_COUNTERS)
+#define COUNT_NODE(node) \
+  kipper::internal::NodeCounters::Scope node_counter{node}
+#else
+#define COUNT_NODE(node) static_cast<void>(node)
+#endif
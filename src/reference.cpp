@@ -7,7 +7,7 @@ using namespace kipper::internal;
 Reference::Reference(Expression* expr, Execution& exec)
     : expr_{expr}, exec_{exec} {
   if (expr->AsIdentifier()) {
-    base_ = exec.context()->Resolve(expr->AsIdentifier()->name.Get());
+    base_ = expr->AsIdentifier()->Lookup(exec);
     type_ = NAMED;
   } else if (auto member_access = expr->AsMemberAccess()) {
     base_ = member_access->target->Evaluate(exec);
@@ -25,6 +25,14 @@ Reference::Reference(MemberAccess* member_access, Execution& exec)
       key_{member_access->member->Evaluate(exec)},
       type_{member_access->type == MemberAccess::KEYED ? KEYED : DOTTED} {}
 
+Reference::Reference(MemberAccess* member_access, Execution& exec,
+                     Handle<Object> base, Handle<Object> key)
+    : expr_{member_access},
+      exec_{exec},
+      base_{base},
+      key_{key},
+      type_{member_access->type == MemberAccess::KEYED ? KEYED : DOTTED} {}
+
 Handle<Object> Reference::SetValue(Handle<Object> value) {
   assert(type_ != ILLEGAL);
   switch (type_) {
@@ -38,16 +46,17 @@ Handle<Object> Reference::SetValue(Handle<Object> value) {
     case KEYED:
       if (base_->IsKSArray()) {
         auto index = key_->ToInt32();
-        return Handle{Handle<KSArray>::Cast(base_)->Set(index, value.Get())};
+        return Handle{
+            KSArray::Set(Handle<KSArray>::Cast(base_), index, value)};
       }
       if (base_->IsKSObject()) {
-        KSObject::SetProperty(Handle<KSObject>::Cast(base_), key_, value);
+        StoreProperty(value);
         return value;
       }
       break;
     case DOTTED:
       if (base_->IsKSObject()) {
-        KSObject::SetProperty(Handle<KSObject>::Cast(base_), key_, value);
+        StoreProperty(value);
         return value;
       }
       break;
@@ -67,16 +76,45 @@ Handle<Object> Reference::GetValue() const {
         return Handle{Handle<KSArray>::Cast(base_)->Get(key_->ToInt32())};
       }
       if (base_->IsKSObject()) {
-        return Handle{Handle<KSObject>::Cast(base_)->GetProperty(key_.Get())};
+        return Handle{LoadProperty()};
       }
       break;
     case DOTTED:
       if (base_->IsKSObject()) {
-        return Handle{Handle<KSObject>::Cast(base_)->GetProperty(key_.Get())};
+        return Handle{LoadProperty()};
       }
       break;
     case ILLEGAL:
       break;
   }
   throw KSReferenceError{expr_->loc, "reference error"};
-}
\ No newline at end of file
+}
+Object* Reference::LoadProperty() const {
+  auto receiver = KSObject::Cast(base_.Get());
+  if (!PropertyCache::IsCacheable(receiver, key_.Get())) {
+    return receiver->GetProperty(key_.Get());
+  }
+  auto& cache = expr_->AsMemberAccess()->cache;
+  auto key = String::Cast(key_.Get());
+  if (auto result = cache.Load(receiver, key)) {
+    return result;
+  }
+  auto result = receiver->GetProperty(key);
+  cache.Update(receiver, key, result);
+  return result;
+}
+
+void Reference::StoreProperty(Handle<Object> value) {
+  if (!PropertyCache::IsCacheable(base_.Get(), key_.Get())) {
+    KSObject::SetProperty(Handle<KSObject>::Cast(base_), key_, value);
+    return;
+  }
+  auto& cache = expr_->AsMemberAccess()->cache;
+  if (cache.Store(KSObject::Cast(base_.Get()), String::Cast(key_.Get()),
+                  value.Get())) {
+    return;
+  }
+  KSObject::SetProperty(Handle<KSObject>::Cast(base_), key_, value);
+  cache.Update(KSObject::Cast(base_.Get()), String::Cast(key_.Get()),
+               value.Get());
+}
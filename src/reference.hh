@@ -14,6 +14,9 @@ class Reference {
 
   Reference(MemberAccess* member_access, Execution& exec);
 
+  Reference(MemberAccess* member_access, Execution& exec, Handle<Object> base,
+            Handle<Object> key);
+
   Handle<Object> SetValue(Handle<Object> value);
 
   Handle<Object> GetValue() const;
@@ -23,6 +26,10 @@ class Reference {
   bool IsPropertyReference() const { return type_ == KEYED || type_ == DOTTED; }
 
  private:
+  Object* LoadProperty() const;
+
+  void StoreProperty(Handle<Object> value);
+
   Expression* expr_;
   Execution& exec_;
   Handle<Object> base_;
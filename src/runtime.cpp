@@ -2,6 +2,7 @@
 #include <iostream>
 #include "context.hh"
 #include "heap.hh"
+#include "snapshot.hh"
 #include "value.hh"
 
 using namespace kipper::internal;
@@ -10,7 +11,36 @@ bool Runtime::installed_{false};
 
 void Runtime::InstallNative() {
   InstallNativeProperties();
-  InstallNativeFunctions();
+  // A snapshot brings the native functions along with the other globals.
+  if (!Snapshot::deserialized()) {
+    InstallNativeFunctions();
+  }
+}
+
+const std::vector<Function::FunctionTemplate>& Runtime::Natives() {
+  static const std::vector<Function::FunctionTemplate> natives{&ArrayPush,
+                                                               &Print};
+  return natives;
+}
+
+Handle<Object> Runtime::ArrayPush(Handle<KSArray> args, Context* context) {
+  if (context->self()) {
+    auto arg = Handle{args->Get(0)};
+    KSArray::Push(Handle<KSArray>::Cast(context->self()), arg);
+    return Constant::UndefinedHandle();
+  }
+  return Handle<Object>{};
+}
+
+Handle<Object> Runtime::Print(Handle<KSArray> args, Context* /*context*/) {
+  for (auto i = 0, len = args->Length(); i < len; i++) {
+    std::cout << args->Get(i)->ToString()->Value();
+    if (i < len - 1) {
+      std::cout << ", ";
+    }
+  }
+  std::cout << "\n";
+  return Constant::UndefinedHandle();
 }
 
 void Runtime::InstallNativeProperties() {
@@ -18,16 +48,8 @@ void Runtime::InstallNativeProperties() {
     return;
   }
   installed_ = true;
-  static auto array_push_fn = Handle{Function::New(
-      String::NewSymbol("push"), Array::New(0),
-      [](Handle<KSArray> args, Context* context) -> Handle<Object> {
-        if (context->self()) {
-          auto arg = Handle{args->Get(0)};
-          KSArray::Push(Handle<KSArray>::Cast(context->self()), arg);
-          return Constant::UndefinedHandle();
-        }
-        return Handle<Object>{};
-      })};
+  static auto array_push_fn = Handle{
+      Function::New(String::NewSymbol("push"), Array::New(0), &ArrayPush)};
 
   KSObject::AddGetPropertyInterceptor(
       [](KSObject* obj, String* key) -> Handle<Object> {
@@ -48,20 +70,7 @@ void Runtime::InstallNativeProperties() {
 }
 
 void Runtime::InstallNativeFunctions() {
-  {
-    auto fn_name = String::NewSymbol("Print");
-    auto print_fn = Function::New(
-        fn_name, Array::New(0),
-        [](Handle<KSArray> args, Context * /*context*/) -> Handle<Object> {
-          for (auto i = 0, len = args->Length(); i < len; i++) {
-            std::cout << args->Get(i)->ToString()->Value();
-            if (i < len - 1) {
-              std::cout << ", ";
-            }
-          }
-          std::cout << "\n";
-          return Constant::UndefinedHandle();
-        });
-    Heap::GlobalContext()->Push(fn_name, print_fn);
-  }
-}
\ No newline at end of file
+  auto fn_name = String::NewSymbol("Print");
+  auto print_fn = Function::New(fn_name, Array::New(0), &Print);
+  Heap::GlobalContext()->Push(fn_name, print_fn);
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <vector>
 #include "kipper.hh"
+#include "value.hh"
 
 namespace kipper {
 namespace internal {
@@ -9,7 +11,14 @@ class Runtime : public AllStatic {
  public:
   static void InstallNative();
 
+  /// The native functions installed, which snapshots refer to by index.
+  static const std::vector<Function::FunctionTemplate>& Natives();
+
  private:
+  static Handle<Object> ArrayPush(Handle<KSArray> args, Context* context);
+
+  static Handle<Object> Print(Handle<KSArray> args, Context* context);
+
   static void InstallNativeProperties();
 
   static void InstallNativeFunctions();
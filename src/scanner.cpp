@@ -1,39 +1,96 @@
 #include "scanner.hh"
-#include <iostream>
+#include <charconv>
+#include <cstdlib>
+#include <limits>
 #include "compiler.hh"
 #include "kipper.hh"
 #include "message.hh"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace kipper::internal;
 
 template <typename... Args>
-static void ReportError(const Location& loc, const char* format, Args... args);
+static void ReportError(const SourceRange& loc, const char* format,
+                        Args... args);
 
-namespace kipper::internal {
-class LiteralBufferHandler {
- public:
-  explicit LiteralBufferHandler(Scanner* scanner) : scanner_{scanner} {
-    scanner_->literal_buf_offset_ = scanner_->literal_buf_.size();
-  }
+static bool IsWhiteSpace(CodeChar ch) { return ch == ' ' || ch == '\t'; }
 
-  ~LiteralBufferHandler() { scanner_->literal_buf_.push_back('\0'); }
+static bool IsIdStart(CodeChar ch) {
+  return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '$' ||
+         ch == '_';
+}
 
-  void AddChar(CodeChar ch) { scanner_->literal_buf_.push_back(ch); }
+static bool IsDigit(CodeChar ch) { return ch >= '0' && ch <= '9'; }
 
-  std::string_view CurrentLiteral() {
-    return &scanner_->literal_buf_[scanner_->literal_buf_offset_];
-  }
+static bool IsIdPart(CodeChar ch) { return IsIdStart(ch) || IsDigit(ch); }
+
+static bool IsHexDigit(CodeChar ch) {
+  return IsDigit(ch) || ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'f');
+}
+
+#if defined(__SSE2__)
+// The same classes for 16 characters at once, as a mask of whole bytes.
+
+static __m128i InRange(__m128i chars, char lo, char hi) {
+  // Bytes beyond ASCII compare as negative, so they are never in range.
+  return _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8(lo - 1)),
+                       _mm_cmplt_epi8(chars, _mm_set1_epi8(hi + 1)));
+}
+
+static __m128i IsWhiteSpace(__m128i chars) {
+  return _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')),
+                      _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t')));
+}
 
-  DISABLE_DEFAULT_OP(LiteralBufferHandler)
+static __m128i IsDigit(__m128i chars) { return InRange(chars, '0', '9'); }
 
- private:
-  Scanner* scanner_;
-};
-}  // namespace kipper::internal
+static __m128i IsIdPart(__m128i chars) {
+  auto lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+  auto letter_or_digit =
+      _mm_or_si128(InRange(lower, 'a', 'z'), InRange(chars, '0', '9'));
+  auto sign = _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('$')),
+                           _mm_cmpeq_epi8(chars, _mm_set1_epi8('_')));
+  return _mm_or_si128(letter_or_digit, sign);
+}
+#endif
 
-void Scanner::Initialize(std::string_view code, const Location& loc) {
-  code_ = code.data();
-  loc_ = loc;
+// Skips the run of characters from `code` on that `is_member` holds for,
+// 16 at a time where they are all before `end`.
+template <typename CharClass>
+static const CodeChar* SkipRun(const CodeChar* code, const CodeChar* end,
+                               CharClass is_member) {
+#if defined(__SSE2__)
+  for (; end - code >= 16; code += 16) {
+    auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code));
+    auto others = ~_mm_movemask_epi8(is_member(chars)) & 0xffff;
+    if (others) {
+      return code + __builtin_ctz(others);
+    }
+  }
+#endif
+  while (is_member(*code)) {
+    code++;
+  }
+  return code;
+}
+
+void Scanner::Initialize(SourceFile* source) {
+  source_ = source;
+  code_ = source->code.data();
+  end_ = code_ + source->code.size();
+  token_buf_.current = Token::UNKNOWN;
+  NextToken();
+}
+
+void Scanner::Initialize(SourceFile* source, uint32_t offset) {
+  assert(offset <= source->code.size());
+  source_ = source;
+  code_ = source->code.data() + offset;
+  end_ = source->code.data() + source->code.size();
+  records_lines_ = false;
   token_buf_.current = Token::UNKNOWN;
   NextToken();
 }
@@ -41,13 +98,14 @@ void Scanner::Initialize(std::string_view code, const Location& loc) {
 void kipper::internal::Scanner::NextToken() {
   assert(token_buf_.current != Token::END);
   token_buf_.current = Scan();
-  token_buf_.current_loc = loc_;
-  token_buf_.literal_offset = literal_buf_offset_;
+  token_buf_.current_loc = TokenRange();
+  token_buf_.literal = literal_;
+  token_buf_.number = number_;
 }
 
 Token::Kind Scanner::Scan() {
   SkipWhitespace();
-  loc_.step();
+  token_start_ = code_;
   switch (CurrentChar()) {
     case '(':
       NextChar();
@@ -158,61 +216,98 @@ Token::Kind Scanner::Scan() {
       }
       break;
   }
-  ReportError(loc_, "unexpected character: {}", CodeChar());
+  ReportError(TokenRange(), "unexpected character: {}", CurrentChar());
   UNREACHABLE();
   return Token::UNKNOWN;
 }
 
+// Integers that do not fit an int32_t become DOUBLE_LITERALs.
 Token::Kind Scanner::ScanDigitLiteral() {
   assert(IsDigit(CurrentChar()));
-  LiteralBufferHandler buf_handler{this};
-  buf_handler.AddChar(CurrentChar());
-  NextChar();
-  while (IsDigit(CurrentChar())) {
-    buf_handler.AddChar(CurrentChar());
-    NextChar();
+  if (CurrentChar() == '0' && (code_[1] | 0x20) == 'x') {
+    return ScanHexLiteral();
   }
+  auto is_digit = [](auto chars) { return IsDigit(chars); };
+  auto is_integer = true;
+  code_ = SkipRun(code_ + 1, end_, is_digit);
   if (Consume('.')) {
-    buf_handler.AddChar('.');
-    while (IsDigit(CurrentChar())) {
-      buf_handler.AddChar(CurrentChar());
+    code_ = SkipRun(code_, end_, is_digit);
+    is_integer = false;
+  }
+  if ((CurrentChar() | 0x20) == 'e') {
+    NextChar();
+    if (CurrentChar() == '+' || CurrentChar() == '-') {
       NextChar();
     }
-    return Token::DOUBLE_LITERAL;
+    if (!IsDigit(CurrentChar())) {
+      ReportError(TokenRange(), "missing exponent in number literal");
+    }
+    code_ = SkipRun(code_, end_, is_digit);
+    is_integer = false;
+  }
+  literal_ = std::string_view(token_start_, code_ - token_start_);
+  if (is_integer) {
+    int32_t value;
+    if (std::from_chars(token_start_, code_, value).ec == std::errc()) {
+      number_ = value;
+      return Token::INT_LITERAL;
+    }
+  }
+  if (std::from_chars(token_start_, code_, number_).ec != std::errc()) {
+    // Out of range: strtod() rounds to infinity or zero.
+    number_ = std::strtod(token_start_, nullptr);
+  }
+  return Token::DOUBLE_LITERAL;
+}
+
+Token::Kind Scanner::ScanHexLiteral() {
+  code_ += 2;
+  auto digits = code_;
+  while (IsHexDigit(CurrentChar())) {
+    NextChar();
+  }
+  if (code_ == digits) {
+    ReportError(TokenRange(), "missing digits in hex literal");
+  }
+  literal_ = std::string_view(token_start_, code_ - token_start_);
+  uint64_t value;
+  if (std::from_chars(digits, code_, value, 16).ec == std::errc()) {
+    number_ = static_cast<double>(value);
+  } else {
+    number_ = 0;
+    for (auto digit = digits; digit < code_; digit++) {
+      number_ = number_ * 16 + (IsDigit(*digit) ? *digit - '0'
+                                                : (*digit | 0x20) - 'a' + 10);
+    }
+  }
+  if (number_ <= std::numeric_limits<int32_t>::max()) {
+    return Token::INT_LITERAL;
   }
-  return Token::INT_LITERAL;
+  return Token::DOUBLE_LITERAL;
 }
 
 void Scanner::ScanStringLiteral() {
   assert(CurrentChar() == '"');
-  LiteralBufferHandler buf_handler{this};
   NextChar();
-  static constexpr const auto is_str_part = [](CodeChar ch) -> bool {
-    return ch != '"' && ch != '\0';
-  };
-  while (is_str_part(CurrentChar())) {
-    buf_handler.AddChar(CurrentChar());
+  auto start = code_;
+  while (CurrentChar() != '"' && CurrentChar() != '\0') {
     NextChar();
+    if (code_[-1] == '\n') {
+      StartLine();
+    }
   }
+  literal_ = std::string_view(start, code_ - start);
   if (Consume('"')) {
     return;
   }
-  ReportError(loc_, "expect character `\"`, but got `{}`", CodeChar());
+  ReportError(TokenRange(), "expect character `\"`, but got end of input");
 }
 
 Token::Kind Scanner::ScanIdentifier() {
   assert(IsIdStart(CurrentChar()));
-  LiteralBufferHandler buf_handler{this};
-  buf_handler.AddChar(CurrentChar());
-  NextChar();
-  static constexpr const auto is_id_part = [](CodeChar ch) -> bool {
-    return IsIdStart(ch) || IsDigit(ch);
-  };
-  while (is_id_part(CurrentChar())) {
-    buf_handler.AddChar(CurrentChar());
-    NextChar();
-  }
-  if (auto keyword = Token::FindKeyword(buf_handler.CurrentLiteral())) {
+  code_ = SkipRun(code_ + 1, end_, [](auto chars) { return IsIdPart(chars); });
+  literal_ = std::string_view(token_start_, code_ - token_start_);
+  if (auto keyword = Token::FindKeyword(literal_)) {
     return *keyword;
   }
   return Token::ID;
@@ -221,11 +316,10 @@ Token::Kind Scanner::ScanIdentifier() {
 inline void Scanner::SkipWhitespace() {
   has_line_terminator_ = false;
   do {
-    while (IsWhiteSpace(CurrentChar())) {
-      NextChar();
-    }
+    code_ = SkipRun(code_, end_,
+                    [](auto chars) { return IsWhiteSpace(chars); });
     if (Consume('#')) {
-      while (!AcceptLineTerminator()) {
+      while (!AcceptLineTerminator() && CurrentChar() != '\0') {
         NextChar();
       }
       continue;
@@ -237,12 +331,7 @@ inline void Scanner::SkipWhitespace() {
   } while (true);
 }
 
-inline void Scanner::NextChar() {
-  if (!has_line_terminator_) {
-    loc_.columns();
-  }
-  code_++;
-}
+inline void Scanner::NextChar() { code_++; }
 
 inline bool Scanner::Consume(CodeChar ch) {
   if (CurrentChar() == ch) {
@@ -256,33 +345,38 @@ bool Scanner::AcceptLineTerminator() {
   switch (CurrentChar()) {
     case '\r':
       has_line_terminator_ = true;
-      loc_.lines();
       NextChar();
       if (CurrentChar() == '\n') {
         NextChar();
       }
+      StartLine();
       return true;
     case '\n':
       has_line_terminator_ = true;
-      loc_.lines();
       NextChar();
+      StartLine();
       return true;
   }
   return false;
 }
 
-inline bool Scanner::IsWhiteSpace(CodeChar ch) {
-  return ch == ' ' || ch == '\t';
+inline void Scanner::StartLine() {
+  if (!records_lines_) {
+    return;
+  }
+  source_->line_starts.push_back(
+      static_cast<uint32_t>(code_ - source_->code.data()));
 }
 
-inline bool Scanner::IsIdStart(CodeChar ch) {
-  return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '$' ||
-         ch == '_';
+SourceRange Scanner::TokenRange() const {
+  auto start = source_->code.data();
+  auto begin = static_cast<uint32_t>(token_start_ - start);
+  auto end = static_cast<uint32_t>(code_ - start);
+  return SourceRange{source_->base + begin, source_->base + end};
 }
 
-inline bool Scanner::IsDigit(CodeChar ch) { return ch >= '0' && ch <= '9'; }
-
 template <typename... Args>
-static void ReportError(const Location& loc, const char* format, Args... args) {
+static void ReportError(const SourceRange& loc, const char* format,
+                        Args... args) {
   throw KSSyntaxError{loc, Message::Format(format, args...)};
 }
\ No newline at end of file
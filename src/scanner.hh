@@ -1,41 +1,55 @@
 #pragma once
 
-#include <string>
+#include <string_view>
 #include "location.hh"
 #include "token.hh"
 
 namespace kipper {
 namespace internal {
 
+struct SourceFile;
+
 using CodeChar = char;
 
 class Scanner {
  public:
-  void Initialize(std::string_view code, const Location& loc);
+  /// Scans `source`, recording its line starts as it goes.
+  void Initialize(SourceFile* source);
+
+  /// Scans `source` from `offset` on, where a previous scan already recorded
+  /// the line starts.
+  void Initialize(SourceFile* source, uint32_t offset);
 
   void NextToken();
 
   Token::Kind Peek() const { return token_buf_.current; }
 
-  std::string_view CurrentLiteral() {
-    return &literal_buf_[token_buf_.literal_offset];
-  }
+  /// The source code of the current identifier or number, or the content of
+  /// the current string literal.
+  std::string_view CurrentLiteral() const { return token_buf_.literal; }
 
-  const Location& CurrentLocation() const { return token_buf_.current_loc; }
+  /// The value of the current number literal. It fits an int32_t if the
+  /// literal is an INT_LITERAL.
+  double CurrentNumber() const { return token_buf_.number; }
+
+  const SourceRange& CurrentLocation() const { return token_buf_.current_loc; }
 
   bool has_line_terminator() const { return has_line_terminator_; }
 
  private:
   struct TokenBuffer {
     Token::Kind current;
-    Location current_loc;
-    size_t literal_offset;
+    SourceRange current_loc;
+    std::string_view literal;
+    double number;
   };
 
   Token::Kind Scan();
 
   Token::Kind ScanDigitLiteral();
 
+  Token::Kind ScanHexLiteral();
+
   void ScanStringLiteral();
 
   Token::Kind ScanIdentifier();
@@ -48,22 +62,24 @@ class Scanner {
 
   bool AcceptLineTerminator();
 
-  CodeChar CurrentChar() { return *code_; }
-
-  static bool IsWhiteSpace(CodeChar ch);
+  /// Records that a line starts at the current character.
+  void StartLine();
 
-  static bool IsIdStart(CodeChar ch);
+  /// The range from the start of the current token to the current character.
+  SourceRange TokenRange() const;
 
-  static bool IsDigit(CodeChar ch);
+  CodeChar CurrentChar() { return *code_; }
 
   const CodeChar* code_;
-  Location loc_;
+  /// The end of the code, where a '\0' follows.
+  const CodeChar* end_;
+  const CodeChar* token_start_;
+  SourceFile* source_;
   TokenBuffer token_buf_;
-  std::string literal_buf_;
-  size_t literal_buf_offset_{0};
+  std::string_view literal_;
+  double number_{0};
   bool has_line_terminator_{false};
-
-  friend class LiteralBufferHandler;
+  bool records_lines_{true};
 };
 
 }  // namespace internal
@@ -0,0 +1,149 @@
+#include "scope_analyzer.hh"
+#include <algorithm>
+#include "heap.hh"
+#include "value.hh"
+
+using namespace kipper::internal;
+
+void ScopeAnalyzer::Analyze(Node* ast) {
+  ScopeAnalyzer analyzer;
+  analyzer.Visit(ast);
+}
+
+void ScopeAnalyzer::VisitTranslationUnit(TranslationUnit* unit) {
+  for (auto& fn_decl : unit->fn_decls) {
+    Visit(fn_decl);
+  }
+  for (auto& stmt : unit->stmts) {
+    Visit(stmt);
+  }
+}
+
+void ScopeAnalyzer::VisitBlockStatement(BlockStatement* block) {
+  block_depth_++;
+  for (auto& stmt : block->stmts) {
+    Visit(stmt);
+  }
+  block_depth_--;
+}
+
+void ScopeAnalyzer::VisitIfStatement(IfStatement* if_stmt) {
+  Visit(if_stmt->condition);
+  Visit(if_stmt->then_stmt);
+  Visit(if_stmt->else_stmt);
+}
+
+void ScopeAnalyzer::VisitWhileStatement(WhileStatement* while_stmt) {
+  Visit(while_stmt->condition);
+  Visit(while_stmt->loop_stmt);
+}
+
+void ScopeAnalyzer::VisitForStatement(ForStatement* for_stmt) {
+  Visit(for_stmt->init);
+  Visit(for_stmt->condition);
+  Visit(for_stmt->update);
+  Visit(for_stmt->loop_stmt);
+}
+
+void ScopeAnalyzer::VisitReturnStatement(ReturnStatement* return_stmt) {
+  Visit(return_stmt->value);
+}
+
+void ScopeAnalyzer::VisitBreakStatement(BreakStatement* /* stmt */) {}
+
+void ScopeAnalyzer::VisitContinueStatement(ContinueStatement* /* stmt */) {}
+
+void ScopeAnalyzer::VisitExpressionStatement(ExpressionStatement* stmt) {
+  Visit(stmt->expr);
+}
+
+void ScopeAnalyzer::VisitAssignment(Assignment* assignment) {
+  Visit(assignment->target);
+  Visit(assignment->value);
+}
+
+void ScopeAnalyzer::VisitConditionalExpression(ConditionalExpression* expr) {
+  Visit(expr->condition);
+  Visit(expr->then_expr);
+  Visit(expr->else_expr);
+}
+
+void ScopeAnalyzer::VisitBinaryExpression(BinaryExpression* expr) {
+  Visit(expr->left);
+  Visit(expr->right);
+}
+
+void ScopeAnalyzer::VisitUnaryExpression(UnaryExpression* expr) {
+  Visit(expr->target);
+}
+
+void ScopeAnalyzer::VisitPostfixExpression(PostfixExpression* expr) {
+  Visit(expr->target);
+}
+
+void ScopeAnalyzer::VisitMemberAccess(MemberAccess* member_access) {
+  Visit(member_access->target);
+  Visit(member_access->member);
+}
+
+void ScopeAnalyzer::VisitIdentifier(Identifier* identifier) {
+  auto it = std::find(locals_.begin(), locals_.end(), identifier->name.Get());
+  if (it != locals_.end()) {
+    identifier->depth = block_depth_;
+    identifier->slot = static_cast<int>(it - locals_.begin());
+    if (*it == Heap::arguments_symbol()) {
+      function_->uses_arguments = true;
+    }
+  }
+}
+
+void ScopeAnalyzer::VisitIdentifierName(IdentifierName* /* identifier */) {}
+
+void ScopeAnalyzer::VisitIntLiteral(IntLiteral* /* literal */) {}
+
+void ScopeAnalyzer::VisitDoubleLiteral(DoubleLiteral* /* literal */) {}
+
+void ScopeAnalyzer::VisitStringLiteral(StringLiteral* /* literal */) {}
+
+void ScopeAnalyzer::VisitBooleanLiteral(BooleanLiteral* /* literal */) {}
+
+void ScopeAnalyzer::VisitArrayLiteral(ArrayLiteral* literal) {
+  for (auto& element : literal->elements) {
+    Visit(element);
+  }
+}
+
+void ScopeAnalyzer::VisitObjectLiteral(ObjectLiteral* literal) {
+  for (auto& prop : literal->properties) {
+    Visit(prop->name);
+    Visit(prop->value);
+  }
+}
+
+void ScopeAnalyzer::VisitUndefinedLiteral(UndefinedLiteral* /* literal */) {}
+
+void ScopeAnalyzer::VisitFunctionCall(FunctionCall* call) {
+  Visit(call->target);
+  for (auto& arg : call->args) {
+    Visit(arg);
+  }
+}
+
+void ScopeAnalyzer::VisitFunctionDecl(FunctionDecl* fn_decl) {
+  // Mirrors the pushes of Interpreter::Call, a repeated parameter name
+  // reuses the slot of its first occurrence.
+  auto arguments = String::Cast(Heap::arguments_symbol());
+  function_ = fn_decl;
+  for (auto& param : fn_decl->params) {
+    auto name = param->name.Get();
+    if (std::find(locals_.begin(), locals_.end(), name) == locals_.end()) {
+      locals_.push_back(name);
+    }
+  }
+  locals_.push_back(arguments);
+  for (auto& stmt : fn_decl->body) {
+    Visit(stmt);
+  }
+  locals_.clear();
+  function_ = nullptr;
+}
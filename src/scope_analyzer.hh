@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include "ast.hh"
+
+namespace kipper {
+namespace internal {
+
+/// Resolves identifiers to (depth, slot) pairs where that is sound.
+///
+/// A callee's Context is parented on its caller's, so a free name inside a
+/// function may bind to any caller's variable and assignments to unknown
+/// names create variables in whatever block runs them. The only bindings
+/// known at compile time are the function's own parameters and
+/// `arguments_`, which Interpreter::Call pushes first into the function
+/// Context, and which no block can shadow since blocks only get variables
+/// that did not resolve. Every other identifier keeps the dynamic lookup.
+class ScopeAnalyzer final : public NodeVisitor {
+ public:
+  static void Analyze(Node* ast);
+
+#define DECLARE_VISIT(Node) void Visit##Node(Node*) override final;
+  VISIT_NODES(DECLARE_VISIT)
+#undef DECLARE_VISIT
+
+ private:
+  ScopeAnalyzer() = default;
+
+  void Visit(Node* node) {
+    if (node) {
+      node->Accept(this);
+    }
+  }
+
+  std::vector<String*> locals_;
+  FunctionDecl* function_{nullptr};
+  int block_depth_{0};
+};
+
+}  // namespace internal
+}  // namespace kipper
@@ -0,0 +1,331 @@
+#include "snapshot.hh"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+#include "context.hh"
+#include "heap.hh"
+#include "runtime.hh"
+#include "space.hh"
+
+using namespace kipper::internal;
+
+std::string_view Snapshot::data_;
+const Function::FunctionTemplate* Snapshot::external_references_{nullptr};
+bool Snapshot::deserialized_{false};
+
+namespace {
+
+constexpr char kMagic[4] = {'K', 'S', 'S', 'N'};
+
+#define COUNT_ROOT(T, name) +1
+constexpr uint32_t kRootCount = 0 ROOT_LIST(COUNT_ROOT);
+#undef COUNT_ROOT
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t image_size;
+  uint32_t root_count;
+  uint32_t symbol_count;
+  uint32_t global_count;
+};
+
+uint64_t Bits(Object* value) { return reinterpret_cast<uint64_t>(value); }
+
+// Runtime::Natives() followed by the external references, a native function
+// is serialized as its index in here.
+std::vector<Function::FunctionTemplate> Natives(
+    const Function::FunctionTemplate* external_references) {
+  auto natives = Runtime::Natives();
+  for (auto it = external_references; it && *it; it++) {
+    natives.push_back(*it);
+  }
+  return natives;
+}
+
+/// Copies objects into the image in the order they are reached.
+class Serializer final : public ObjectVisitor {
+ public:
+  explicit Serializer(std::vector<Function::FunctionTemplate> natives)
+      : natives_{std::move(natives)} {}
+
+  /// Returns `value` as stored in the image, copying the object it points
+  /// to unless it already was.
+  uint64_t Encode(Object* value);
+
+  /// Encodes the fields of the copied objects, copying what they reach.
+  void EncodeFields();
+
+  void Visit(Object** slot) override;
+
+  const std::string& image() const { return image_; }
+
+ private:
+  void Write(size_t offset, uint64_t value) {
+    std::memcpy(image_.data() + offset, &value, sizeof(value));
+  }
+
+  void EncodeBody(Function* fn);
+
+  std::vector<Function::FunctionTemplate> natives_;
+  std::string image_;
+  std::unordered_map<Object*, uint64_t> offsets_;
+  std::vector<HeapObject*> pending_;
+  HeapObject* current_{nullptr};
+  uint64_t current_offset_{0};
+};
+
+uint64_t Serializer::Encode(Object* value) {
+  if (!value || !value->IsHeapObject()) {
+    return Bits(value);
+  }
+  auto [it, inserted] = offsets_.emplace(value, image_.size());
+  if (inserted) {
+    auto obj = HeapObject::Cast(value);
+    auto size = obj->Size();
+    if (image_.size() + size > std::numeric_limits<uint32_t>::max()) {
+      throw KError{"heap too large for a snapshot"};
+    }
+    image_.append(reinterpret_cast<const char*>(obj->address()), size);
+    // Drops the age, marks and forwarding pointer along the way.
+    Metadata metadata{nullptr};
+    metadata.set_type(obj->metadata().Type());
+    Write(it->second, metadata.EncodedMetadata());
+    pending_.push_back(obj);
+  }
+  return HeapObject::kHeapObjectTag | it->second;
+}
+
+void Serializer::EncodeFields() {
+  while (!pending_.empty()) {
+    current_ = pending_.back();
+    pending_.pop_back();
+    current_offset_ = offsets_[current_];
+    current_->IterateBody(this);
+    if (current_->IsFunction()) {
+      EncodeBody(Function::Cast(current_));
+    }
+  }
+}
+
+void Serializer::Visit(Object** slot) {
+  auto offset = reinterpret_cast<Address>(slot) - current_->address();
+  Write(current_offset_ + offset, Encode(*slot));
+}
+
+void Serializer::EncodeBody(Function* fn) {
+  if (!fn->IsFunctionTemplate()) {
+    throw KError{"snapshots cannot hold the script function " +
+                 std::string{fn->Name()->Value()}};
+  }
+  auto it = std::find(natives_.begin(), natives_.end(), fn->Body());
+  if (it == natives_.end()) {
+    throw KError{"native function " + std::string{fn->Name()->Value()} +
+                 " is missing from the external references"};
+  }
+  Write(current_offset_ + Function::kBodyOffset,
+        Function::kFunctionTemplateTag | (it - natives_.begin()));
+}
+
+/// Points the fields of an image copied into the heap at where it landed.
+class Deserializer final : public ObjectVisitor {
+ public:
+  Deserializer(Address image, uint32_t size,
+               std::vector<Function::FunctionTemplate> natives)
+      : image_{image},
+        size_{size},
+        natives_{std::move(natives)},
+        starts_(size / kPointerSize) {}
+
+  /// Checks and relocates every object of the image.
+  void Relocate();
+
+  /// Returns the object `value` stands for in the image.
+  Object* Decode(uint64_t value);
+
+  void Visit(Object** slot) override { *slot = Decode(Bits(*slot)); }
+
+  uint32_t object_count() const { return object_count_; }
+
+ private:
+  void DecodeBody(Function* fn);
+
+  Address image_;
+  uint32_t size_;
+  std::vector<Function::FunctionTemplate> natives_;
+  std::vector<bool> starts_;
+  uint32_t object_count_{0};
+};
+
+void Deserializer::Relocate() {
+  for (uint32_t offset = 0; offset < size_;) {
+    auto obj = HeapObject::Make(image_ + offset);
+    if (obj->metadata().Type() > HASH_TABLE) {
+      throw KError{"malformed snapshot"};
+    }
+    auto size = obj->Size();
+    if (size < HeapObject::kHeaderSize || size % kPointerSize != 0 ||
+        static_cast<uint32_t>(size) > size_ - offset) {
+      throw KError{"malformed snapshot"};
+    }
+    starts_[offset / kPointerSize] = true;
+    offset += size;
+    object_count_++;
+  }
+  for (uint32_t offset = 0; offset < size_;) {
+    auto obj = HeapObject::Make(image_ + offset);
+    obj->IterateBody(this);
+    if (obj->IsFunction()) {
+      DecodeBody(Function::Cast(obj));
+    }
+    offset += obj->Size();
+  }
+}
+
+Object* Deserializer::Decode(uint64_t value) {
+  auto obj = reinterpret_cast<Object*>(value);
+  if (!obj || !obj->IsHeapObject()) {
+    return obj;
+  }
+  auto offset = value & kObjectMask;
+  if (offset >= size_ || offset % kPointerSize != 0 ||
+      !starts_[offset / kPointerSize]) {
+    throw KError{"malformed snapshot"};
+  }
+  return HeapObject::Make(image_ + offset);
+}
+
+void Deserializer::DecodeBody(Function* fn) {
+  auto field = fn->address() + Function::kBodyOffset;
+  uint64_t body;
+  std::memcpy(&body, field, sizeof(body));
+  if (!(body & Function::kFunctionTemplateTag)) {
+    throw KError{"malformed snapshot"};
+  }
+  auto index = body & ~Function::kFunctionTemplateTag;
+  if (index >= natives_.size()) {
+    throw KError{"snapshot refers to a native function missing from the "
+                 "external references"};
+  }
+  body = reinterpret_cast<uint64_t>(natives_[index]) |
+         Function::kFunctionTemplateTag;
+  std::memcpy(field, &body, sizeof(body));
+}
+
+}  // namespace
+
+void Snapshot::Configure(
+    std::string_view data,
+    const Function::FunctionTemplate* external_references) {
+  data_ = data;
+  external_references_ = external_references;
+}
+
+std::string Snapshot::Create() {
+  Serializer serializer{Natives(external_references_)};
+  std::vector<uint64_t> tables;
+#define ENCODE_ROOT(T, name) tables.push_back(serializer.Encode(Heap::name##_));
+  ROOT_LIST(ENCODE_ROOT)
+#undef ENCODE_ROOT
+  uint32_t symbol_count = 0;
+  for (auto key : Heap::symbol_table_) {
+    tables.push_back(serializer.Encode(key->symbol()));
+    symbol_count++;
+  }
+  auto globals = Heap::GlobalContext()->Variables();
+  for (auto [name, value] : globals) {
+    tables.push_back(serializer.Encode(name));
+    tables.push_back(serializer.Encode(value));
+  }
+  serializer.EncodeFields();
+
+  auto& image = serializer.image();
+  Header header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.image_size = static_cast<uint32_t>(image.size());
+  header.root_count = kRootCount;
+  header.symbol_count = symbol_count;
+  header.global_count = static_cast<uint32_t>(globals.size());
+
+  std::string snapshot;
+  snapshot.reserve(sizeof(header) + image.size() +
+                   tables.size() * sizeof(uint64_t));
+  snapshot.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  snapshot += image;
+  snapshot.append(reinterpret_cast<const char*>(tables.data()),
+                  tables.size() * sizeof(uint64_t));
+  return snapshot;
+}
+
+bool Snapshot::Deserialize() {
+  deserialized_ = false;
+  if (data_.empty()) {
+    return false;
+  }
+  Header header;
+  if (data_.size() < sizeof(header)) {
+    throw KError{"malformed snapshot"};
+  }
+  std::memcpy(&header, data_.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.root_count != kRootCount) {
+    throw KError{"snapshot built by another version of Kipper"};
+  }
+  size_t table_size = (size_t{kRootCount} + header.symbol_count +
+                       size_t{header.global_count} * 2) *
+                      sizeof(uint64_t);
+  if (header.image_size % kPointerSize != 0 ||
+      data_.size() != sizeof(header) + header.image_size + table_size) {
+    throw KError{"malformed snapshot"};
+  }
+
+  Address image;
+  try {
+    image = Heap::AllocateRaw(header.image_size, OLD_SPACE)->address();
+  } catch (const AllocationError&) {
+    throw KError{"snapshot does not fit in the old space"};
+  }
+  std::memcpy(image, data_.data() + sizeof(header), header.image_size);
+  Deserializer deserializer{image, header.image_size,
+                            Natives(external_references_)};
+  deserializer.Relocate();
+  // The image was allocated as a single object.
+  Heap::old_space()->available_objects += deserializer.object_count() - 1;
+
+  auto table = data_.data() + sizeof(header) + header.image_size;
+  auto next = [&table, &deserializer]() {
+    uint64_t value;
+    std::memcpy(&value, table, sizeof(value));
+    table += sizeof(value);
+    return deserializer.Decode(value);
+  };
+  auto next_string = [&next]() {
+    auto value = next();
+    if (!value->IsString()) {
+      throw KError{"malformed snapshot"};
+    }
+    return String::Cast(value);
+  };
+#define DECODE_ROOT(T, name)                \
+  {                                         \
+    auto root = next();                     \
+    if (!root->IsHeapObject()) {            \
+      throw KError{"malformed snapshot"};   \
+    }                                       \
+    Heap::name##_ = HeapObject::Cast(root); \
+  }
+  ROOT_LIST(DECODE_ROOT)
+#undef DECODE_ROOT
+  for (uint32_t i = 0; i < header.symbol_count; i++) {
+    Heap::symbol_table_.Insert(next_string());
+  }
+  for (uint32_t i = 0; i < header.global_count; i++) {
+    auto name = next_string();
+    Heap::GlobalContext()->Push(name, next());
+  }
+  deserialized_ = true;
+  return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include "kipper.hh"
+#include "value.hh"
+
+namespace kipper {
+namespace internal {
+
+/// Serialized heap to start from instead of a fresh one.
+///
+/// Create() copies the heap roots, the symbols and the variables of the
+/// global Context, with every object they reach, into an image in which heap
+/// pointers are offsets from its start and native function bodies are
+/// indices into Runtime::Natives() followed by the external references.
+/// Deserialize() copies the image into the old space, relocates it to where
+/// it landed and installs its roots, symbols and globals. Script functions
+/// point into an AST, so they cannot be serialized.
+class Snapshot : public AllStatic {
+ public:
+  /// Sets the snapshot Heap::Initialize() starts from, and the natives
+  /// embedders may refer to, terminated by a nullptr.
+  static void Configure(std::string_view data,
+                        const Function::FunctionTemplate* external_references);
+
+  /// Serializes the initialized heap. Throws a KError if it reaches a
+  /// script function or a native missing from the external references.
+  static std::string Create();
+
+  /// Installs the configured snapshot on an empty heap. Returns false if
+  /// there is none, and throws a KError if it is malformed or built by
+  /// another version.
+  static bool Deserialize();
+
+  static bool deserialized() { return deserialized_; }
+
+  /// Bump whenever the layout of the heap objects changes.
+  static constexpr uint32_t kVersion = 1;
+
+ private:
+  static std::string_view data_;
+  static const Function::FunctionTemplate* external_references_;
+  static bool deserialized_;
+};
+
+}  // namespace internal
+}  // namespace kipper
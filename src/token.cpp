@@ -1,5 +1,4 @@
 #include "token.hh"
-#include <unordered_map>
 
 using namespace kipper::internal;
 
@@ -9,23 +8,72 @@ static const char* token_descs[Token::SIZE] = {
 #undef TOKEN_DESC
 };
 
-static const std::unordered_map<std::string_view, Token::Kind> keywords = {
+struct Keyword {
+  std::string_view name;
+  Token::Kind kind;
+};
+
+static constexpr Keyword keyword_list[] = {
 #define TOKEN_IGNORE(kind, desc)
-#define TOKEN_KEYWORD(kind, desc) \
-  {desc, Token::kind},
+#define TOKEN_KEYWORD(kind, desc) {desc, Token::kind},
     TOKEN_LIST(TOKEN_IGNORE, TOKEN_KEYWORD)
 #undef TOKEN_KEYWORD
 #undef TOKEN_IGNORE
 };
 
+static constexpr size_t kKeywordTableSize = 32;
+
+// A perfect hash of the keywords above, which the static_assert below
+// checks. Change the factors if a new keyword collides.
+static constexpr size_t HashKeyword(std::string_view id) {
+  auto first = static_cast<unsigned char>(id.front());
+  auto last = static_cast<unsigned char>(id.back());
+  return (id.size() * 3 + first + (last << 2)) & (kKeywordTableSize - 1);
+}
+
+static constexpr auto keyword_table = [] {
+  std::array<Keyword, kKeywordTableSize> table{};
+  for (auto& keyword : keyword_list) {
+    table[HashKeyword(keyword.name)] = keyword;
+  }
+  return table;
+}();
+
+static constexpr bool IsPerfectHash() {
+  for (auto& keyword : keyword_list) {
+    if (keyword_table[HashKeyword(keyword.name)].name != keyword.name) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(IsPerfectHash(), "keywords collide in HashKeyword()");
+
+const std::array<uint8_t, Token::SIZE> Token::precedences_ = [] {
+  std::array<uint8_t, Token::SIZE> precedences{};
+  precedences[Token::LOGIC_OR] = 1;
+  precedences[Token::LOGIC_AND] = 2;
+  precedences[Token::EQ] = precedences[Token::NE] = 3;
+  precedences[Token::LT] = precedences[Token::GT] = 4;
+  precedences[Token::LTE] = precedences[Token::GTE] = 4;
+  precedences[Token::PLUS] = precedences[Token::SUB] = 5;
+  precedences[Token::MUL] = precedences[Token::DIV] = 6;
+  precedences[Token::MOD] = 6;
+  return precedences;
+}();
+
 const char* Token::GetTokenDesc(Token::Kind kind) {
   return token_descs[kind];
 }
 
 std::optional<Token::Kind> Token::FindKeyword(std::string_view id) {
-  auto find = keywords.find(id);
-  if (find != keywords.end()) {
-    return find->second;
+  if (id.empty()) {
+    return std::nullopt;
+  }
+  auto& keyword = keyword_table[HashKeyword(id)];
+  if (keyword.name == id) {
+    return keyword.kind;
   }
   return std::nullopt;
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <optional>
 #include <string_view>
 
@@ -87,6 +89,13 @@ class Token {
     return (kind >= Token::PLUS && kind <= Token::MOD) ||
            (kind >= Token::LOGIC_OR && kind <= Token::GTE);
   }
+
+  /// How tightly a binary operator binds, from 1 for `||` up to 6 for `*`,
+  /// or 0 if `kind` is no binary operator.
+  static int GetPrecedence(Token::Kind kind) { return precedences_[kind]; }
+
+ private:
+  static const std::array<uint8_t, SIZE> precedences_;
 };
 
 }  // namespace internal
@@ -1,4 +1,8 @@
 #include "value.hh"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include <cstring>
 #include <string>
 #include "conversion.hh"
 #include "heap.hh"
@@ -104,7 +108,23 @@ class ToStringVisitor : public ObjectVisitor {
             builder_.append("]");
             return;
           case HeapObjectType::KSARRAY:
-            KSArray::Cast(obj)->IterateKSArrayBody(this);
+            builder_.append("[");
+            {
+              auto arr_obj = KSArray::Cast(obj);
+              for (auto i = 0, len = arr_obj->Length(); i < len; i++) {
+                auto item = arr_obj->Get(i);
+                Visit(&item);
+                if (i < len - 1) {
+                  builder_.append(", ");
+                }
+              }
+            }
+            builder_.append("]");
+            return;
+          case HeapObjectType::INT32_ARRAY:
+          case HeapObjectType::DOUBLE_ARRAY:
+          case HeapObjectType::HASH_TABLE:
+            builder_.append("[[elements]]");
             return;
           case HeapObjectType::FUNCTION:
             builder_.append("[[function]]");
@@ -185,6 +205,9 @@ bool Object::IsKSObject() {
       case HeapObjectType::HEAP_NUMBER:
       case HeapObjectType::ARRAY:
       case HeapObjectType::FUNCTION:
+      case HeapObjectType::INT32_ARRAY:
+      case HeapObjectType::DOUBLE_ARRAY:
+      case HeapObjectType::HASH_TABLE:
         return false;
     }
   }
@@ -243,6 +266,10 @@ Object* Object::ToBoolean() {
           return Constant::Boolean(false);
         case HeapObjectType::HEAP_NUMBER:
           return Constant::Boolean(HeapNumber::Cast(this)->Value());
+        case HeapObjectType::INT32_ARRAY:
+        case HeapObjectType::DOUBLE_ARRAY:
+        case HeapObjectType::HASH_TABLE:
+          return Constant::Boolean(true);
       }
   }
   UNREACHABLE();
@@ -269,6 +296,9 @@ Object* Object::ToNumber() {
         case HeapObjectType::KSARRAY:
         case HeapObjectType::FUNCTION:
         case HeapObjectType::KSOBJECT:
+        case HeapObjectType::INT32_ARRAY:
+        case HeapObjectType::DOUBLE_ARRAY:
+        case HeapObjectType::HASH_TABLE:
           return Double::NaN();
         case HeapObjectType::HEAP_NUMBER:
           break;
@@ -417,8 +447,8 @@ Double* Double::Make(double value) {
 }
 
 Object* Double::MakeFit(double value) {
-  if (Int32::Fit(value)) {
-    return Int32::Make(value);
+  if (Int32::Fit(value) && static_cast<int32_t>(value) == value) {
+    return Int32::Make(static_cast<int32_t>(value));
   }
   return Double::Make(value);
 }
@@ -439,11 +469,6 @@ int32_t Int32::Value() {
   return static_cast<int32_t>(PTR_INT(this) & kObjectMask);
 }
 
-Int32* Int32::Make(int32_t value) {
-  return reinterpret_cast<Int32*>(static_cast<uint32_t>(value) |
-                                  Int32::kInt32Tag);
-}
-
 Int32* Int32::Cast(Object* obj) {
   assert(obj->IsInt32());
   return reinterpret_cast<Int32*>(obj);
@@ -499,6 +524,12 @@ int HeapObject::Size() {
       return HeapNumber::kSize;
     case FUNCTION:
       return Function::kSize;
+    case INT32_ARRAY:
+      return Int32Array::EnsureSize(Int32Array::Cast(this)->Length());
+    case DOUBLE_ARRAY:
+      return DoubleArray::EnsureSize(DoubleArray::Cast(this)->Length());
+    case HASH_TABLE:
+      return HashTable::EnsureSize(HashTable::Cast(this)->Capacity());
   }
   UNREACHABLE();
   return 0;
@@ -521,7 +552,12 @@ void HeapObject::IterateBody(ObjectVisitor* visitor) {
     case FUNCTION:
       Function::Cast(this)->IterateFunctionBody(visitor);
       return;
+    case HASH_TABLE:
+      HashTable::Cast(this)->IterateHashTableBody(visitor);
+      return;
     case HEAP_NUMBER:
+    case INT32_ARRAY:
+    case DOUBLE_ARRAY:
       return;
   }
 }
@@ -549,12 +585,17 @@ Object* KSObject::GetProperty(Object* key) {
   return Constant::Undefined();
 }
 
+bool KSObject::DeleteProperty(Object* key) {
+  return Elements()->Delete(key->ToString());
+}
+
 HashTable* KSObject::Elements() {
   return HashTable::Cast(READ_FIELD(this, kElementsOffset));
 }
 
 void KSObject::SetElements(HashTable* elements) {
   WRITE_FIELD(this, kElementsOffset, elements);
+  WRITE_BARRIER(this, elements);
 }
 
 void KSObject::IterateKSObjectBody(ObjectVisitor* visitor) {
@@ -617,19 +658,15 @@ void String::Content(std::string_view value) {
 
 int String::Hash() { return Hash(Value()); }
 
+// 32-bit FNV-1a; HashTable takes probe positions and control bytes from
+// different bits of it, so every bit has to depend on every character.
 int String::Hash(std::string_view value) {
-  auto length = value.size();
-  if (length == 0) {
-    return 0;
-  }
-  if (length == 1) {
-    return static_cast<int>(value[0]);
-  }
-  int hash = 0;
+  uint32_t hash = 2166136261U;
   for (auto ch : value) {
-    hash += static_cast<int>(ch) * 31;
+    hash ^= static_cast<uint8_t>(ch);
+    hash *= 16777619U;
   }
-  return hash;
+  return static_cast<int>(hash);
 }
 
 String* String::Concat(String* that) {
@@ -700,35 +737,222 @@ Object** Array::GetHandle(int32_t index) {
   return &READ_FIELD(this, kElementsOffset + kPointerSize * index);
 }
 
+int32_t Int32Array::Length() { return READ_INT32_FIELD(this, kLengthOffset); }
+
+void Int32Array::SetLength(int32_t length) {
+  READ_INT32_FIELD(this, kLengthOffset) = length;
+}
+
+int32_t Int32Array::Get(int32_t index) {
+  assert(index < Length());
+  return READ_INT32_FIELD(this, kElementsOffset + sizeof(int32_t) * index);
+}
+
+void Int32Array::Set(int32_t index, int32_t value) {
+  assert(index < Length());
+  READ_INT32_FIELD(this, kElementsOffset + sizeof(int32_t) * index) = value;
+}
+
+void Int32Array::Copy(Int32Array* that) {
+  assert(Length() >= that->Length());
+  std::memcpy(FIELD_ADDR(this, kElementsOffset),
+              FIELD_ADDR(that, kElementsOffset),
+              that->Length() * sizeof(int32_t));
+}
+
+Int32Array* Int32Array::Cast(Object* obj) {
+  assert(obj->IsHeapObject() && HeapObject::Cast(obj)->metadata().Type() ==
+                                    HeapObjectType::INT32_ARRAY);
+  return static_cast<Int32Array*>(obj);
+}
+
+int32_t DoubleArray::Length() { return READ_INT32_FIELD(this, kLengthOffset); }
+
+void DoubleArray::SetLength(int32_t length) {
+  READ_INT32_FIELD(this, kLengthOffset) = length;
+}
+
+double DoubleArray::Get(int32_t index) {
+  assert(index < Length());
+  return *reinterpret_cast<double*>(
+      FIELD_ADDR(this, kElementsOffset + sizeof(double) * index));
+}
+
+void DoubleArray::Set(int32_t index, double value) {
+  assert(index < Length());
+  *reinterpret_cast<double*>(
+      FIELD_ADDR(this, kElementsOffset + sizeof(double) * index)) = value;
+}
+
+void DoubleArray::Copy(DoubleArray* that) {
+  assert(Length() >= that->Length());
+  std::memcpy(FIELD_ADDR(this, kElementsOffset),
+              FIELD_ADDR(that, kElementsOffset),
+              that->Length() * sizeof(double));
+}
+
+DoubleArray* DoubleArray::Cast(Object* obj) {
+  assert(obj->IsHeapObject() && HeapObject::Cast(obj)->metadata().Type() ==
+                                    HeapObjectType::DOUBLE_ARRAY);
+  return static_cast<DoubleArray*>(obj);
+}
+
+static constexpr int8_t kCtrlEmpty = -128;
+static constexpr int8_t kCtrlDeleted = -2;
+
+// Probe start and the 7 hash bits kept in the control byte of a full slot.
+inline static int HashToH1(int hash) { return static_cast<uint32_t>(hash) >> 7; }
+
+inline static int8_t HashToH2(int hash) { return hash & 0x7f; }
+
+inline static bool IsFull(int8_t ctrl) { return ctrl >= 0; }
+
+// A window of HashTable::kGroupWidth control bytes. Bit i of a match mask
+// stands for the slot i positions after the start of the window.
+class CtrlGroup {
+ public:
+#if defined(__SSE2__)
+  explicit CtrlGroup(const int8_t* ctrl)
+      : ctrl_{_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))} {}
+
+  uint32_t Match(int8_t h2) const {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_));
+  }
+
+  uint32_t MatchEmptyOrDeleted() const { return _mm_movemask_epi8(ctrl_); }
+
+ private:
+  __m128i ctrl_;
+#else
+  explicit CtrlGroup(const int8_t* ctrl) {
+    std::memcpy(ctrl_, ctrl, HashTable::kGroupWidth);
+  }
+
+  uint32_t Match(int8_t h2) const {
+    uint32_t mask = 0;
+    for (int i = 0; i < HashTable::kGroupWidth; i++) {
+      mask |= static_cast<uint32_t>(ctrl_[i] == h2) << i;
+    }
+    return mask;
+  }
+
+  uint32_t MatchEmptyOrDeleted() const {
+    uint32_t mask = 0;
+    for (int i = 0; i < HashTable::kGroupWidth; i++) {
+      mask |= static_cast<uint32_t>(!IsFull(ctrl_[i])) << i;
+    }
+    return mask;
+  }
+
+ private:
+  int8_t ctrl_[HashTable::kGroupWidth];
+#endif
+
+ public:
+  uint32_t MatchEmpty() const { return Match(kCtrlEmpty); }
+};
+
 HashTable* HashTable::Insert(String* key, Object* value) {
   int hash = key->Hash();
-  auto entry = FindEntry(key, hash);
-  if (entry != -1) {
-    Set(EntryToIndex(entry) + 1, value);
+  if (auto entry = FindEntry(key, hash); entry != -1) {
+    SetValueAt(entry, value);
     return this;
   }
-  auto table = AddElement(1);
-  auto insertion_index = table->FindInsertionIndex(hash);
-  table->SetEntry(insertion_index, key, value);
+  auto table = this;
+  if (ElementsSize() + DeletedSize() >= MaxElements(Capacity())) {
+    table = Grow();
+  }
+  table->InsertNew(hash, key, value);
   return table;
 }
 
 Object* HashTable::Search(String* key) {
-  auto entry = FindEntry(key, key->Hash());
-  if (entry != -1) {
-    return Get(EntryToIndex(entry) + 1);
+  if (auto entry = FindEntry(key, key->Hash()); entry != -1) {
+    return ValueAt(entry);
   }
   return nullptr;
 }
 
 bool HashTable::Delete(String* key) {
   auto entry = FindEntry(key, key->Hash());
-  if (entry != -1) {
-    SetEntry(EntryToIndex(entry), Constant::Undefined(), Constant::Undefined());
-    SetElementsSize(ElementsSize() - 1);
-    return true;
+  if (entry == -1) {
+    return false;
+  }
+  // The slot may become empty again unless some probe could have walked
+  // past it, i.e. unless it sits in a run of kGroupWidth non-empty slots.
+  auto capacity = Capacity();
+  bool was_never_full = capacity < kGroupWidth;
+  if (!was_never_full) {
+    auto mask = capacity - 1;
+    auto empty_before =
+        CtrlGroup{Ctrl() + ((entry - kGroupWidth) & mask)}.MatchEmpty();
+    auto empty_after = CtrlGroup{Ctrl() + entry}.MatchEmpty();
+    was_never_full = empty_before && empty_after &&
+                     (__builtin_ctz(empty_after) +
+                      __builtin_clz(empty_before) - (32 - kGroupWidth)) <
+                         kGroupWidth;
+  }
+  SetCtrl(entry, was_never_full ? kCtrlEmpty : kCtrlDeleted);
+  Slot(entry)[0] = Constant::Undefined();
+  Slot(entry)[1] = Constant::Undefined();
+  SetElementsSize(ElementsSize() - 1);
+  if (!was_never_full) {
+    SetDeletedSize(DeletedSize() + 1);
+  }
+  return true;
+}
+
+Object* HashTable::KeyAt(int entry) {
+  assert(entry >= 0 && entry < Capacity());
+  return Slot(entry)[0];
+}
+
+Object* HashTable::ValueAt(int entry) {
+  assert(entry >= 0 && entry < Capacity());
+  return Slot(entry)[1];
+}
+
+void HashTable::SetValueAt(int entry, Object* value) {
+  assert(entry >= 0 && entry < Capacity());
+  Slot(entry)[1] = value;
+  WRITE_BARRIER(this, value);
+}
+
+int HashTable::ElementsSize() {
+  return READ_INT32_FIELD(this, kElementsSizeOffset);
+}
+
+void HashTable::SetElementsSize(int elements_size) {
+  assert(elements_size >= 0);
+  READ_INT32_FIELD(this, kElementsSizeOffset) = elements_size;
+}
+
+int HashTable::DeletedSize() {
+  return READ_INT32_FIELD(this, kDeletedSizeOffset);
+}
+
+void HashTable::SetDeletedSize(int deleted_size) {
+  assert(deleted_size >= 0);
+  READ_INT32_FIELD(this, kDeletedSizeOffset) = deleted_size;
+}
+
+int HashTable::Capacity() { return READ_INT32_FIELD(this, kCapacityOffset); }
+
+void HashTable::SetCapacity(int capacity) {
+  assert(capacity == 0 || (capacity & (capacity - 1)) == 0);
+  READ_INT32_FIELD(this, kCapacityOffset) = capacity;
+}
+
+void HashTable::Clear() {
+  auto capacity = Capacity();
+  SetElementsSize(0);
+  SetDeletedSize(0);
+  std::memset(Ctrl(), static_cast<uint8_t>(kCtrlEmpty),
+              capacity + kGroupWidth);
+  for (int i = 0; i < capacity; i++) {
+    Slot(i)[0] = Constant::Undefined();
+    Slot(i)[1] = Constant::Undefined();
   }
-  return false;
 }
 
 void HashTable::IterateHashTableBody(ObjectVisitor* visitor) {
@@ -736,12 +960,12 @@ void HashTable::IterateHashTableBody(ObjectVisitor* visitor) {
   if (elements_size == 0) {
     return;
   }
-  auto capacity = Capacity();
+  auto ctrl = Ctrl();
   int passed_elements_size = 0;
-  for (auto i = 0; i < capacity; i++) {
-    auto index = EntryToIndex(i);
-    if (auto key = GetHandle(index); !(*key)->IsUndefined()) {
-      visitor->VisitHashTableEntry(key, GetHandle(index + 1));
+  for (int i = 0, capacity = Capacity(); i < capacity; i++) {
+    if (IsFull(ctrl[i])) {
+      auto slot = Slot(i);
+      visitor->VisitHashTableEntry(slot, slot + 1);
       if (++passed_elements_size == elements_size) {
         return;
       }
@@ -749,80 +973,165 @@ void HashTable::IterateHashTableBody(ObjectVisitor* visitor) {
   }
 }
 
+int HashTable::CapacityFor(int elements_size) {
+  if (elements_size == 0) {
+    return 0;
+  }
+  int capacity = 2;
+  while (MaxElements(capacity) < elements_size) {
+    capacity <<= 1;
+  }
+  return capacity;
+}
+
 HashTable* HashTable::Cast(Object* obj) {
-  assert(obj->IsArray());
+  assert(obj->IsHeapObject() && HeapObject::Cast(obj)->metadata().Type() ==
+                                    HeapObjectType::HASH_TABLE);
   return static_cast<HashTable*>(obj);
 }
 
-HashTable* HashTable::AddElement(int count) {
-  int capacity = Capacity();
-  int new_elements_size = ElementsSize() + count;
-  if (new_elements_size + (new_elements_size >> 2) <= capacity) {
-    SetElementsSize(new_elements_size);
+HashTable* HashTable::Grow() {
+  auto elements_size = ElementsSize();
+  auto capacity = Capacity();
+  // Mostly tombstones: reclaim them without allocating.
+  if (DeletedSize() > 0 && elements_size * 2 < MaxElements(capacity)) {
+    Rehash();
     return this;
   }
-  auto new_table = Cast(Heap::AllocateHashTableNoGC(new_elements_size * 2));
-  new_table->SetElementsSize(new_elements_size);
+  auto new_table =
+      Cast(Heap::AllocateHashTableNoGC(std::max(elements_size * 2, 1)));
+  auto ctrl = Ctrl();
   for (int i = 0; i < capacity; i++) {
-    auto from_index = EntryToIndex(i);
-    auto key = String::Cast(Get(from_index));
-    if (!key->IsUndefined()) {
-      auto insertion_index = new_table->FindInsertionIndex(key->Hash());
-      new_table->SetEntry(insertion_index, key, Get(from_index + 1));
+    if (IsFull(ctrl[i])) {
+      auto key = String::Cast(KeyAt(i));
+      new_table->InsertNew(key->Hash(), key, ValueAt(i));
     }
   }
   return new_table;
 }
 
-int HashTable::FindInsertionIndex(int hash) {
+// Drops tombstones without resizing. Full slots are first marked deleted,
+// then each one is moved to the first free slot of its probe sequence,
+// swapping with a not yet placed entry when needed.
+void HashTable::Rehash() {
   auto capacity = Capacity();
-  auto index = EntryToIndex(Location(hash, 0, capacity));
-  if (EntryKeyAt(index)->IsUndefined()) {
-    return index;
-  }
-  for (int i = 1;; i++) {
-    index = EntryToIndex(Location(hash, i, capacity));
-    if (EntryKeyAt(index)->IsUndefined()) {
-      return index;
+  auto mask = capacity - 1;
+  auto ctrl = Ctrl();
+  for (int i = 0; i < capacity; i++) {
+    SetCtrl(i, IsFull(ctrl[i]) ? kCtrlDeleted : kCtrlEmpty);
+  }
+  for (int i = 0; i < capacity; i++) {
+    if (ctrl[i] != kCtrlDeleted) {
+      continue;
     }
+    auto hash = String::Cast(KeyAt(i))->Hash();
+    auto probe_start = HashToH1(hash) & mask;
+    auto target = FindInsertionEntry(hash);
+    auto probe_group = [=](int entry) {
+      return ((entry - probe_start) & mask) / kGroupWidth;
+    };
+    if (probe_group(i) == probe_group(target)) {
+      SetCtrl(i, HashToH2(hash));
+      continue;
+    }
+    auto from = Slot(i);
+    auto to = Slot(target);
+    if (ctrl[target] == kCtrlEmpty) {
+      to[0] = from[0];
+      to[1] = from[1];
+      from[0] = Constant::Undefined();
+      from[1] = Constant::Undefined();
+      SetCtrl(target, HashToH2(hash));
+      SetCtrl(i, kCtrlEmpty);
+      continue;
+    }
+    std::swap(from[0], to[0]);
+    std::swap(from[1], to[1]);
+    SetCtrl(target, HashToH2(hash));
+    i--;
   }
-  return index;
+  SetDeletedSize(0);
 }
 
+void HashTable::InsertNew(int hash, String* key, Object* value) {
+  auto entry = FindInsertionEntry(hash);
+  if (Ctrl()[entry] == kCtrlDeleted) {
+    SetDeletedSize(DeletedSize() - 1);
+  }
+  SetCtrl(entry, HashToH2(hash));
+  auto slot = Slot(entry);
+  slot[0] = key;
+  slot[1] = value;
+  WRITE_BARRIER(this, key);
+  WRITE_BARRIER(this, value);
+  SetElementsSize(ElementsSize() + 1);
+}
+
+// Probing visits whole groups in triangular steps, which covers every group
+// since the capacity is a power of two. A full table always keeps an empty
+// slot, so the loops end.
 int HashTable::FindEntry(String* key, int hash) {
-  auto elements_size = ElementsSize();
-  if (elements_size == 0) {
+  if (ElementsSize() == 0) {
     return -1;
   }
-  auto capacity = Capacity();
-  auto entry = Location(hash, 0, capacity);
-  int passed_elements_size = 0;
-  if (auto entry_key = EntryKeyAt(EntryToIndex(entry));
-      !entry_key->IsUndefined()) {
-    if (entry_key->Equals(key)) {
-      return entry;
-    }
-    passed_elements_size++;
-  }
-  for (auto i = 1; i < capacity; i++) {
-    entry = Location(hash, i, capacity);
-    if (auto entry_key = EntryKeyAt(EntryToIndex(entry));
-        !entry_key->IsUndefined()) {
-      if (entry_key->Equals(key)) {
+  auto mask = Capacity() - 1;
+  auto ctrl = Ctrl();
+  auto h2 = HashToH2(hash);
+  auto offset = HashToH1(hash) & mask;
+  for (int step = kGroupWidth;; step += kGroupWidth) {
+    CtrlGroup group{ctrl + offset};
+    for (auto bits = group.Match(h2); bits; bits &= bits - 1) {
+      auto entry = (offset + __builtin_ctz(bits)) & mask;
+      auto entry_key = KeyAt(entry);
+      if (entry_key == key ||
+          String::Cast(entry_key)->Value() == key->Value()) {
         return entry;
       }
-      if (++passed_elements_size == elements_size) {
-        return -1;
-      }
     }
+    if (group.MatchEmpty()) {
+      return -1;
+    }
+    offset = (offset + step) & mask;
+  }
+}
+
+int HashTable::FindInsertionEntry(int hash) {
+  auto mask = Capacity() - 1;
+  auto ctrl = Ctrl();
+  auto offset = HashToH1(hash) & mask;
+  for (int step = kGroupWidth;; step += kGroupWidth) {
+    if (auto bits = CtrlGroup{ctrl + offset}.MatchEmptyOrDeleted()) {
+      return (offset + __builtin_ctz(bits)) & mask;
+    }
+    offset = (offset + step) & mask;
+  }
+}
+
+int8_t* HashTable::Ctrl() {
+  return reinterpret_cast<int8_t*>(FIELD_ADDR(this, kCtrlOffset));
+}
+
+void HashTable::SetCtrl(int entry, int8_t ctrl) {
+  auto capacity = Capacity();
+  auto bytes = Ctrl();
+  bytes[entry] = ctrl;
+  // Tables smaller than a group mirror their bytes repeatedly.
+  for (int i = entry + capacity; i < capacity + kGroupWidth; i += capacity) {
+    bytes[i] = ctrl;
   }
-  return -1;
 }
 
-void HashTable::SetEntry(int index, Object* key, Object* value) {
-  assert(index + 1 < Length());
-  Set(index, key);
-  Set(index + 1, value);
+Object** HashTable::Slot(int entry) {
+  return reinterpret_cast<Object**>(FIELD_ADDR(
+      this, EntriesOffset(Capacity()) + 2 * kPointerSize * entry));
+}
+
+// Int32 elements widened into a double store read back as Int32.
+inline static Object* BoxDoubleElement(double value) {
+  if (Int32::Fit(value) && static_cast<int32_t>(value) == value) {
+    return Int32::Make(static_cast<int32_t>(value));
+  }
+  return Double::Make(value);
 }
 
 int32_t KSArray::Length() {
@@ -837,41 +1146,71 @@ void KSArray::SetLength(int32_t length) {
 
 int32_t KSArray::Capacity() {
   assert(IsKSArray());
-  return Elements()->Length();
+  switch (Kind()) {
+    case PACKED_INT32_ELEMENTS:
+      return Int32Array::Cast(Elements())->Length();
+    case PACKED_DOUBLE_ELEMENTS:
+      return DoubleArray::Cast(Elements())->Length();
+    case GENERIC_ELEMENTS:
+      return Array::Cast(Elements())->Length();
+  }
+  UNREACHABLE();
+  return 0;
+}
+
+ElementsKind KSArray::Kind() {
+  return static_cast<ElementsKind>(READ_INT32_FIELD(this, kKindOffset));
 }
 
 Object* KSArray::Get(int32_t index) {
   assert(IsKSArray());
-  if (index < Length()) {
-    return Elements()->Get(index);
+  if (index < 0 || index >= Length()) {
+    return Constant::Undefined();
   }
+  switch (Kind()) {
+    case PACKED_INT32_ELEMENTS:
+      return Int32::Make(Int32Array::Cast(Elements())->Get(index));
+    case PACKED_DOUBLE_ELEMENTS:
+      return BoxDoubleElement(DoubleArray::Cast(Elements())->Get(index));
+    case GENERIC_ELEMENTS:
+      return Array::Cast(Elements())->Get(index);
+  }
+  UNREACHABLE();
   return Constant::Undefined();
 }
 
-Object* KSArray::Set(int32_t index, Object* value) {
-  assert(IsKSArray());
-  return Elements()->Set(index, value);
-}
-
-Array* KSArray::Elements() {
-  return Array::Cast(READ_FIELD(this, kElementsOffset));
+HeapObject* KSArray::Elements() {
+  return HeapObject::Cast(READ_FIELD(this, kElementsOffset));
 }
 
-void KSArray::SetElements(Array* elements) {
+void KSArray::SetElements(HeapObject* elements, ElementsKind kind) {
   WRITE_FIELD(this, kElementsOffset, elements);
   WRITE_BARRIER(this, elements);
+  READ_INT32_FIELD(this, kKindOffset) = kind;
 }
 
 void KSArray::IterateKSArrayBody(ObjectVisitor* visitor) {
   visitor->Visit(&READ_FIELD(this, kElementsOffset));
 }
 
+Object* KSArray::Set(Handle<KSArray> self, int32_t index,
+                     Handle<Object> value) {
+  CALL_WITH_GC_SUPPORT(return self->SetNoGC(index, *value));
+  UNREACHABLE();
+  return Constant::Undefined();
+}
+
 void KSArray::Push(Handle<KSArray> self, Handle<Object> value) {
   CALL_WITH_GC_SUPPORT(self->Push(value));
 }
 
 KSArray* KSArray::New(int32_t length, AllocationPolicy policy) {
-  return Cast(Heap::AllocateKSArray(length, policy));
+  return Cast(Heap::AllocateKSArray(length, GENERIC_ELEMENTS, policy));
+}
+
+KSArray* KSArray::New(int32_t length, ElementsKind kind,
+                      AllocationPolicy policy) {
+  return Cast(Heap::AllocateKSArray(length, kind, policy));
 }
 
 KSArray* KSArray::Cast(Object* obj) {
@@ -879,16 +1218,86 @@ KSArray* KSArray::Cast(Object* obj) {
   return static_cast<KSArray*>(obj);
 }
 
+ElementsKind KSArray::KindFor(Object* value) {
+  if (value->IsInt32()) {
+    return PACKED_INT32_ELEMENTS;
+  }
+  if (value->IsDouble()) {
+    return PACKED_DOUBLE_ELEMENTS;
+  }
+  return GENERIC_ELEMENTS;
+}
+
+Object* KSArray::SetNoGC(int32_t index, Object* value) {
+  if (index < 0 || index >= Length()) {
+    return Constant::Undefined();
+  }
+  EnsureKind(KindFor(value));
+  switch (Kind()) {
+    case PACKED_INT32_ELEMENTS:
+      Int32Array::Cast(Elements())->Set(index, Int32::Cast(value)->Value());
+      return value;
+    case PACKED_DOUBLE_ELEMENTS:
+      DoubleArray::Cast(Elements())->Set(index, value->ToDouble());
+      return value;
+    case GENERIC_ELEMENTS:
+      return Array::Cast(Elements())->Set(index, value);
+  }
+  UNREACHABLE();
+  return Constant::Undefined();
+}
+
 void KSArray::Push(Handle<Object> value) {
+  EnsureKind(KindFor(*value));
   auto current_length = Length();
   if (current_length >= Capacity()) {
     int length = current_length + 1 + (current_length >> 1);
-    auto new_array = Array::Cast(Heap::AllocateArrayNoGC(length));
-    new_array->Copy(Elements());
-    SetElements(new_array);
+    switch (auto kind = Kind()) {
+      case PACKED_INT32_ELEMENTS: {
+        auto new_array = Int32Array::Cast(Heap::AllocateInt32ArrayNoGC(length));
+        new_array->Copy(Int32Array::Cast(Elements()));
+        SetElements(new_array, kind);
+        break;
+      }
+      case PACKED_DOUBLE_ELEMENTS: {
+        auto new_array =
+            DoubleArray::Cast(Heap::AllocateDoubleArrayNoGC(length));
+        new_array->Copy(DoubleArray::Cast(Elements()));
+        SetElements(new_array, kind);
+        break;
+      }
+      case GENERIC_ELEMENTS: {
+        auto new_array = Array::Cast(Heap::AllocateArrayNoGC(length));
+        new_array->Copy(Array::Cast(Elements()));
+        SetElements(new_array, kind);
+        break;
+      }
+    }
   }
   SetLength(current_length + 1);
-  Elements()->Set(current_length, *value);
+  SetNoGC(current_length, *value);
+}
+
+void KSArray::EnsureKind(ElementsKind kind) {
+  if (kind <= Kind()) {
+    return;
+  }
+  auto length = Length();
+  auto capacity = Capacity();
+  if (kind == PACKED_DOUBLE_ELEMENTS) {
+    auto from = Int32Array::Cast(Elements());
+    auto to = DoubleArray::Cast(Heap::AllocateDoubleArrayNoGC(capacity));
+    for (int i = 0; i < length; i++) {
+      to->Set(i, from->Get(i));
+    }
+    SetElements(to, kind);
+    return;
+  }
+  auto to = Array::Cast(Heap::AllocateArrayNoGC(capacity));
+  for (int i = 0; i < length; i++) {
+    to->Set(i, Get(i));
+  }
+  SetElements(to, kind);
 }
 
 HeapNumber* HeapNumber::New(int64_t value, AllocationPolicy policy) {
@@ -995,7 +1404,7 @@ void Metadata::IncrementAge() {
   auto age_bits = (static_cast<uint64_t>(Age() + 1) << AgeBitsOffset);
   metadata_ = age_bits | (metadata_ & ~AgeMask);
   assert(static_cast<uint8_t>(metadata_ >> 48) >= HeapObjectType::KSOBJECT &&
-         static_cast<uint8_t>(metadata_ >> 48) <= HeapObjectType::FUNCTION);
+         static_cast<uint8_t>(metadata_ >> 48) <= HeapObjectType::HASH_TABLE);
 }
 
 void Metadata::Forwarding(Address addr) {
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <limits>
 #include <numeric>
 #include <string>
 #include <string_view>
@@ -35,7 +37,25 @@ using KSObjectGetPropertyInterceptor = Handle<Object> (*)(KSObject* obj,
 
 enum AllocationPolicy { NOT_TENURED, TENURED };
 
-enum HeapObjectType { KSOBJECT, STRING, ARRAY, KSARRAY, HEAP_NUMBER, FUNCTION };
+enum HeapObjectType {
+  KSOBJECT,
+  STRING,
+  ARRAY,
+  KSARRAY,
+  HEAP_NUMBER,
+  FUNCTION,
+  INT32_ARRAY,
+  DOUBLE_ARRAY,
+  HASH_TABLE
+};
+
+/// Representation of the elements of a KSArray. Kinds only move towards
+/// GENERIC_ELEMENTS.
+enum ElementsKind {
+  PACKED_INT32_ELEMENTS,
+  PACKED_DOUBLE_ELEMENTS,
+  GENERIC_ELEMENTS
+};
 
 class Object {
  public:
@@ -80,6 +100,7 @@ class Double : public Object {
 
   static Double* Make(double value);
 
+  /// An Int32 if `value` is an integer in its range, a Double otherwise.
   static Object* MakeFit(double value);
 
   static Double* NaN();
@@ -98,7 +119,9 @@ class Int32 : public Object {
  public:
   int32_t Value();
 
-  static Int32* Make(int32_t value);
+  static Int32* Make(int32_t value) {
+    return reinterpret_cast<Int32*>(static_cast<uint32_t>(value) | kInt32Tag);
+  }
 
   static bool Fit(double value) {
     return value >= static_cast<double>(kMinInt32) &&
@@ -107,6 +130,59 @@ class Int32 : public Object {
 
   static Int32* Cast(Object* obj);
 
+  /// Inline tag check for hot paths.
+  static bool Is(Object* obj) {
+    return (reinterpret_cast<uint64_t>(obj) & ~kObjectMask) == kInt32Tag;
+  }
+
+  static bool Both(Object* left, Object* right) {
+    return Is(left) && Is(right);
+  }
+
+  /// Value of an object known to be an Int32.
+  static int32_t ValueOf(Object* obj) {
+    return static_cast<int32_t>(reinterpret_cast<uint64_t>(obj));
+  }
+
+  /// Int32 arithmetic on two Int32 operands. Returns false on overflow,
+  /// in which case the caller computes the result as a double.
+  static bool Add(Object* left, Object* right, Object** result) {
+    int32_t value;
+    if (__builtin_add_overflow(ValueOf(left), ValueOf(right), &value)) {
+      return false;
+    }
+    *result = Make(value);
+    return true;
+  }
+
+  static bool Sub(Object* left, Object* right, Object** result) {
+    int32_t value;
+    if (__builtin_sub_overflow(ValueOf(left), ValueOf(right), &value)) {
+      return false;
+    }
+    *result = Make(value);
+    return true;
+  }
+
+  static bool Mul(Object* left, Object* right, Object** result) {
+    int32_t value;
+    if (__builtin_mul_overflow(ValueOf(left), ValueOf(right), &value)) {
+      return false;
+    }
+    *result = Make(value);
+    return true;
+  }
+
+  /// Returns false for a divisor of 0 (NaN) and -1 (traps on kMinInt32).
+  static bool Mod(Object* left, Object* right, Object** result) {
+    auto divisor = ValueOf(right);
+    if (divisor == 0 || divisor == -1) {
+      return false;
+    }
+    *result = Make(ValueOf(left) % divisor);
+    return true;
+  }
+
   static constexpr uint64_t kInt32Tag = 0xfff9000000000000;
   static constexpr int32_t kMaxInt32 = 0x7fffffff;
   static constexpr int32_t kMinInt32 = ~kMaxInt32;
@@ -228,6 +304,9 @@ class KSObject : public HeapObject {
  public:
   Object* GetProperty(Object* key);
 
+  /// Removes the property `key`, returns false if it was not set.
+  bool DeleteProperty(Object* key);
+
   HashTable* Elements();
 
   void SetElements(HashTable* elements);
@@ -319,7 +398,63 @@ class Array : public HeapObject {
   Object** GetHandle(int32_t index);
 };
 
-class HashTable : public Array {
+/// Unboxed backing store of a PACKED_INT32_ELEMENTS KSArray. The body holds
+/// no pointers, so it is never scanned and stores need no write barrier.
+class Int32Array : public HeapObject {
+ public:
+  int32_t Length();
+
+  void SetLength(int32_t length);
+
+  int32_t Get(int32_t index);
+
+  void Set(int32_t index, int32_t value);
+
+  void Copy(Int32Array* that);
+
+  static int EnsureSize(int length) {
+    return Align(kElementsOffset + sizeof(int32_t) * length);
+  }
+
+  static Int32Array* Cast(Object* obj);
+
+  static constexpr int kLengthOffset = HeapObject::kHeaderSize;
+  static constexpr int kElementsOffset = kLengthOffset + Int32::kSize;
+
+  DISABLE_DEFAULT_OP(Int32Array)
+};
+
+/// Unboxed backing store of a PACKED_DOUBLE_ELEMENTS KSArray.
+class DoubleArray : public HeapObject {
+ public:
+  int32_t Length();
+
+  void SetLength(int32_t length);
+
+  double Get(int32_t index);
+
+  void Set(int32_t index, double value);
+
+  void Copy(DoubleArray* that);
+
+  static int EnsureSize(int length) {
+    return Align(kElementsOffset + sizeof(double) * length);
+  }
+
+  static DoubleArray* Cast(Object* obj);
+
+  static constexpr int kLengthOffset = HeapObject::kHeaderSize;
+  static constexpr int kElementsOffset = Align(kLengthOffset + Int32::kSize);
+
+  DISABLE_DEFAULT_OP(DoubleArray)
+};
+
+/// Open-addressing dictionary from String keys to values, laid out like a
+/// SwissTable: a control byte per slot holds either the low 7 bits of the
+/// key hash or an empty/deleted marker, and lookups match 16 control bytes
+/// at a time before touching any key. The first kGroupWidth control bytes are
+/// mirrored past the end so that a group can be loaded at any slot.
+class HashTable : public HeapObject {
  public:
   HashTable* Insert(String* key, Object* value);
 
@@ -327,52 +462,69 @@ class HashTable : public Array {
 
   bool Delete(String* key);
 
-  int ElementsSize() { return Get(kElementsSizeIndex)->ToInt32(); }
+  int Lookup(String* key) { return FindEntry(key, key->Hash()); }
 
-  void SetElementsSize(int elements_size) {
-    assert(elements_size >= 0);
-    Set(kElementsSizeIndex, Int32::Make(elements_size));
-  }
+  Object* KeyAt(int entry);
 
-  int Capacity() { return Get(kCapacityIndex)->ToInt32(); }
+  Object* ValueAt(int entry);
 
-  void SetCapacity(int capacity) {
-    assert(capacity > ElementsSize());
-    Set(kCapacityIndex, Int32::Make(capacity));
-  }
+  void SetValueAt(int entry, Object* value);
+
+  int ElementsSize();
+
+  void SetElementsSize(int elements_size);
+
+  int DeletedSize();
+
+  void SetDeletedSize(int deleted_size);
+
+  int Capacity();
+
+  void SetCapacity(int capacity);
+
+  /// Marks every slot empty.
+  void Clear();
 
   void IterateHashTableBody(ObjectVisitor* visitor);
 
-  static int EnsureSize(int capacity) { return EntryToIndex(capacity); }
+  static int EnsureSize(int capacity) {
+    return EntriesOffset(capacity) + 2 * kPointerSize * capacity;
+  }
+
+  /// Smallest capacity holding `elements_size` elements without growing.
+  static int CapacityFor(int elements_size);
 
   static HashTable* Cast(Object* obj);
 
-  static constexpr int kElementsSizeIndex = 0;
-  static constexpr int kCapacityIndex = 1;
-  static constexpr int kElementsOffsetIndex = 2;
+  static constexpr int kGroupWidth = 16;
+  static constexpr int kElementsSizeOffset = HeapObject::kHeaderSize;
+  static constexpr int kDeletedSizeOffset = kElementsSizeOffset + Int32::kSize;
+  static constexpr int kCapacityOffset = kDeletedSizeOffset + Int32::kSize;
+  static constexpr int kCtrlOffset = kCapacityOffset + Int32::kSize;
 
  private:
-  HashTable* AddElement(int count);
-
-  void ElementAdded() { SetElementsSize(ElementsSize() + 1); }
+  HashTable* Grow();
 
-  void ElementDeleted() { SetElementsSize(ElementsSize() - 1); }
+  void Rehash();
 
-  int FindInsertionIndex(int hash);
+  void InsertNew(int hash, String* key, Object* value);
 
   int FindEntry(String* key, int hash);
 
-  void SetEntry(int index, Object* key, Object* value);
+  int FindInsertionEntry(int hash);
+
+  int8_t* Ctrl();
+
+  void SetCtrl(int entry, int8_t ctrl);
 
-  Object* EntryKeyAt(int index) { return Get(index); }
+  Object** Slot(int entry);
 
-  static constexpr int Location(int hash, int index, int capacity) {
-    return (hash + ((index + index * index) >> 1)) & (capacity - 1);
+  static int MaxElements(int capacity) {
+    return capacity - std::max(1, capacity >> 3);
   }
 
-  static constexpr int EntryToIndex(int entry) {
-    assert(entry >= 0);
-    return kElementsOffsetIndex + entry * 2;
+  static constexpr int EntriesOffset(int capacity) {
+    return Align(kCtrlOffset + capacity + kGroupWidth);
   }
 };
 
@@ -384,28 +536,41 @@ class KSArray : public KSObject {
 
   int32_t Capacity();
 
-  Object* Get(int32_t index);
+  ElementsKind Kind();
 
-  Object* Set(int32_t index, Object* value);
+  Object* Get(int32_t index);
 
-  Array* Elements();
+  HeapObject* Elements();
 
-  void SetElements(Array* elements);
+  void SetElements(HeapObject* elements, ElementsKind kind);
 
   void IterateKSArrayBody(ObjectVisitor* visitor);
 
+  static Object* Set(Handle<KSArray> self, int32_t index,
+                     Handle<Object> value);
+
   static void Push(Handle<KSArray> self, Handle<Object> value);
 
   static KSArray* New(int32_t length, AllocationPolicy policy = NOT_TENURED);
 
+  static KSArray* New(int32_t length, ElementsKind kind,
+                      AllocationPolicy policy = NOT_TENURED);
+
   static KSArray* Cast(Object* obj);
 
+  static ElementsKind KindFor(Object* value);
+
   static constexpr int kLengthOffset = KSObject::kSize;
-  static constexpr int kElementsOffset = kLengthOffset + Int32::kSize;
+  static constexpr int kKindOffset = kLengthOffset + Int32::kSize;
+  static constexpr int kElementsOffset = kKindOffset + Int32::kSize;
   static constexpr int kSize = Align(kElementsOffset + kPointerSize);
 
  private:
+  Object* SetNoGC(int32_t index, Object* value);
+
   void Push(Handle<Object> value);
+
+  void EnsureKind(ElementsKind kind);
 };
 
 class HeapNumber : public HeapObject {
@@ -456,7 +621,9 @@ class Function : public HeapObject {
   static constexpr int kBodyOffset = kParamsOffset + kPointerSize;
   static constexpr int kSize = kBodyOffset + kPointerSize;
 
-  static constexpr int kFunctionTemplateTag = 1;
+  // Native code addresses may be odd, so the tag lives above the canonical
+  // address bits.
+  static constexpr uint64_t kFunctionTemplateTag = 1ULL << 63;
 };
 
 class ObjectVisitor {
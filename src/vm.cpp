@@ -0,0 +1,536 @@
+#include "vm.hh"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <exception>
+#include <new>
+#include <sstream>
+#include "allocator.hh"
+#include "ast.hh"
+#include "compiler.hh"
+#include "context.hh"
+#include "interpreter.hh"
+#include "profiler.hh"
+#include "reference.hh"
+#include "value.hh"
+#if defined(KIPPER_JIT)
+#include "jit.hh"
+#endif
+
+using namespace kipper::internal;
+
+Object** VM::stack_{nullptr};
+Object** VM::stack_top_{nullptr};
+Context* VM::contexts_{nullptr};
+Context* VM::contexts_top_{nullptr};
+
+void VM::ReserveStacks() {
+  if (stack_ == nullptr) {
+    stack_ = static_cast<Object**>(
+        Allocator::AllocateArray(kPointerSize, kStackSize));
+    stack_top_ = stack_;
+    contexts_ = static_cast<Context*>(
+        Allocator::AllocateArray(sizeof(Context), kContextStackSize));
+    contexts_top_ = contexts_;
+  }
+}
+
+VM::Window::Window(int32_t size) {
+  ReserveStacks();
+  if (stack_top_ + size > stack_ + kStackSize) {
+    throw KSStackOverflowError{};
+  }
+  slots_ = stack_top_;
+  std::fill(slots_, slots_ + size, Constant::Undefined());
+  stack_top_ += size;
+}
+
+/// Registers and block Contexts of one Execute() call, both sized at compile
+/// time. They are released on return and when an exception unwinds.
+class VM::Frame {
+ public:
+  Frame(Execution& exec, Bytecode* bytecode)
+      : exec_{exec}, context_{exec.context()}, bytecode_{bytecode} {
+    ReserveStacks();
+    auto register_count = bytecode->register_count;
+    if (stack_top_ + register_count > stack_ + kStackSize ||
+        contexts_top_ + bytecode->block_depth > contexts_ + kContextStackSize) {
+      throw KSStackOverflowError{};
+    }
+    registers_ = stack_top_;
+    std::fill(registers_, registers_ + register_count, Constant::Undefined());
+    stack_top_ += register_count;
+    blocks_ = contexts_top_;
+    contexts_top_ += bytecode->block_depth;
+  }
+
+  ~Frame() {
+    while (exec_.context_ != context_) {
+      PopContext();
+    }
+    stack_top_ = registers_;
+    contexts_top_ = blocks_;
+  }
+
+  Execution& exec() const { return exec_; }
+
+  Bytecode* bytecode() const { return bytecode_; }
+
+  Object** registers() const { return registers_; }
+
+  void set_exception(std::exception_ptr exception) { exception_ = exception; }
+
+  /// The Context of the function (or script) the frame runs, which holds the
+  /// slots resolved by the ScopeAnalyzer.
+  Context* FunctionContext() const { return context_; }
+
+  void EnterBlock() { block_depth_++; }
+
+  void ExitBlock() {
+    auto block = 1ULL << --block_depth_;
+    if (materialized_blocks_ & block) {
+      materialized_blocks_ &= ~block;
+      PopContext();
+    }
+  }
+
+  /// Returns the Context new variables belong to, which is the innermost
+  /// block's one.
+  Context* CurrentContext() {
+    if (block_depth_ > 0) {
+      auto block = 1ULL << (block_depth_ - 1);
+      if (!(materialized_blocks_ & block)) {
+        materialized_blocks_ |= block;
+        exec_.context_ = new (blocks_ + block_depth_ - 1)
+            Context{exec_.context_};
+      }
+    }
+    return exec_.context_;
+  }
+
+#if defined(KIPPER_JIT)
+  /// Continues the frame in machine code from the instruction at `pc`.
+  Object* RunMachineCode(MachineCode* machine_code, int32_t pc) {
+    auto result =
+        machine_code->Run(registers_, this, context_->InlineSlots(), pc);
+    if (result == nullptr) {
+      std::rethrow_exception(exception_);
+    }
+    return result;
+  }
+
+  /// Runs the trace of a loop of the frame, returns the bytecode offset to
+  /// continue at.
+  int32_t RunTrace(MachineCode* trace) {
+    auto offset = trace->RunTrace(registers_, this, context_->InlineSlots());
+    if (offset < 0) {
+      std::rethrow_exception(exception_);
+    }
+    return offset;
+  }
+#endif
+
+  DISABLE_DEFAULT_OP(Frame)
+ private:
+  void PopContext() {
+    auto context = exec_.context_;
+    exec_.context_ = context->parent();
+    context->~Context();
+  }
+
+  Execution& exec_;
+  Context* context_;
+  Bytecode* bytecode_;
+  std::exception_ptr exception_;
+  Object** registers_;
+  Context* blocks_;
+  uint64_t materialized_blocks_{0};
+  int block_depth_{0};
+};
+
+// The slow paths below need HandleScopes. They live outside of
+// VM::Execute() since leaving a scope through a computed goto skips the
+// destructors of its locals. Operands are passed as register slots, which
+// are roots already, so that wrapping them in a Handle allocates nothing.
+
+static Object* LoadProperty(MemberAccess* node, Execution& exec,
+                            Object** object, Object** key) {
+  HandleScope handle_scope;
+  return Reference{node, exec, Handle{object}, Handle{key}}.GetValue().Get();
+}
+
+static void StoreProperty(MemberAccess* node, Execution& exec,
+                          Object** object, Object** key, Object** value) {
+  HandleScope handle_scope;
+  Reference{node, exec, Handle{object}, Handle{key}}.SetValue(Handle{value});
+}
+
+static Object* Concat(Object** left, Object** right) {
+  HandleScope handle_scope;
+  return Interpreter::Add(Handle{left}, Handle{right}).Get();
+}
+
+static Object* CreateArray(Object** elements, int32_t count) {
+  auto kind = PACKED_INT32_ELEMENTS;
+  for (int32_t i = 0; i < count; i++) {
+    kind = std::max(kind, KSArray::KindFor(elements[i]));
+  }
+  HandleScope handle_scope;
+  auto result = Handle{KSArray::New(count, kind)};
+  for (int32_t i = 0; i < count; i++) {
+    KSArray::Set(result, i, Handle{elements + i});
+  }
+  return result.Get();
+}
+
+static Object* CreateObject(Object** properties, int32_t count) {
+  HandleScope handle_scope;
+  auto result = Handle{KSObject::New(count)};
+  for (int32_t i = 0; i < count; i++) {
+    KSObject::SetProperty(result, Handle{properties + i * 2},
+                          Handle{properties + i * 2 + 1});
+  }
+  return result.Get();
+}
+
+static Object* CallFunction(FunctionCall* call, Execution& exec,
+                            Object** callee, Object** self, Object** args,
+                            int32_t argc) {
+  if (!(*callee)->IsFunction()) {
+    throw KSNotFunctionError{call->target->loc, "is not a function"};
+  }
+  HandleScope handle_scope;
+  Profiler::SetLocation(&call->loc);
+  auto fn = Handle{callee};
+  auto self_handle = self ? Handle{self} : Handle<Object>{};
+  Handle<Object> result;
+  try {
+    if (Interpreter::IsAssert(fn.Get())) {
+      VM::Window argv{argc + 1};
+      std::copy(args, args + argc, argv.slots());
+      std::stringstream loc;
+      loc << Compiler::Resolve(call->args[0]->loc);
+      argv[argc] = String::New(loc.str(), TENURED);
+      result = exec.interpreter()->Call(self_handle, fn, argv.slots(),
+                                        argc + 1, exec.context());
+    } else {
+      result = exec.interpreter()->Call(self_handle, fn, args, argc,
+                                        exec.context());
+    }
+  } catch (const KSNotFunctionError&) {
+    throw KSNotFunctionError{call->target->loc, "is not a function"};
+  }
+  return result ? result.Get() : Constant::Undefined();
+}
+
+static void DeclareFunction(FunctionDecl* fn_decl, Execution& exec) {
+  HandleScope handle_scope;
+  fn_decl->Evaluate(exec);
+}
+
+#define REG(index) registers[pc[index]]
+#define CONSTANT(index) frame.bytecode()->constants[pc[index]].Get()
+#define NODE(T, index) static_cast<T*>(frame.bytecode()->nodes[pc[index]])
+
+// The semantics of the straight-line bytecodes, shared by the interpreter
+// loop and the stubs machine code calls. Not every handler reads the frame
+// or the registers.
+#define STRAIGHT_LINE_BYTECODE(name)                          \
+  static ALWAYS_INLINE void name##Bytecode(                   \
+      [[maybe_unused]] VM::Frame& frame,                      \
+      [[maybe_unused]] Object** registers,                    \
+      [[maybe_unused]] const int32_t* pc)
+
+#define BINARY_NUMBER_OP(int32_op, op)                                  \
+  if (!Int32::Both(REG(2), REG(3)) ||                                   \
+      !Int32::int32_op(REG(2), REG(3), &REG(1))) {                      \
+    REG(1) = Double::MakeFit(REG(2)->ToDouble() op REG(3)->ToDouble()); \
+  }
+
+#define COMPARE_OP(op)                                                    \
+  if (Int32::Both(REG(2), REG(3))) {                                      \
+    REG(1) = Constant::Boolean(Int32::ValueOf(REG(2))                     \
+                                   op Int32::ValueOf(REG(3)));            \
+  } else {                                                                \
+    REG(1) = Constant::Boolean(REG(2)->ToDouble() op REG(3)->ToDouble()); \
+  }
+
+STRAIGHT_LINE_BYTECODE(LoadConstant) { REG(1) = CONSTANT(2); }
+
+STRAIGHT_LINE_BYTECODE(Move) { REG(1) = REG(2); }
+
+STRAIGHT_LINE_BYTECODE(LoadName) {
+  auto slot = frame.exec().context()->Resolve(String::Cast(CONSTANT(2)));
+  REG(1) = slot ? slot.Get() : Constant::Undefined();
+}
+
+STRAIGHT_LINE_BYTECODE(StoreName) {
+  auto name = String::Cast(CONSTANT(1));
+  if (auto slot = frame.exec().context()->Resolve(name)) {
+    *slot.location() = REG(2);
+  } else {
+    frame.CurrentContext()->Push(name, REG(2));
+  }
+}
+
+STRAIGHT_LINE_BYTECODE(LoadLocal) {
+  REG(1) = frame.FunctionContext()->Slot(pc[2]).Get();
+}
+
+STRAIGHT_LINE_BYTECODE(StoreLocal) {
+  *frame.FunctionContext()->Slot(pc[1]).location() = REG(2);
+}
+
+STRAIGHT_LINE_BYTECODE(LoadProperty) {
+  auto object = REG(2);
+  auto key = REG(3);
+  if (object->IsKSArray() && key->IsInt32()) {
+    REG(1) = KSArray::Cast(object)->Get(Int32::Cast(key)->Value());
+  } else {
+    REG(1) =
+        LoadProperty(NODE(MemberAccess, 4), frame.exec(), &REG(2), &REG(3));
+  }
+}
+
+STRAIGHT_LINE_BYTECODE(StoreProperty) {
+  StoreProperty(NODE(MemberAccess, 4), frame.exec(), &REG(1), &REG(2),
+                &REG(3));
+}
+
+STRAIGHT_LINE_BYTECODE(Add) {
+  auto left = REG(2);
+  auto right = REG(3);
+  if (Int32::Both(left, right) && Int32::Add(left, right, &REG(1))) {
+    return;
+  }
+  if (left->IsString() || right->IsString()) {
+    REG(1) = Concat(&REG(2), &REG(3));
+  } else {
+    REG(1) = Double::MakeFit(left->ToDouble() + right->ToDouble());
+  }
+}
+
+STRAIGHT_LINE_BYTECODE(Sub) { BINARY_NUMBER_OP(Sub, -); }
+
+STRAIGHT_LINE_BYTECODE(Mul) { BINARY_NUMBER_OP(Mul, *); }
+
+STRAIGHT_LINE_BYTECODE(Div) {
+  REG(1) = Double::MakeFit(REG(2)->ToDouble() / REG(3)->ToDouble());
+}
+
+STRAIGHT_LINE_BYTECODE(Mod) {
+  if (!Int32::Both(REG(2), REG(3)) || !Int32::Mod(REG(2), REG(3), &REG(1))) {
+    REG(1) = Double::MakeFit(fmod(REG(2)->ToDouble(), REG(3)->ToDouble()));
+  }
+}
+
+STRAIGHT_LINE_BYTECODE(Equal) {
+  REG(1) = Constant::Boolean(REG(2)->Equals(REG(3)));
+}
+
+STRAIGHT_LINE_BYTECODE(NotEqual) {
+  REG(1) = Constant::Boolean(!REG(2)->Equals(REG(3)));
+}
+
+STRAIGHT_LINE_BYTECODE(LessThan) { COMPARE_OP(<); }
+
+STRAIGHT_LINE_BYTECODE(GreaterThan) { COMPARE_OP(>); }
+
+STRAIGHT_LINE_BYTECODE(LessThanOrEqual) { COMPARE_OP(<=); }
+
+STRAIGHT_LINE_BYTECODE(GreaterThanOrEqual) { COMPARE_OP(>=); }
+
+STRAIGHT_LINE_BYTECODE(LogicalOr) {
+  REG(1) = Constant::Boolean(REG(2)->ToBoolean()->IsTrue() ||
+                             REG(3)->ToBoolean()->IsTrue());
+}
+
+STRAIGHT_LINE_BYTECODE(LogicalAnd) {
+  REG(1) = Constant::Boolean(REG(2)->ToBoolean()->IsTrue() &&
+                             REG(3)->ToBoolean()->IsTrue());
+}
+
+STRAIGHT_LINE_BYTECODE(LogicalNot) {
+  REG(1) = Constant::Boolean(!REG(2)->IsTrue());
+}
+
+STRAIGHT_LINE_BYTECODE(Negate) {
+  REG(1) = Double::Make(-REG(2)->ToDouble());
+}
+
+STRAIGHT_LINE_BYTECODE(ToNumber) { REG(1) = REG(2)->ToNumber(); }
+
+STRAIGHT_LINE_BYTECODE(Increment) {
+  REG(1) = Interpreter::Increment(REG(2), 1);
+}
+
+STRAIGHT_LINE_BYTECODE(Decrement) {
+  REG(1) = Interpreter::Increment(REG(2), -1);
+}
+
+STRAIGHT_LINE_BYTECODE(CreateArray) {
+  REG(1) = CreateArray(registers + pc[2], pc[3]);
+}
+
+STRAIGHT_LINE_BYTECODE(CreateObject) {
+  REG(1) = CreateObject(registers + pc[2], pc[3]);
+}
+
+STRAIGHT_LINE_BYTECODE(Call) {
+  auto self = pc[3] == Bytecode::kNoRegister ? nullptr : &REG(3);
+  REG(1) = CallFunction(NODE(FunctionCall, 6), frame.exec(), &REG(2), self,
+                        registers + pc[4], pc[5]);
+}
+
+STRAIGHT_LINE_BYTECODE(DeclareFunction) {
+  DeclareFunction(NODE(FunctionDecl, 1), frame.exec());
+}
+
+STRAIGHT_LINE_BYTECODE(EnterBlock) { frame.EnterBlock(); }
+
+STRAIGHT_LINE_BYTECODE(ExitBlock) { frame.ExitBlock(); }
+
+template <void (*bytecode)(VM::Frame&, Object**, const int32_t*)>
+static bool Stub(VM::Frame* frame, const int32_t* pc) {
+  try {
+    bytecode(*frame, frame->registers(), pc);
+    return true;
+  } catch (...) {
+    frame->set_exception(std::current_exception());
+    return false;
+  }
+}
+
+VM::Stub VM::StubFor(Opcode opcode) {
+  static constexpr Stub kStubs[] = {
+#define STUB_ADDRESS(name, operands) &::Stub<name##Bytecode>,
+      STRAIGHT_LINE_BYTECODE_LIST(STUB_ADDRESS)
+#undef STUB_ADDRESS
+  };
+  assert(static_cast<size_t>(opcode) < std::size(kStubs));
+  return kStubs[static_cast<int32_t>(opcode)];
+}
+
+#if defined(KIPPER_JIT)
+/// Interprets the loop starting at `header` while a TraceRecorder records
+/// it, returns the instruction to continue at once the recorder stops.
+static int32_t* RecordTrace(VM::Frame& frame, int32_t* header,
+                            LoopTrace* loop) {
+  auto registers = frame.registers();
+  auto locals = frame.FunctionContext()->InlineSlots();
+  auto code = frame.bytecode()->code.data();
+  TraceRecorder recorder{frame.bytecode(), loop};
+  auto pc = header;
+  while (recorder.Record(pc, registers, locals)) {
+    switch (static_cast<Opcode>(*pc)) {
+#define RECORD(name, operands)            \
+  case Opcode::name:                      \
+    name##Bytecode(frame, registers, pc); \
+    pc += (operands) + 1;                 \
+    break;
+      STRAIGHT_LINE_BYTECODE_LIST(RECORD)
+#undef RECORD
+      case Opcode::Jump:
+        pc = code + pc[1];
+        break;
+      case Opcode::JumpIfNotTrue:
+        pc = REG(1)->IsTrue() ? pc + 3 : code + pc[2];
+        break;
+      case Opcode::JumpIfToBooleanFalse:
+        pc = REG(1)->ToBoolean()->IsTrue() ? pc + 3 : code + pc[2];
+        break;
+      case Opcode::Return:
+        UNREACHABLE();  // the recorder stops at returns
+    }
+  }
+  return pc;
+}
+#endif
+
+#define JUMP_IF(condition) \
+  if (condition) {         \
+    pc = code + pc[2];     \
+  } else {                 \
+    pc += 3;               \
+  }                        \
+  DISPATCH()
+
+#if defined(__GNUC__)
+#define DISPATCH() goto* kDispatchTable[*pc]
+#define BYTECODE(name) name##Label:
+#else
+#define DISPATCH() goto dispatch
+#define BYTECODE(name) case Opcode::name:
+#endif
+
+#define NEXT(operands)  \
+  pc += (operands) + 1; \
+  DISPATCH()
+
+Object* VM::Execute(Bytecode* bytecode, Execution& exec) {
+  Frame frame{exec, bytecode};
+#if defined(KIPPER_JIT)
+  if (auto machine_code = Jit::Tick(bytecode)) {
+    return frame.RunMachineCode(machine_code, 0);
+  }
+#endif
+  auto registers = frame.registers();
+  auto code = bytecode->code.data();
+  auto pc = code;
+
+#if defined(__GNUC__)
+  static void* const kDispatchTable[] = {
+#define LABEL_ADDRESS(name, operands) &&name##Label,
+      BYTECODE_LIST(LABEL_ADDRESS)
+#undef LABEL_ADDRESS
+  };
+  DISPATCH();
+#else
+dispatch:
+  switch (static_cast<Opcode>(*pc)) {
+#endif
+
+#define INTERPRET(name, operands)         \
+  BYTECODE(name) {                        \
+    name##Bytecode(frame, registers, pc); \
+    NEXT(operands);                       \
+  }
+  STRAIGHT_LINE_BYTECODE_LIST(INTERPRET)
+#undef INTERPRET
+
+  BYTECODE(Jump) {
+#if defined(KIPPER_JIT)
+    // A loop back edge, hot loops continue on a trace or in machine code.
+    if (pc[1] < pc - code) {
+      if (auto loop = Tracer::Tick(bytecode, pc[1])) {
+        pc = loop->code ? code + frame.RunTrace(loop->code.get())
+                        : RecordTrace(frame, code + pc[1], loop);
+        DISPATCH();
+      }
+      if (auto machine_code = Jit::Tick(bytecode)) {
+        return frame.RunMachineCode(machine_code, pc[1]);
+      }
+    }
+#endif
+    pc = code + pc[1];
+    DISPATCH();
+  }
+
+  BYTECODE(JumpIfNotTrue) { JUMP_IF(!REG(1)->IsTrue()); }
+
+  BYTECODE(JumpIfToBooleanFalse) { JUMP_IF(!REG(1)->ToBoolean()->IsTrue()); }
+
+  BYTECODE(Return) { return REG(1); }
+
+#if !defined(__GNUC__)
+  }
+#endif
+  UNREACHABLE();
+  return nullptr;
+}
+
+void VM::IterateStack(ObjectVisitor* visitor) {
+  for (auto slot = stack_; slot != stack_top_; slot++) {
+    visitor->Visit(slot);
+  }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "bytecode.hh"
+#include "handle.hh"
+#include "kipper.hh"
+
+namespace kipper {
+namespace internal {
+
+class Context;
+class Execution;
+class ObjectVisitor;
+
+/// Executes Bytecode on a register stack shared by all frames.
+///
+/// Registers are GC roots. Each frame also reserves one Context per block
+/// nesting level on a context stack, a block only constructs its Context
+/// there once a variable is pushed into it. Entering and leaving blocks thus
+/// never allocates.
+class VM : public AllStatic {
+ public:
+  class Frame;
+
+  static Object* Execute(Bytecode* bytecode, Execution& exec);
+
+  /// Runs the straight-line bytecode at `pc` for machine code, which cannot
+  /// unwind exceptions. Returns false if the bytecode threw, the exception is
+  /// then kept in `frame`.
+  using Stub = bool (*)(Frame* frame, const int32_t* pc);
+
+  static Stub StubFor(Opcode opcode);
+
+  static void IterateStack(ObjectVisitor* visitor);
+
+  static constexpr int kStackSize = 128 * KB;
+  static constexpr int kContextStackSize = 8 * KB;
+
+  /// Reserves `size` GC-scanned slots on top of the register stack, which is
+  /// how calls pass their arguments. Windows and frames nest strictly.
+  class Window {
+   public:
+    explicit Window(int32_t size);
+
+    ~Window() { stack_top_ = slots_; }
+
+    Object*& operator[](int32_t index) { return slots_[index]; }
+
+    Object** slots() const { return slots_; }
+
+    DISABLE_DEFAULT_OP(Window)
+   private:
+    Object** slots_;
+  };
+
+ private:
+  static void ReserveStacks();
+
+  static Object** stack_;
+  static Object** stack_top_;
+  static Context* contexts_;
+  static Context* contexts_top_;
+};
+
+class KSStackOverflowError : public KError {
+ public:
+  KSStackOverflowError() : KError{"stack overflow"} {}
+};
+
+}  // namespace internal
+}  // namespace kipper
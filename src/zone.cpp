@@ -0,0 +1,35 @@
+#include "zone.hh"
+#include <algorithm>
+#include "allocator.hh"
+
+using namespace kipper::internal;
+
+Zone::~Zone() {
+  for (auto finalizer = finalizers_; finalizer;) {
+    auto next = finalizer->next;
+    finalizer->destroy(finalizer + 1);
+    finalizer = next;
+  }
+  for (auto segment = segments_; segment;) {
+    auto next = segment->next;
+    Allocator::Deallocate(segment, segment->size);
+    segment = next;
+  }
+}
+
+// Segments double in size up to kMaxSegmentSize, larger requests get a
+// segment of their own.
+void* Zone::AllocateSegment(size_t size) {
+  constexpr auto kHeaderSize =
+      (sizeof(Segment) + kAlignment - 1) & ~(kAlignment - 1);
+  auto segment_size = std::clamp(size_ * 2, kMinSegmentSize, kMaxSegmentSize);
+  segment_size = std::max(segment_size, kHeaderSize + size);
+  auto segment = static_cast<Segment*>(Allocator::Allocate(segment_size));
+  segment->next = segments_;
+  segment->size = segment_size;
+  segments_ = segment;
+  size_ += segment_size;
+  position_ = reinterpret_cast<char*>(segment) + kHeaderSize + size;
+  limit_ = reinterpret_cast<char*>(segment) + segment_size;
+  return reinterpret_cast<char*>(segment) + kHeaderSize;
+}
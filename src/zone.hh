@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "kipper.hh"
+
+namespace kipper {
+namespace internal {
+
+/// A bump allocator for objects that die together, such as the nodes of an
+/// AST. Destroying the zone runs the destructors of its objects, latest
+/// first, and frees its memory at once.
+class Zone {
+ public:
+  Zone() = default;
+
+  ~Zone();
+
+  Zone(const Zone&) = delete;
+  Zone& operator=(const Zone&) = delete;
+
+  template <class T, class... Args>
+  T* New(Args&&... args) {
+    static_assert(alignof(T) <= kAlignment);
+    if constexpr (std::is_trivially_destructible_v<T>) {
+      return new (Allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    } else {
+      auto finalizer =
+          static_cast<Finalizer*>(Allocate(sizeof(Finalizer) + sizeof(T)));
+      auto object = new (finalizer + 1) T(std::forward<Args>(args)...);
+      finalizer->destroy = [](void* p) { static_cast<T*>(p)->~T(); };
+      finalizer->next = finalizers_;
+      finalizers_ = finalizer;
+      return object;
+    }
+  }
+
+  void* Allocate(size_t size) {
+    size = (size + kAlignment - 1) & ~(kAlignment - 1);
+    if (static_cast<size_t>(limit_ - position_) < size) {
+      return AllocateSegment(size);
+    }
+    auto result = position_;
+    position_ += size;
+    return result;
+  }
+
+  /// Bytes of the segments allocated so far.
+  size_t size() const { return size_; }
+
+ private:
+  struct Segment {
+    Segment* next;
+    size_t size;
+  };
+
+  struct Finalizer {
+    Finalizer* next;
+    void (*destroy)(void*);
+  };
+
+  static constexpr size_t kAlignment = 8;
+  static constexpr size_t kMinSegmentSize = 8 * KB;
+  static constexpr size_t kMaxSegmentSize = 1 * MB;
+
+  void* AllocateSegment(size_t size);
+
+  char* position_{nullptr};
+  char* limit_{nullptr};
+  Segment* segments_{nullptr};
+  Finalizer* finalizers_{nullptr};
+  size_t size_{0};
+};
+
+}  // namespace internal
+}  // namespace kipper
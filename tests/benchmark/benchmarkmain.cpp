@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "kipper/kipper.hh"
+
+void print_usage() {
+  std::cout << "Usage: ksbench [--ast] [--no-opt] [--no-jit] [--no-trace] "
+               "[--runs <n>] [--parse <megabytes>] "
+               "[--parse-numbers <megabytes>] <source file>..."
+            << std::endl;
+}
+
+int read_file(std::string_view file, std::string& kscript) {
+  std::ifstream istrm{file.data(), std::ios::in | std::ios::ate};
+  if (!istrm.is_open()) {
+    std::cerr << "failed to open " << file << '\n';
+    return 1;
+  }
+  auto length = istrm.tellg();
+  kscript.resize(length);
+  istrm.seekg(0, std::ios::beg);
+  istrm.read(&kscript[0], length);
+  return 0;
+}
+
+/// Runs `file` `runs` times and prints the best and the median wall time.
+int bench_script(std::string_view file, int runs) {
+  std::string kscript;
+  if (auto rcode = read_file(file, kscript)) {
+    return rcode;
+  }
+  try {
+    auto script = kipper::Script::Compile(kscript, file);
+    std::vector<double> times;
+    for (int i = 0; i < runs; i++) {
+      auto start = std::chrono::steady_clock::now();
+      script->Run(kipper::Kipper::GlobalContext());
+      std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - start;
+      times.push_back(elapsed.count());
+    }
+    std::sort(times.begin(), times.end());
+    std::cout << file << ": best " << times.front() << " ms, median "
+              << times[times.size() / 2] << " ms (" << runs << " runs)"
+              << std::endl;
+    return 0;
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+  }
+  return 1;
+}
+
+constexpr double MB = 1024 * 1024;
+
+/// Generates about `megabytes` MB of functions dense in expressions of all
+/// precedences, the way a minified bundle would be.
+std::string generate_script(int megabytes) {
+  std::string kscript;
+  for (int i = 0; kscript.size() < megabytes * MB; i++) {
+    auto n = std::to_string(i);
+    kscript += "function f" + n + "(a, b, c) {\n";
+    kscript += "  x = a * " + n + " + b / 2 - c % 7 * (a - " + n + ")\n";
+    kscript += "  if (x < b == !c != (a >= " + n + ")) {\n";
+    kscript += "    y = -x + (a + b) * c[" + n + "].z - o.p.q(x, 1)\n";
+    kscript += "  } else {\n";
+    kscript += "    y = x > 0 ? a + 1 : b <= c ? -b : {k: [x, " + n + "]}\n";
+    kscript += "  }\n";
+    kscript += "  return y + f" + n + "(a + 1, b * 2, \"" + n + "\")\n";
+    kscript += "}\n";
+  }
+  return kscript;
+}
+
+/// Generates about `megabytes` MB of array literals of numbers in every
+/// notation, the way a data file would be.
+std::string generate_numbers(int megabytes) {
+  std::string kscript;
+  for (int i = 0; kscript.size() < megabytes * MB; i++) {
+    auto n = std::to_string(i);
+    kscript += "row" + n + " = [" + n + ", " + n + ".25, 0." + n + ", " + n +
+               "e-3, 6.02e23, 0x" + n + ", 4294967296" + n + ", " + n +
+               "." + n + "]\n";
+  }
+  return kscript;
+}
+
+/// Compiles `kscript` `runs` times and prints the best compile time and its
+/// throughput.
+int bench_parse(const std::string& kscript, int runs) {
+  try {
+    std::vector<double> times;
+    for (int i = 0; i < runs; i++) {
+      auto start = std::chrono::steady_clock::now();
+      auto script = kipper::Script::Compile(kscript, "generated.ks");
+      std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - start;
+      times.push_back(elapsed.count());
+    }
+    std::sort(times.begin(), times.end());
+    std::cout << "parse " << kscript.size() / 1024 << " KB: best "
+              << times.front() << " ms, median " << times[times.size() / 2]
+              << " ms, " << kscript.size() / MB / (times.front() / 1000)
+              << " MB/s (" << runs << " runs)" << std::endl;
+    return 0;
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+  }
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  auto bytecode = true;
+  auto optimize = true;
+  auto jit_threshold = kipper::KipperConfig{}.jit_threshold;
+  auto trace_threshold = kipper::KipperConfig{}.trace_threshold;
+  auto runs = 5;
+  auto parse_megabytes = 0;
+  auto number_megabytes = 0;
+  std::vector<std::string_view> files;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg{argv[i]};
+    if (arg == "--ast") {
+      bytecode = false;
+    } else if (arg == "--no-opt") {
+      optimize = false;
+    } else if (arg == "--no-jit") {
+      jit_threshold = -1;
+      trace_threshold = -1;
+    } else if (arg == "--no-trace") {
+      trace_threshold = -1;
+    } else if (arg == "--runs" && i + 1 < argc) {
+      runs = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--parse" && i + 1 < argc) {
+      parse_megabytes = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--parse-numbers" && i + 1 < argc) {
+      number_megabytes = std::max(1, std::atoi(argv[++i]));
+    } else {
+      files.push_back(arg);
+    }
+  }
+  if (files.empty() && parse_megabytes == 0 && number_megabytes == 0) {
+    print_usage();
+    return 1;
+  }
+
+  kipper::Kipper::Configure(
+      {0, 0, bytecode, optimize, jit_threshold, trace_threshold});
+  kipper::Kipper::Initialize();
+  if (parse_megabytes > 0) {
+    if (auto rcode = bench_parse(generate_script(parse_megabytes), runs)) {
+      return rcode;
+    }
+  }
+  if (number_megabytes > 0) {
+    if (auto rcode = bench_parse(generate_numbers(number_megabytes), runs)) {
+      return rcode;
+    }
+  }
+  for (auto file : files) {
+    if (auto rcode = bench_script(file, runs)) {
+      return rcode;
+    }
+  }
+  return 0;
+}
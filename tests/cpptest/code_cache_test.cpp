@@ -0,0 +1,136 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "unittest.hh"
+
+using namespace kipper;
+
+namespace fs = std::filesystem;
+
+class CodeCacheTest : public ::testing::Test {
+ protected:
+  CodeCacheTest() {
+    directory_ = fs::temp_directory_path() / "ks-code-cache-test";
+    fs::remove_all(directory_);
+    KipperConfig config{0, 0};
+    config.code_cache_dir = directory_.c_str();
+    Kipper::Configure(config);
+    Kipper::Initialize();
+  }
+
+  ~CodeCacheTest() override {
+    Kipper::Configure(KipperConfig{0, 0});
+    fs::remove_all(directory_);
+  }
+
+  fs::path Entry() {
+    fs::path entry;
+    for (auto& file : fs::directory_iterator{directory_}) {
+      EXPECT_TRUE(entry.empty());
+      entry = file.path();
+    }
+    return entry;
+  }
+
+  fs::path directory_;
+};
+
+static constexpr std::string_view kScript =
+    "function sum(n, i, s) {\n"
+    "  s = 0\n"
+    "  for (i = 0; i < n; i++) {\n"
+    "    if (i % 2 == 0) {\n"
+    "      s = s + i * 1.5\n"
+    "    } else {\n"
+    "      s = s - arguments_[0]\n"
+    "    }\n"
+    "  }\n"
+    "  return s\n"
+    "}\n"
+    "o = {a: \"x\", \"b\": [1, 2, 0x10]}\n"
+    "result = o[\"a\"] == \"x\" ? sum(10) + o.b[2] : 0\n"
+    "undefined_function()\n";
+
+TEST_F(CodeCacheTest, ReusesCompiledScript) {
+  std::string errors[2];
+  double results[2];
+  for (int run = 0; run < 2; run++) {
+    auto script = Script::Compile(kScript, "cached.ks");
+    auto entry = Entry();
+    ASSERT_FALSE(entry.empty());
+    if (run == 0) {
+      // A hit leaves the entry alone.
+      fs::last_write_time(entry, fs::file_time_type{});
+    } else {
+      EXPECT_EQ(fs::last_write_time(entry), fs::file_time_type{});
+    }
+    // Declared here so that the script assigns it rather than a local.
+    Kipper::GlobalContext()->Push("result", Number::New(0));
+    try {
+      script->Run(Kipper::GlobalContext());
+    } catch (const std::exception& e) {
+      errors[run] = e.what();
+    }
+    results[run] =
+        Kipper::GlobalContext()->Resolve("result")->ToNumber()->Double();
+  }
+  EXPECT_EQ(results[0], -4);
+  EXPECT_EQ(results[1], -4);
+  EXPECT_EQ(errors[0], "cached.ks:14.1-18: is not a function");
+  EXPECT_EQ(errors[1], errors[0]);
+}
+
+TEST_F(CodeCacheTest, RecompilesDamagedEntry) {
+  Script::Compile(kScript, "damaged.ks");
+  auto entry = Entry();
+  auto size = fs::file_size(entry);
+  fs::resize_file(entry, size / 2);
+  auto script = Script::Compile(kScript, "damaged.ks");
+  EXPECT_EQ(fs::file_size(entry), size);
+  EXPECT_THROW(script->Run(Kipper::GlobalContext()), std::exception);
+}
+
+static std::string ReadEntry(const fs::path& entry) {
+  std::stringstream data;
+  data << std::ifstream{entry, std::ios::binary}.rdbuf();
+  return data.str();
+}
+
+TEST_F(CodeCacheTest, RecompilesEntryWithDamagedSlot) {
+  // Lazy function bodies are stored as source ranges, without slots.
+  KipperConfig config{0, 0};
+  config.code_cache_dir = directory_.c_str();
+  config.lazy_parsing = false;
+  Kipper::Configure(config);
+  // Both scripts only differ in the slot their returned identifier resolves
+  // to, apart from the source hash in the entry header.
+  constexpr std::string_view kFirst =
+      "function f(a, b) {\n  return a\n}\nresult = f(3, 4)\n";
+  constexpr std::string_view kSecond =
+      "function f(a, b) {\n  return b\n}\nresult = f(3, 4)\n";
+  Script::Compile(kSecond, "slot.ks");
+  auto second = ReadEntry(Entry());
+  fs::remove(Entry());
+  Script::Compile(kFirst, "slot.ks");
+  auto entry = Entry();
+  auto first = ReadEntry(entry);
+  ASSERT_EQ(first.size(), second.size());
+  auto slot = first.size();
+  while (slot > 0 && first[slot - 1] == second[slot - 1]) {
+    slot--;
+  }
+  ASSERT_GT(slot--, 0u);
+
+  // Damages the slot, then the depth before it.
+  for (auto offset : {slot, slot - 1}) {
+    auto damaged = first;
+    damaged[offset] = 0x10;
+    std::ofstream{entry, std::ios::binary} << damaged;
+    Kipper::GlobalContext()->Push("result", Number::New(0));
+    Script::Compile(kFirst, "slot.ks")->Run(Kipper::GlobalContext());
+    EXPECT_EQ(
+        Kipper::GlobalContext()->Resolve("result")->ToNumber()->Double(), 3);
+    EXPECT_EQ(ReadEntry(entry), first);
+  }
+}
@@ -0,0 +1,49 @@
+#include <string>
+#include "unittest.hh"
+
+using namespace kipper;
+
+class CompileTaskTest : public ::testing::Test {
+ protected:
+  CompileTaskTest() { Kipper::Initialize(); }
+};
+
+static constexpr std::string_view kScript =
+    "function scale(list, factor, i) {\n"
+    "  for (i = 0; i < list.length; i++) {\n"
+    "    list[i] = list[i] * factor\n"
+    "  }\n"
+    "  return list\n"
+    "}\n"
+    "o = {name: \"async\", \"values\": scale([1, 2.5, 0x10], 2)}\n"
+    "result = o.name == \"async\" ? o.values[0] + o.values[1] + o.values[2] "
+    ": 0\n";
+
+TEST_F(CompileTaskTest, CompilesWhileScriptsRun) {
+  auto global = Kipper::GlobalContext();
+  global->Push("result", Number::New(0));
+  global->Push("busy", Number::New(0));
+  auto task = Script::CompileAsync(kScript, "async.ks");
+  // Keeps the heap busy meanwhile, allocating and collecting.
+  Script::Compile(
+      "for (i = 0; i < 2000; i++) {\n"
+      "  busy = busy + [i, \"x\" + i].length\n"
+      "}\n",
+      "busy.ks")
+      ->Run(global);
+  auto script = task->Finish();
+  EXPECT_TRUE(task->IsDone());
+  script->Run(global);
+  EXPECT_EQ(global->Resolve("result")->ToNumber()->Double(), 39);
+  EXPECT_EQ(global->Resolve("busy")->ToNumber()->Double(), 4000);
+}
+
+TEST_F(CompileTaskTest, ThrowsSyntaxErrorFromFinish) {
+  auto task = Script::CompileAsync("a = (1 + \n", "broken.ks");
+  try {
+    task->Finish();
+    FAIL() << "expected a syntax error";
+  } catch (const std::exception& e) {
+    EXPECT_EQ(std::string{e.what()}.rfind("broken.ks:", 0), 0) << e.what();
+  }
+}
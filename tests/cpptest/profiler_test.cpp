@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <regex>
+#include <string>
+#include <string_view>
+#include "unittest.hh"
+
+using namespace kipper;
+
+class ProfilerTest : public ::testing::Test {
+ protected:
+  ProfilerTest() { kipper::Kipper::Initialize(); }
+};
+
+TEST_F(ProfilerTest, CollapsedStacks) {
+  if (!Kipper::StartProfiling(100)) {
+    GTEST_SKIP() << "no SIGPROF";
+  }
+  EXPECT_FALSE(Kipper::StartProfiling(100));
+  auto script = Script::Compile(
+      "function spin(n, i, s) {\n"
+      "  s = \"\"\n"
+      "  for (i = 0; i < n; i++) {\n"
+      "    s = s + \"x\"\n"
+      "  }\n"
+      "}\n"
+      "for (k = 0; k < 20; k++) {\n"
+      "  spin(500)\n"
+      "}\n",
+      "spin.ks");
+  constexpr std::string_view kStack = "(script) (spin.ks:8);spin (spin.ks:1) ";
+  std::string profile;
+  for (int run = 0; run < 100; run++) {
+    for (int i = 0; i < 10; i++) {
+      script->Run(Kipper::GlobalContext());
+    }
+    profile += Kipper::StopProfiling();
+    if (profile.find(kStack) != std::string::npos) {
+      break;
+    }
+    Kipper::StartProfiling(100);
+  }
+  EXPECT_NE(profile.find(kStack), std::string::npos);
+  EXPECT_EQ(profile.back(), '\n');
+  EXPECT_TRUE(Kipper::StopProfiling().empty());
+}
+
+TEST_F(ProfilerTest, SamplesOnlyTheScriptThread) {
+  std::string code;
+  for (int i = 0; i < 50000; i++) {
+    code += "v = [1, 2.5, \"x\"]\n";
+  }
+  auto script = Script::Compile(
+      "function down(n) {\n"
+      "  if (n > 0) {\n"
+      "    down(n - 1)\n"
+      "  }\n"
+      "}\n"
+      "for (k = 0; k < 50; k++) {\n"
+      "  down(k)\n"
+      "}\n",
+      "down.ks");
+  if (!Kipper::StartProfiling(100)) {
+    GTEST_SKIP() << "no SIGPROF";
+  }
+  // The stack changes depth all the time while the worker parses.
+  auto task = Script::CompileAsync(code, "parsed.ks");
+  do {
+    script->Run(Kipper::GlobalContext());
+  } while (!task->IsDone());
+  task->Finish();
+  auto profile = Kipper::StopProfiling();
+  EXPECT_FALSE(profile.empty());
+  std::regex sample{
+      "\\(script\\) \\(down\\.ks:[0-9]+\\)"
+      "(;down \\(down\\.ks:[0-9]+\\))* [0-9]+"};
+  std::string_view rest{profile};
+  while (!rest.empty()) {
+    auto line = rest.substr(0, rest.find('\n'));
+    EXPECT_TRUE(std::regex_match(line.begin(), line.end(), sample)) << line;
+    rest.remove_prefix(std::min(rest.size(), line.size() + 1));
+  }
+}
+
+TEST_F(ProfilerTest, NodeCounters) {
+  auto script = Script::Compile(
+      "total = 0\n"
+      "for (i = 0; i < 50; i++) {\n"
+      "  total = total + i\n"
+      "}\n",
+      "counters.ks");
+  if (!Kipper::StartCounting()) {
+    GTEST_SKIP() << "no KIPPER_NODE_COUNTERS";
+  }
+  script->Run(Kipper::GlobalContext());
+  auto report = Kipper::StopCounting(100);
+  EXPECT_TRUE(std::regex_search(
+      report,
+      std::regex{" 50 +[0-9]+  counters.ks:3:3: total = total \\+ i\n"}));
+  EXPECT_TRUE(std::regex_search(
+      report, std::regex{" 51 +[0-9]+  counters.ks:2:13: i < 50\n"}));
+  EXPECT_TRUE(Kipper::StopCounting(100).empty());
+}
@@ -1,24 +1,10 @@
 #include <cassert>
-#include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <string_view>
 #include "kipper/kipper.hh"
 
-int read_file(std::string_view file, std::string& kscript) {
-  std::ifstream istrm{file.data(), std::ios::in | std::ios::ate};
-  if (!istrm.is_open()) {
-    std::cerr << "failed to open " << file << '\n';
-    return 1;
-  }
-  auto length = istrm.tellg();
-  kscript.resize(length);
-  istrm.seekg(0, std::ios::beg);
-  istrm.read(&kscript[0], length);
-  return 0;
-}
-
 void register_assert() {
   using namespace kipper;
 
@@ -39,17 +25,14 @@ void register_assert() {
                     }));
 }
 
-int run_script(std::string_view file) {
-  std::string kscript;
-  if (auto rcode = read_file(file, kscript)) {
-    return rcode;
-  }
-
-  kipper::Kipper::Configure({16 * 1024 /* 16 KB*/, 3});
+int run_script(std::string_view file, bool bytecode, int32_t jit_threshold,
+               int32_t trace_threshold) {
+  kipper::Kipper::Configure({16 * 1024 /* 16 KB*/, 3, bytecode, true,
+                             jit_threshold, trace_threshold});
   kipper::Kipper::Initialize();
   register_assert();
   try {
-    auto script = kipper::Script::Compile(kscript, file);
+    auto script = kipper::Script::CompileFile(file);
     script->Run(kipper::Kipper::GlobalContext());
     return 0;
   } catch (const std::exception& e) {
@@ -60,5 +43,18 @@ int run_script(std::string_view file) {
 
 int main(int argc, char** argv) {
   assert(argc > 1);
-  return run_script(argv[1]);
+  if (argc > 2 && std::string_view{argv[1]} == "--ast") {
+    return run_script(argv[2], false, -1, -1);
+  }
+  if (argc > 2 && std::string_view{argv[1]} == "--jit") {
+    // Compiles all bytecode before its first run.
+    return run_script(argv[2], true, 0, -1);
+  }
+  if (argc > 2 && std::string_view{argv[1]} == "--trace") {
+    // Traces every loop from its second iteration on.
+    return run_script(argv[2], true, -1, 0);
+  }
+  kipper::KipperConfig config{};
+  return run_script(argv[1], true, config.jit_threshold,
+                    config.trace_threshold);
 }
\ No newline at end of file
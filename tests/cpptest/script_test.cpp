@@ -0,0 +1,76 @@
+#include <sstream>
+#include <string>
+#include "unittest.hh"
+
+using namespace kipper;
+
+class ScriptTest : public ::testing::Test {
+ protected:
+  ScriptTest() { Kipper::Initialize(); }
+};
+
+TEST_F(ScriptTest, CompilesCodeReadInChunks) {
+  std::string code = "function add(a, b) {\n  return a + b\n}\n";
+  // Spans several chunks, with tokens cut at their boundaries.
+  for (int i = 0; i < 2500; i++) {
+    code += "total = add(total, \"" + std::to_string(i % 10) + "\".length)\n";
+  }
+  code += "total = total +\n";
+  Kipper::GlobalContext()->Push("total", Number::New(0));
+  std::istringstream input{code};
+  try {
+    Script::Compile(input, "chunked.ks");
+    FAIL() << "expected a syntax error";
+  } catch (const std::exception& e) {
+    EXPECT_EQ(std::string{e.what()},
+              "chunked.ks:2505.1: syntax error: unexpected token `end of "
+              "file`");
+  }
+  code.resize(code.size() - 16);
+  input = std::istringstream{code};
+  Script::Compile(input, "chunked.ks")->Run(Kipper::GlobalContext());
+  EXPECT_EQ(Kipper::GlobalContext()->Resolve("total")->ToNumber()->Double(),
+            2500);
+}
+
+TEST_F(ScriptTest, ReusesPositionsOfFreedScripts) {
+  // Compiles more than the 4 GB of source the positions can tell apart,
+  // each script failing on its first token so that it is freed at once.
+  std::string code = ")" + std::string(64 << 20, ' ');
+  for (int i = 0; i < 72; i++) {
+    try {
+      if (i % 2 == 0) {
+        Script::Compile(code, "large.ks");
+      } else {
+        Script::CompileAsync(code, "large.ks")->Finish();
+      }
+      FAIL() << "expected a syntax error";
+    } catch (const std::exception& e) {
+      ASSERT_EQ(std::string{e.what()},
+                "large.ks:1.1: syntax error: unexpected token `)`");
+    }
+  }
+  Script::Compile("s = 1\n", "small.ks")->Run(Kipper::GlobalContext());
+}
+
+TEST_F(ScriptTest, FreesLazyFunctionsWithTheirScript) {
+  // The body takes a few handle chunks once parsed on its call.
+  std::string code = "function words() {\n  return [";
+  for (int i = 0; i < 3000; i++) {
+    code += "\"w" + std::to_string(i) + "\", ";
+  }
+  code += "\"w\"].length\n}\ntotal = total + words()\n";
+  auto global = Kipper::GlobalContext();
+  global->Push("total", Number::New(0));
+  for (int i = 0; i < 20; i++) {
+    Script::Compile(code, "words.ks")->Run(global);
+    // Collects garbage while the handles of the freed script are gone.
+    Script::Compile(
+        "for (j = 0; j < 1000; j++) {\n"
+        "  garbage = [j, \"x\" + j]\n"
+        "}\n",
+        "garbage.ks")
+        ->Run(global);
+  }
+  EXPECT_EQ(global->Resolve("total")->ToNumber()->Double(), 20 * 3001);
+}
@@ -0,0 +1,109 @@
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "unittest.hh"
+
+using namespace kipper;
+
+namespace fs = std::filesystem;
+
+// The heap is initialized once per process, so each phase runs in a child
+// process of its own.
+class SnapshotDeathTest : public ::testing::Test {
+ protected:
+  SnapshotDeathTest() {
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+    path_ = fs::temp_directory_path() / "ks-snapshot-test.kss";
+  }
+
+  ~SnapshotDeathTest() override { fs::remove(path_); }
+
+  fs::path path_;
+};
+
+static Handle<Value> Twice(Handle<Array> args, Context* /*context*/) {
+  return Number::New(args->Index(0)->ToNumber()->Double() * 2);
+}
+
+static kSFunctionTemplate kExternalReferences[] = {&Twice, nullptr};
+
+static void CreateSnapshot(const fs::path& path) {
+  Kipper::Configure(KipperConfig{0, 0});
+  Kipper::Initialize();
+  auto global = Kipper::GlobalContext();
+  global->Push("greeting", String::New("hello"));
+  auto list = Array::New(0);
+  for (int32_t i = 1; i <= 3; i++) {
+    list->Push(Number::New(i));
+  }
+  global->Push("list", list);
+  auto config = Object::New(0);
+  config->SetProperty(String::New("size"), Number::New(10));
+  config->SetProperty(String::New("list"), list);
+  global->Push("config", config);
+  std::string_view params[] = {"n"};
+  global->Push("Twice", Function::New("Twice", params, &Twice));
+  global->Push("result", Number::New(0));
+
+  KipperConfig snapshot_config{0, 0};
+  snapshot_config.external_references = kExternalReferences;
+  Kipper::Configure(snapshot_config);
+  std::ofstream{path, std::ios::binary} << Kipper::CreateSnapshot();
+}
+
+static int RunFromSnapshot(const fs::path& path) {
+  std::stringstream snapshot;
+  snapshot << std::ifstream{path, std::ios::binary}.rdbuf();
+  auto data = snapshot.str();
+  KipperConfig config{0, 0};
+  config.snapshot = data;
+  config.external_references = kExternalReferences;
+  Kipper::Configure(config);
+  Kipper::Initialize();
+  auto global = Kipper::GlobalContext();
+  if (global->Resolve("greeting")->ToString()->StringView() != "hello") {
+    return 1;
+  }
+  auto script = Script::Compile(
+      "config.list.push(4)\n"
+      "result = Twice(list[3]) + config.size + list.length\n"
+      "Print(\"\")\n",
+      "snapshot.ks");
+  script->Run(global);
+  return global->Resolve("result")->ToNumber()->Double() == 22 ? 0 : 2;
+}
+
+TEST_F(SnapshotDeathTest, RestoresGlobals) {
+  EXPECT_EXIT(
+      {
+        CreateSnapshot(path_);
+        std::exit(0);
+      },
+      ::testing::ExitedWithCode(0), "");
+  ASSERT_TRUE(fs::exists(path_));
+  EXPECT_EXIT(std::exit(RunFromSnapshot(path_)), ::testing::ExitedWithCode(0),
+              "");
+}
+
+TEST_F(SnapshotDeathTest, RejectsDamagedSnapshot) {
+  EXPECT_EXIT(
+      {
+        CreateSnapshot(path_);
+        std::exit(0);
+      },
+      ::testing::ExitedWithCode(0), "");
+  fs::resize_file(path_, fs::file_size(path_) - 8);
+  EXPECT_EXIT(
+      {
+        try {
+          RunFromSnapshot(path_);
+        } catch (const std::exception& e) {
+          std::cerr << e.what();
+          std::exit(3);
+        }
+        std::exit(0);
+      },
+      ::testing::ExitedWithCode(3), "malformed snapshot");
+}
@@ -1,6 +1,7 @@
 #include <cmath>
 #include <iostream>
 #include <numeric>
+#include <string>
 #include "unittest.hh"
 
 using namespace kipper;
@@ -210,6 +211,57 @@ TEST_F(ValueTest, ConstructObject) {
   EXPECT_EQ(empty_object->GetProperty(String::New("123")), Number::New(2.2));
 }
 
+TEST_F(ValueTest, DeleteProperty) {
+  auto object = Object::New(0);
+  EXPECT_FALSE(object->DeleteProperty(String::New("a")));
+  object->SetProperty(String::New("a"), Number::New(1));
+  object->SetProperty(String::New("b"), Number::New(2));
+  EXPECT_TRUE(object->DeleteProperty(String::New("a")));
+  EXPECT_FALSE(object->DeleteProperty(String::New("a")));
+  EXPECT_EQ(object->GetProperty(String::New("a")), Undefined());
+  EXPECT_EQ(object->GetProperty(String::New("b")), Number::New(2));
+  object->SetProperty(String::New("a"), Number::New(3));
+  EXPECT_EQ(object->GetProperty(String::New("a")), Number::New(3));
+  EXPECT_EQ(object->GetProperty(String::New("b")), Number::New(2));
+}
+
+TEST_F(ValueTest, DeletePropertiesOfFullTable) {
+  auto key = [](int i) { return String::New("k" + std::to_string(i)); };
+  auto object = Object::New(0);
+  for (int i = 0; i < 100; i++) {
+    object->SetProperty(key(i), Number::New(i));
+  }
+  // Deleting from long runs of full slots leaves tombstones, which lookups
+  // of the remaining keys have to probe past.
+  for (int i = 0; i < 100; i += 2) {
+    EXPECT_TRUE(object->DeleteProperty(key(i)));
+  }
+  for (int i = 0; i < 100; i++) {
+    if (i % 2) {
+      EXPECT_EQ(object->GetProperty(key(i)), Number::New(i));
+    } else {
+      EXPECT_EQ(object->GetProperty(key(i)), Undefined());
+    }
+  }
+  // Churning through keys fills the table with tombstones until it is
+  // rehashed in place.
+  for (int i = 100; i < 2000; i++) {
+    object->SetProperty(key(i), Number::New(i));
+    EXPECT_EQ(object->GetProperty(key(i)), Number::New(i));
+    EXPECT_TRUE(object->DeleteProperty(key(i)));
+  }
+  for (int i = 100; i < 2000; i++) {
+    EXPECT_EQ(object->GetProperty(key(i)), Undefined());
+  }
+  for (int i = 0; i < 100; i += 2) {
+    EXPECT_EQ(object->GetProperty(key(i)), Undefined());
+    object->SetProperty(key(i), Number::New(-i));
+  }
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(object->GetProperty(key(i)), Number::New(i % 2 ? i : -i));
+  }
+}
+
 TEST_F(ValueTest, ToNumber) {
   EXPECT_EQ(Number::New(0)->ToNumber()->Double(), 0);
   EXPECT_EQ(Number::New(0)->ToNumber()->Int32(), 0);